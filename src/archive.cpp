@@ -0,0 +1,398 @@
+#include "archive.h"
+#include "mygit.h"
+#include "object_reader.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+
+namespace {
+    const size_t BLOCK = 512;
+    const size_t RECORD = 10240;
+
+    // Blob data travels from the reading thread in pieces of this size,
+    // with at most QUEUE_BYTES of them waiting to be written
+    const size_t PIECE_SIZE = 64 * 1024;
+    const size_t QUEUE_BYTES = 8 * 1024 * 1024;
+
+    // A header with name, size or link cut to what ustar can hold; the
+    // caller adds pax records for whatever did not fit
+    std::string ustarBlock(const std::string& path, char type, unsigned mode, uint64_t size, time_t mtime,
+                           const std::string& link) {
+        std::string block(BLOCK, '\0');
+        auto put = [&](size_t offset, size_t len, const std::string& value) {
+            memcpy(&block[offset], value.data(), std::min(len, value.size()));
+        };
+        auto octal = [&](size_t offset, size_t len, uint64_t value) {
+            char digits[32];
+            snprintf(digits, sizeof(digits), "%0*llo", int(len - 1), static_cast<unsigned long long>(value));
+            put(offset, len - 1, digits);
+        };
+
+        // Long names are split at a slash into prefix and name if they can be
+        std::string name = path, prefix;
+        if (name.size() > 100) {
+            size_t slash = name.find('/', name.size() - 101);
+            if (slash != std::string::npos && slash > 0 && slash <= 155 && slash + 1 < name.size()) {
+                prefix = name.substr(0, slash);
+                name = name.substr(slash + 1);
+            }
+        }
+
+        put(0, 100, name);
+        octal(100, 8, mode);
+        octal(108, 8, 0);
+        octal(116, 8, 0);
+        octal(124, 12, size);
+        octal(136, 12, mtime > 0 ? uint64_t(mtime) : 0);
+        block[156] = type;
+        put(157, 100, link);
+        put(257, 6, std::string("ustar\0", 6));
+        put(263, 2, "00");
+        put(265, 32, "root");
+        put(297, 32, "root");
+        octal(329, 8, 0);
+        octal(337, 8, 0);
+        put(345, 155, prefix);
+
+        // The checksum is taken with its own field set to spaces
+        memset(&block[148], ' ', 8);
+        unsigned sum = 0;
+        for (unsigned char c : block) {
+            sum += c;
+        }
+        char digits[8];
+        snprintf(digits, sizeof(digits), "%06o", sum);
+        memcpy(&block[148], digits, 7);
+        return block;
+    }
+
+    bool fitsUstar(const std::string& path) {
+        if (path.size() <= 100) return true;
+        size_t slash = path.find('/', path.size() - 101);
+        return slash != std::string::npos && slash > 0 && slash <= 155 && slash + 1 < path.size();
+    }
+
+    // What the reading thread hands the writer: an entry header, a piece
+    // of the open file's data, or the error that stopped the walk
+    struct Piece {
+        enum Kind { DIRECTORY, FILE, SYMLINK, DATA, FAILED } kind;
+        std::string path;
+        std::string data;           // file data, link target or error message
+        bool executable = false;
+        uint64_t size = 0;
+    };
+
+    // Bounded by bytes: push() blocks while the writer is behind, and
+    // fails once the writer has given up
+    class PieceQueue {
+    public:
+        bool push(Piece piece) {
+            std::unique_lock<std::mutex> lock(mutex);
+            // A piece larger than the bound still goes through on its own
+            space.wait(lock, [&]() { return cancelled || queued.empty() || bytes + piece.data.size() <= QUEUE_BYTES; });
+            if (cancelled) return false;
+            bytes += piece.data.size();
+            queued.push_back(std::move(piece));
+            ready.notify_one();
+            return true;
+        }
+
+        bool pop(Piece& piece) {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&]() { return closed || !queued.empty(); });
+            if (queued.empty()) return false;
+            piece = std::move(queued.front());
+            queued.pop_front();
+            bytes -= piece.data.size();
+            space.notify_one();
+            return true;
+        }
+
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            ready.notify_all();
+        }
+
+        void cancel() {
+            std::lock_guard<std::mutex> lock(mutex);
+            cancelled = true;
+            space.notify_all();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::condition_variable space;
+        std::deque<Piece> queued;
+        size_t bytes = 0;
+        bool closed = false;
+        bool cancelled = false;
+    };
+}
+
+TarWriter::TarWriter(std::ostream& out, bool gzip) : out(out), gzip(gzip), total(0), error(false) {
+    if (gzip) {
+        memset(&zs, 0, sizeof(zs));
+        if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            error = true;
+        }
+        deflated.resize(65536);
+    }
+}
+
+TarWriter::~TarWriter() {
+    if (gzip) {
+        deflateEnd(&zs);
+    }
+}
+
+bool TarWriter::emit(const char* data, size_t len, int flush) {
+    if (error) return false;
+    total += len;
+    if (!gzip) {
+        out.write(data, len);
+        error = !out.good();
+        return !error;
+    }
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = len;
+    int ret;
+    do {
+        zs.next_out = reinterpret_cast<Bytef*>(deflated.data());
+        zs.avail_out = deflated.size();
+        ret = deflate(&zs, flush);
+        if (ret == Z_STREAM_ERROR) {
+            error = true;
+            return false;
+        }
+        out.write(deflated.data(), deflated.size() - zs.avail_out);
+    } while (zs.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+    error = !out.good();
+    return !error;
+}
+
+bool TarWriter::pad() {
+    static const char zeros[BLOCK] = {0};
+    size_t rest = total % BLOCK;
+    return rest == 0 || emit(zeros, BLOCK - rest);
+}
+
+bool TarWriter::pax(char type, const std::string& name, const std::vector<std::pair<std::string, std::string>>& records,
+                    time_t mtime) {
+    // Each record is "<length> <key>=<value>\n", the length counting its
+    // own digits
+    std::string body;
+    for (const auto& record : records) {
+        std::string field = " " + record.first + "=" + record.second + "\n";
+        size_t digits = 1;
+        while (std::to_string(field.size() + digits).size() != digits) digits++;
+        body += std::to_string(field.size() + digits) + field;
+    }
+    std::string block = ustarBlock(name, type, 0666, body.size(), mtime, "");
+    return emit(block.data(), block.size()) && emit(body.data(), body.size()) && pad();
+}
+
+bool TarWriter::header(const std::string& path, char type, unsigned mode, uint64_t size, time_t mtime,
+                       const std::string& link) {
+    std::vector<std::pair<std::string, std::string>> records;
+    if (!fitsUstar(path)) records.push_back({"path", path});
+    if (link.size() > 100) records.push_back({"linkpath", link});
+    if (size > 077777777777ULL) records.push_back({"size", std::to_string(size)});
+    if (!records.empty() && !pax('x', "././@PaxHeader", records, mtime)) {
+        return false;
+    }
+
+    std::string block = ustarBlock(path, type, mode, size > 077777777777ULL ? 0 : size, mtime, link);
+    return emit(block.data(), block.size());
+}
+
+bool TarWriter::comment(const std::string& text) {
+    return pax('g', "pax_global_header", {{"comment", text}}, 0);
+}
+
+bool TarWriter::directory(const std::string& path, time_t mtime) {
+    return header(path, '5', 0775, 0, mtime, "");
+}
+
+bool TarWriter::symlink(const std::string& path, const std::string& target, time_t mtime) {
+    return header(path, '2', 0777, 0, mtime, target);
+}
+
+bool TarWriter::beginFile(const std::string& path, bool executable, uint64_t size, time_t mtime) {
+    return header(path, '0', executable ? 0775 : 0664, size, mtime, "");
+}
+
+bool TarWriter::write(const char* data, size_t len) {
+    return emit(data, len);
+}
+
+bool TarWriter::endFile() {
+    return pad();
+}
+
+bool TarWriter::finish() {
+    static const char zeros[RECORD] = {0};
+    if (!emit(zeros, 2 * BLOCK)) return false;
+    size_t rest = total % RECORD;
+    if (rest != 0 && !emit(zeros, RECORD - rest)) return false;
+    if (gzip && !emit(nullptr, 0, Z_FINISH)) return false;
+    out.flush();
+    return out.good();
+}
+
+bool MyGit::archive(const std::string& hash, const std::string& prefix, bool gzip, std::ostream& out) {
+    loadPacks();
+    std::string type, content, tree = hash;
+    if (!peekObject(hash, type, &content) || (type != "commit" && type != "tree")) {
+        fail("Not a commit or tree: " + hash);
+        return false;
+    }
+
+    // Entries carry the commit's time, as in Git; a bare tree gets now
+    time_t mtime = time(nullptr);
+    if (type == "commit") {
+        std::vector<std::string> parents;
+        commitLinks(content, tree, parents);
+        size_t author = content.find("\nauthor ");
+        size_t email_end = author == std::string::npos ? author : content.find("> ", author);
+        struct tm tm = {};
+        if (email_end != std::string::npos &&
+            strptime(content.c_str() + email_end + 2, "%Y-%m-%d %H:%M:%S", &tm)) {
+            tm.tm_isdst = -1;
+            mtime = mktime(&tm);
+        }
+    }
+
+    // Objects are read and inflated on their own thread while this one
+    // writes (and compresses) what is already queued
+    PieceQueue queue;
+    std::thread reader([&]() {
+        auto failed = [&](const std::string& message) {
+            Piece piece{Piece::FAILED, "", message};
+            queue.push(std::move(piece));
+            return false;
+        };
+        auto data = [&](const char* bytes, size_t len) {
+            Piece piece{Piece::DATA, "", std::string(bytes, len)};
+            return queue.push(std::move(piece));
+        };
+
+        // Content in pieces: loose objects straight from the inflater,
+        // packed ones and the chunks of a manifest one object at a time
+        auto stream = [&](const std::string& blob, const std::string& path, bool executable) {
+            ObjectReader reader(getObjectPath(blob));
+            std::string object_type, object;
+            bool loose = reader.readHeader();
+            if (loose) {
+                object_type = reader.type();
+                if (object_type == "manifest") object = reader.readContent();
+            } else if (!peekObject(blob, object_type, &object)) {
+                return failed("Unable to read " + blob);
+            }
+
+            if (object_type == "manifest") {
+                auto chunks = parseManifest(object);
+                uint64_t size = 0;
+                for (const auto& chunk : chunks) {
+                    size += chunk.second;
+                }
+                Piece piece{Piece::FILE, path, "", executable, size};
+                if (!queue.push(std::move(piece))) return false;
+                for (const auto& chunk : chunks) {
+                    std::string chunk_type, chunk_data;
+                    if (!peekObject(chunk.first, chunk_type, &chunk_data) || chunk_data.size() != chunk.second) {
+                        return failed("Missing chunk: " + chunk.first);
+                    }
+                    if (!data(chunk_data.data(), chunk_data.size())) return false;
+                }
+                return true;
+            }
+
+            Piece piece{Piece::FILE, path, "", executable, loose ? reader.size() : object.size()};
+            if (!queue.push(std::move(piece))) return false;
+            if (!loose) {
+                for (size_t pos = 0; pos < object.size(); pos += PIECE_SIZE) {
+                    if (!data(object.data() + pos, std::min(PIECE_SIZE, object.size() - pos))) return false;
+                }
+                return true;
+            }
+            std::vector<char> buf(PIECE_SIZE);
+            size_t n;
+            while ((n = reader.read(buf.data(), buf.size())) > 0) {
+                if (!data(buf.data(), n)) return false;
+            }
+            return !reader.failed() || failed("Corrupt object: " + blob);
+        };
+
+        std::function<bool(const std::string&, const std::string&)> walk = [&](const std::string& tree_hash,
+                                                                                const std::string& dir) {
+            std::string tree_type, tree_content;
+            if (!peekObject(tree_hash, tree_type, &tree_content) || tree_type != "tree") {
+                return failed("Unable to read tree " + tree_hash);
+            }
+            for (const auto& entry : parseTree(tree_content)) {
+                std::string path = dir + entry.name;
+                if (entry.type == "tree") {
+                    Piece piece{Piece::DIRECTORY, path + "/", ""};
+                    if (!queue.push(std::move(piece)) || !walk(entry.hash, path + "/")) return false;
+                } else if (entry.mode == "120000") {
+                    std::string link_type, target;
+                    if (!peekObject(entry.hash, link_type, &target)) {
+                        return failed("Unable to read " + entry.hash);
+                    }
+                    Piece piece{Piece::SYMLINK, path, target};
+                    if (!queue.push(std::move(piece))) return false;
+                } else if (entry.type == "blob" && !stream(entry.hash, path, entry.mode == "100755")) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        if (!prefix.empty()) {
+            Piece piece{Piece::DIRECTORY, prefix.back() == '/' ? prefix : prefix + "/", ""};
+            if (!queue.push(std::move(piece))) return;
+        }
+        walk(tree, prefix.empty() || prefix.back() == '/' ? prefix : prefix + "/");
+        queue.close();
+    });
+
+    TarWriter tar(out, gzip);
+    bool ok = type != "commit" || tar.comment(hash);
+    bool in_file = false, reported = false;
+    Piece piece;
+    while (ok && queue.pop(piece)) {
+        if (in_file && piece.kind != Piece::DATA) {
+            ok = tar.endFile();
+            in_file = false;
+        }
+        switch (piece.kind) {
+            case Piece::DIRECTORY: ok = ok && tar.directory(piece.path, mtime); break;
+            case Piece::SYMLINK: ok = ok && tar.symlink(piece.path, piece.data, mtime); break;
+            case Piece::FILE:
+                ok = ok && tar.beginFile(piece.path, piece.executable, piece.size, mtime);
+                in_file = true;
+                break;
+            case Piece::DATA: ok = ok && tar.write(piece.data.data(), piece.data.size()); break;
+            case Piece::FAILED:
+                fail(piece.data);
+                ok = false;
+                reported = true;
+                break;
+        }
+    }
+    queue.cancel();
+    reader.join();
+
+    if (ok && in_file) ok = tar.endFile();
+    if (!ok || !tar.finish()) {
+        if (!reported) fail("Unable to write archive");
+        return false;
+    }
+    return true;
+}
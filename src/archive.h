@@ -0,0 +1,53 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <string>
+#include <ostream>
+#include <vector>
+#include <ctime>
+#include <cstdint>
+#include <zlib.h>
+
+// Streaming POSIX tar (ustar with pax extensions), written as Git's archive
+// writes it: 512-byte headers owned by root, modes under umask 002, long
+// names in pax records and the output padded to a 10240-byte record. With
+// gzip the stream is deflated on the way out. Nothing is held back beyond
+// one header and one deflate buffer.
+class TarWriter {
+public:
+    TarWriter(std::ostream& out, bool gzip);
+    ~TarWriter();
+
+    TarWriter(const TarWriter&) = delete;
+    TarWriter& operator=(const TarWriter&) = delete;
+
+    // pax_global_header with a comment record, where Git keeps the commit
+    bool comment(const std::string& text);
+    bool directory(const std::string& path, time_t mtime);
+    bool symlink(const std::string& path, const std::string& target, time_t mtime);
+
+    // A file is its header, exactly size bytes of write() and endFile()
+    bool beginFile(const std::string& path, bool executable, uint64_t size, time_t mtime);
+    bool write(const char* data, size_t len);
+    bool endFile();
+
+    // End-of-archive blocks, record padding and the gzip trailer
+    bool finish();
+
+private:
+    std::ostream& out;
+    bool gzip;
+    z_stream zs;
+    std::vector<char> deflated;
+    uint64_t total;             // tar bytes so far, before compression
+    bool error;
+
+    bool header(const std::string& path, char type, unsigned mode, uint64_t size, time_t mtime,
+                const std::string& link);
+    bool pax(char type, const std::string& name, const std::vector<std::pair<std::string, std::string>>& records,
+             time_t mtime);
+    bool emit(const char* data, size_t len, int flush = Z_NO_FLUSH);
+    bool pad();
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "arena.h"
+#include <cstring>
+
+Arena::Arena(size_t block_size) : next(nullptr), end(nullptr), block_size(block_size), total(0) {}
+
+Arena::~Arena() = default;
+
+void* Arena::grow(size_t size, size_t align) {
+    // Oversized requests get a block of their own, so the rest of the
+    // current block stays usable
+    size_t needed = size + align;
+    if (needed > block_size / 4) {
+        blocks.emplace_back(new char[needed]);
+        total += needed;
+        char* start = blocks.back().get();
+        return start + (align - reinterpret_cast<uintptr_t>(start) % align) % align;
+    }
+
+    blocks.emplace_back(new char[block_size]);
+    total += block_size;
+    next = blocks.back().get();
+    end = next + block_size;
+    return allocate(size, align);
+}
+
+std::string_view Arena::copy(std::string_view s) {
+    char* p = static_cast<char*>(allocate(s.size() + 1, 1));
+    memcpy(p, s.data(), s.size());
+    p[s.size()] = '\0';
+    return std::string_view(p, s.size());
+}
+
+std::string_view Arena::join(std::string_view dir, std::string_view name) {
+    if (dir.empty()) {
+        return copy(name);
+    }
+    size_t size = dir.size() + 1 + name.size();
+    char* p = static_cast<char*>(allocate(size + 1, 1));
+    memcpy(p, dir.data(), dir.size());
+    p[dir.size()] = '/';
+    memcpy(p + dir.size() + 1, name.data(), name.size());
+    p[size] = '\0';
+    return std::string_view(p, size);
+}
+
+std::string_view PathPool::intern(std::string_view path) {
+    auto found = paths.find(path);
+    if (found != paths.end()) {
+        return *found;
+    }
+    return *paths.insert(arena.copy(path)).first;
+}
+
+std::string_view PathPool::join(std::string_view dir, std::string_view name) {
+    std::string_view path = arena.join(dir, name);
+    return *paths.insert(path).first;
+}
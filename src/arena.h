@@ -0,0 +1,95 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <string_view>
+#include <memory>
+#include <memory_resource>
+#include <unordered_set>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Monotonic allocator for the short-lived nodes, names and paths of one
+// operation (building a tree, restoring one, scanning the worktree). Memory
+// is taken from the heap in large blocks and given back all at once when
+// the arena is destroyed; nothing in it is freed or destroyed on its own.
+//
+// It is also a memory_resource, so std::pmr containers can grow inside it.
+// An arena is not thread-safe: parallel operations use one per thread.
+class Arena : public std::pmr::memory_resource {
+public:
+    explicit Arena(size_t block_size = 64 * 1024);
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        size_t pad = (align - reinterpret_cast<uintptr_t>(next) % align) % align;
+        if (size + pad > static_cast<size_t>(end - next)) {
+            return grow(size, align);
+        }
+        void* p = next + pad;
+        next += pad + size;
+        return p;
+    }
+
+    // Objects are never destroyed, so only trivially destructible ones
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T* array(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        T* items = static_cast<T*>(allocate(sizeof(T) * (count ? count : 1), alignof(T)));
+        for (size_t i = 0; i < count; i++) {
+            new (items + i) T();
+        }
+        return items;
+    }
+
+    // Copies are NUL-terminated, so data() can go straight to a system call
+    std::string_view copy(std::string_view s);
+
+    // "dir/name", or just name when dir is empty
+    std::string_view join(std::string_view dir, std::string_view name);
+
+    // Bytes handed out so far, for tracing
+    size_t used() const { return total - static_cast<size_t>(end - next); }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* next;
+    char* end;
+    size_t block_size;
+    size_t total;
+
+    void* grow(size_t size, size_t align);
+
+    void* do_allocate(size_t size, size_t align) override { return allocate(size, align); }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Paths stored once in an arena. Interning the same path again returns the
+// same view, so interned paths can be compared and hashed by pointer.
+class PathPool {
+public:
+    explicit PathPool(Arena& arena) : arena(arena), paths(&arena) {}
+
+    std::string_view intern(std::string_view path);
+    std::string_view join(std::string_view dir, std::string_view name);
+    bool contains(std::string_view path) const { return paths.count(path) > 0; }
+    size_t size() const { return paths.size(); }
+
+private:
+    Arena& arena;
+    std::pmr::unordered_set<std::string_view> paths;
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include "mygit.h"
+#include "sha1.h"
+#include "sha256.h"
+#include "utils.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// Benchmarks for the hashing, compression and tree primitives, plus
+// end-to-end commands on generated repositories of increasing size.
+//
+//   mygit-bench [--json] [--scale small,medium,large] [--min-time <seconds>]
+
+namespace {
+    struct Result {
+        std::string name;
+        size_t iterations;
+        double ns_per_op;
+        double mb_per_s;
+        long peak_rss_kb;
+    };
+
+    struct Scale {
+        std::string name;
+        int files;
+        int depth;
+        size_t file_size;
+    };
+
+    const Scale scales[] = {
+        {"small", 100, 2, 1024},
+        {"medium", 1000, 3, 4096},
+        {"large", 5000, 4, 16384},
+    };
+
+    double min_time = 0.2;
+    std::vector<Result> results;
+
+    long peakRssKb() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    class NullBuffer : public std::streambuf {
+    protected:
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+    };
+
+    // Commands print progress through std::cout/std::cerr, which would
+    // otherwise dominate the timings
+    class Silence {
+    public:
+        Silence() : out(std::cout.rdbuf(&null)), err(std::cerr.rdbuf(&null)) {}
+        ~Silence() {
+            std::cout.rdbuf(out);
+            std::cerr.rdbuf(err);
+        }
+    private:
+        NullBuffer null;
+        std::streambuf* out;
+        std::streambuf* err;
+    };
+
+    void record(const std::string& name, size_t iterations, double seconds, size_t bytes_per_op) {
+        Result result;
+        result.name = name;
+        result.iterations = iterations;
+        result.ns_per_op = seconds * 1e9 / iterations;
+        result.mb_per_s = bytes_per_op > 0 ? (bytes_per_op * iterations) / seconds / (1024.0 * 1024.0) : 0;
+        result.peak_rss_kb = peakRssKb();
+        results.push_back(result);
+    }
+
+    // Repeats op until min_time has elapsed
+    void bench(const std::string& name, size_t bytes_per_op, const std::function<void()>& op) {
+        using clock = std::chrono::steady_clock;
+        size_t iterations = 0;
+        auto start = clock::now();
+        double elapsed = 0;
+
+        do {
+            op();
+            iterations++;
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        } while (elapsed < min_time);
+
+        record(name, iterations, elapsed, bytes_per_op);
+    }
+
+    // Times a single run of op, for commands that change repository state
+    void benchOnce(const std::string& name, size_t bytes, const std::function<void()>& op) {
+        auto start = std::chrono::steady_clock::now();
+        {
+            Silence silence;
+            op();
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        record(name, 1, elapsed, bytes);
+    }
+
+    std::string randomText(std::mt19937& rng, size_t size) {
+        static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz      \n";
+        std::uniform_int_distribution<int> pick(0, sizeof(alphabet) - 2);
+        std::string text(size, ' ');
+        for (auto& c : text) {
+            c = alphabet[pick(rng)];
+        }
+        return text;
+    }
+
+    void benchPrimitives() {
+        std::mt19937 rng(42);
+
+        for (size_t size : {64, 4096, 262144}) {
+            std::string data = randomText(rng, size);
+            bench("sha1/" + std::to_string(size), size, [&]() { sha1(data); });
+            bench("sha256/" + std::to_string(size), size, [&]() { sha256(data); });
+        }
+
+        std::string data = randomText(rng, 1 << 20);
+        std::string compressed = Utils::compress(data);
+        bench("compress/1MiB", data.size(), [&]() { Utils::compress(data); });
+        bench("decompress/1MiB", data.size(), [&]() { Utils::decompress(compressed); });
+        bench("decompress-sized/1MiB", data.size(), [&]() { Utils::decompress(compressed, data.size()); });
+    }
+
+    // Lays out files round-robin across a directory tree of the given depth
+    size_t generateRepo(const Scale& scale, std::mt19937& rng) {
+        std::vector<std::string> dirs = {"."};
+        for (int level = 0; level < scale.depth; level++) {
+            std::vector<std::string> next;
+            for (const auto& dir : dirs) {
+                for (int i = 0; i < 4; i++) {
+                    std::string sub = dir + "/d" + std::to_string(i);
+                    fs::create_directories(sub);
+                    next.push_back(sub);
+                }
+            }
+            dirs.insert(dirs.end(), next.begin(), next.end());
+        }
+
+        size_t total = 0;
+        for (int i = 0; i < scale.files; i++) {
+            std::string path = dirs[i % dirs.size()] + "/f" + std::to_string(i) + ".dat";
+            Utils::writeFile(path, randomText(rng, scale.file_size));
+            total += scale.file_size;
+        }
+        return total;
+    }
+
+    void benchScale(const Scale& scale, const fs::path& root) {
+        fs::path dir = root / scale.name;
+        fs::create_directories(dir);
+        fs::current_path(dir);
+
+        std::mt19937 rng(7);
+        size_t bytes = generateRepo(scale, rng);
+        std::string prefix = "e2e/" + scale.name + "/";
+        std::string first_commit, tree_hash;
+
+        benchOnce(prefix + "init", 0, []() { MyGit().init(); });
+        benchOnce(prefix + "add", bytes, []() { MyGit().add({"."}); });
+        benchOnce(prefix + "status", bytes, []() { MyGit().status(); });
+        benchOnce(prefix + "commit", bytes, [&]() { first_commit = MyGit().commit("bench"); });
+
+        // A handful of follow-up commits touching a tenth of the files
+        for (int round = 0; round < 5; round++) {
+            int touched = 0;
+            for (const auto& entry : fs::recursive_directory_iterator(".")) {
+                if (entry.path().string().find(".mygit") != std::string::npos) continue;
+                if (entry.is_regular_file() && touched++ % 10 == round) {
+                    Utils::writeFile(entry.path().string(), randomText(rng, scale.file_size));
+                }
+            }
+            Silence silence;
+            MyGit().add({"."});
+            MyGit().commit("round " + std::to_string(round));
+        }
+
+        benchOnce(prefix + "log", 0, []() { MyGit().log(); });
+
+        CommitInfo commit;
+        MyGit().readCommit(first_commit, commit);
+        tree_hash = commit.tree_hash;
+        bench(prefix + "read-tree", 0, [&]() { MyGit().readTree(tree_hash); });
+
+        benchOnce(prefix + "checkout", bytes, [&]() { MyGit().checkout(first_commit); });
+
+        fs::current_path(root);
+    }
+
+    void printTable() {
+        std::cout << std::left << std::setw(28) << "benchmark"
+                  << std::right << std::setw(10) << "iters"
+                  << std::setw(16) << "ns/op"
+                  << std::setw(12) << "MB/s"
+                  << std::setw(14) << "peak RSS KB" << "\n";
+        for (const auto& r : results) {
+            std::cout << std::left << std::setw(28) << r.name
+                      << std::right << std::setw(10) << r.iterations
+                      << std::setw(16) << std::fixed << std::setprecision(0) << r.ns_per_op
+                      << std::setw(12) << std::setprecision(2) << r.mb_per_s
+                      << std::setw(14) << r.peak_rss_kb << "\n";
+        }
+    }
+
+    void printJson() {
+        std::cout << "{\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const auto& r = results[i];
+            std::cout << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+                      << std::fixed << std::setprecision(1)
+                      << ", \"ns_per_op\": " << r.ns_per_op
+                      << std::setprecision(3)
+                      << ", \"mb_per_s\": " << r.mb_per_s
+                      << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}"
+                      << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        std::cout << "  ]\n}\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bool json = false;
+    std::string wanted = "small,medium";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--json") {
+            json = true;
+        } else if (arg == "--scale" && i + 1 < argc) {
+            wanted = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            min_time = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Usage: mygit-bench [--json] [--scale small,medium,large] [--min-time <seconds>]" << std::endl;
+            return 1;
+        }
+    }
+
+    fs::path start = fs::current_path();
+    fs::path root = fs::temp_directory_path() / ("mygit-bench-" + std::to_string(getpid()));
+    fs::create_directories(root);
+
+    benchPrimitives();
+    for (const auto& scale : scales) {
+        if (("," + wanted + ",").find("," + scale.name + ",") != std::string::npos) {
+            benchScale(scale, root);
+        }
+    }
+
+    fs::current_path(start);
+    fs::remove_all(root);
+
+    if (json) {
+        printJson();
+    } else {
+        printTable();
+    }
+
+    return 0;
+}
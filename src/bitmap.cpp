@@ -0,0 +1,161 @@
+#include "bitmap.h"
+#include "pack.h"
+#include "utils.h"
+#include <cstring>
+
+namespace {
+    const uint64_t RUN_BIT = 1;
+    const int RUN_LENGTH_BITS = 32;
+    const uint64_t MAX_RUN = (uint64_t(1) << RUN_LENGTH_BITS) - 1;
+    const uint64_t MAX_LITERALS = (uint64_t(1) << 31) - 1;
+
+    void appendBE32(std::string& out, uint32_t value) {
+        char bytes[4] = {char(value >> 24), char(value >> 16), char(value >> 8), char(value)};
+        out.append(bytes, 4);
+    }
+
+    void appendBE64(std::string& out, uint64_t value) {
+        appendBE32(out, uint32_t(value >> 32));
+        appendBE32(out, uint32_t(value));
+    }
+
+    uint32_t readBE32(const char* p) {
+        const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+        return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | u[3];
+    }
+
+    uint64_t readBE64(const char* p) {
+        return (uint64_t(readBE32(p)) << 32) | readBE32(p + 4);
+    }
+}
+
+void Bitmap::orWith(const Bitmap& other) {
+    for (size_t i = 0; i < words.size() && i < other.words.size(); i++) {
+        words[i] |= other.words[i];
+    }
+}
+
+void Bitmap::andNot(const Bitmap& other) {
+    for (size_t i = 0; i < words.size() && i < other.words.size(); i++) {
+        words[i] &= ~other.words[i];
+    }
+}
+
+size_t Bitmap::count() const {
+    size_t total = 0;
+    for (uint64_t word : words) {
+        total += __builtin_popcountll(word);
+    }
+    return total;
+}
+
+void Bitmap::serialize(std::string& out) const {
+    std::vector<uint64_t> encoded;
+    size_t last_marker = 0;
+    size_t i = 0;
+    while (i < words.size()) {
+        // A run of all-zero or all-one words, then the literals after it
+        uint64_t run_bit = words[i] == ~uint64_t(0) ? 1 : 0;
+        uint64_t clean = run_bit ? ~uint64_t(0) : 0;
+        uint64_t run = 0;
+        while (i < words.size() && words[i] == clean && run < MAX_RUN) {
+            run++;
+            i++;
+        }
+        size_t literal_start = i;
+        while (i < words.size() && words[i] != 0 && words[i] != ~uint64_t(0) &&
+               i - literal_start < MAX_LITERALS) {
+            i++;
+        }
+
+        last_marker = encoded.size();
+        encoded.push_back((run_bit ? RUN_BIT : 0) | (run << 1) |
+                          (uint64_t(i - literal_start) << (RUN_LENGTH_BITS + 1)));
+        encoded.insert(encoded.end(), words.begin() + literal_start, words.begin() + i);
+    }
+
+    appendBE32(out, bits);
+    appendBE32(out, encoded.size());
+    for (uint64_t word : encoded) {
+        appendBE64(out, word);
+    }
+    appendBE32(out, last_marker);
+}
+
+bool Bitmap::deserialize(const char*& p, const char* end) {
+    if (end - p < 8) return false;
+    size_t bit_count = readBE32(p);
+    size_t word_count = readBE32(p + 4);
+    p += 8;
+    if (size_t(end - p) < word_count * 8 + 4) return false;
+
+    *this = Bitmap(bit_count);
+    size_t out = 0;
+    size_t i = 0;
+    while (i < word_count) {
+        uint64_t marker = readBE64(p + i * 8);
+        i++;
+        uint64_t run = (marker >> 1) & MAX_RUN;
+        uint64_t literals = marker >> (RUN_LENGTH_BITS + 1);
+        if (out + run + literals > words.size() || i + literals > word_count) return false;
+
+        uint64_t clean = (marker & RUN_BIT) ? ~uint64_t(0) : 0;
+        for (uint64_t r = 0; r < run; r++) {
+            words[out++] = clean;
+        }
+        for (uint64_t l = 0; l < literals; l++) {
+            words[out++] = readBE64(p + i * 8);
+            i++;
+        }
+    }
+    p += word_count * 8 + 4;
+    return true;
+}
+
+PackBitmap::PackBitmap(const std::string& path, const Pack& pack) : object_count(pack.objectCount()), opened(false) {
+    // Hashes here are as wide as the pack's
+    size_t hash_size = pack.hashSize();
+    if (!file.open(path) || file.size() < 12 + hash_size || memcmp(file.data(), "BITM", 4) != 0 ||
+        readBE32(file.data() + 4) != 1 || std::string(file.data() + 8, hash_size) != pack.checksum()) {
+        return;
+    }
+
+    // Index the entries up front; bitmaps are only decoded on lookup
+    uint32_t count = readBE32(file.data() + 8 + hash_size);
+    const char* p = file.data() + 12 + hash_size;
+    const char* end = file.data() + file.size();
+    for (uint32_t i = 0; i < count; i++) {
+        if (size_t(end - p) < hash_size) return;
+        std::string commit(p, hash_size);
+        p += hash_size;
+        size_t offset = p - file.data();
+
+        if (end - p < 8 || readBE32(p) != object_count) return;
+        size_t words = readBE32(p + 4);
+        if (size_t(end - p) < 8 + words * 8 + 4) return;
+        p += 8 + words * 8 + 4;
+        entries[commit] = offset;
+    }
+    opened = true;
+}
+
+bool PackBitmap::lookup(const std::string& commit_hash, Bitmap& bitmap) const {
+    auto entry = entries.find(PackFormat::hexToRaw(commit_hash));
+    if (!opened || entry == entries.end()) return false;
+
+    const char* p = file.data() + entry->second;
+    return bitmap.deserialize(p, file.data() + file.size());
+}
+
+bool PackBitmap::write(const std::string& path, const std::string& pack_checksum,
+                       const std::vector<std::pair<std::string, Bitmap>>& commits) {
+    std::string out = "BITM";
+    appendBE32(out, 1);
+    out += pack_checksum;
+    appendBE32(out, commits.size());
+    for (const auto& commit : commits) {
+        out += PackFormat::hexToRaw(commit.first);
+        commit.second.serialize(out);
+    }
+    return Utils::writeFileAtomic(path, out);
+}
@@ -0,0 +1,80 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include "mapped_file.h"
+
+class Pack;
+
+// Plain bit vector for set operations in memory, EWAH-compressed on disk.
+// Bits are object positions in a pack's index order.
+class Bitmap {
+public:
+    Bitmap() : bits(0) {}
+    explicit Bitmap(size_t bits) : words((bits + 63) / 64), bits(bits) {}
+
+    size_t size() const { return bits; }
+    void set(size_t pos) { words[pos / 64] |= uint64_t(1) << (pos % 64); }
+    bool get(size_t pos) const { return pos < bits && (words[pos / 64] >> (pos % 64)) & 1; }
+
+    // Both bitmaps must have the same size
+    void orWith(const Bitmap& other);
+    void andNot(const Bitmap& other);
+    size_t count() const;
+
+    template <typename F>
+    void forEach(F f) const {
+        for (size_t w = 0; w < words.size(); w++) {
+            for (uint64_t word = words[w]; word; word &= word - 1) {
+                f(w * 64 + __builtin_ctzll(word));
+            }
+        }
+    }
+
+    // Git's EWAH layout: bit count, word count, big-endian 64-bit words
+    // (run-length markers each followed by their literal words) and the
+    // position of the last marker
+    void serialize(std::string& out) const;
+    bool deserialize(const char*& p, const char* end);
+
+private:
+    std::vector<uint64_t> words;
+    size_t bits;
+};
+
+// pack-<sha>.bitmap beside a pack: "BITM", version 1, the pack's checksum
+// and an entry count, then per selected commit its raw hash and the EWAH
+// bitmap of every object reachable from it
+class PackBitmap {
+public:
+    PackBitmap(const std::string& path, const Pack& pack);
+
+    bool isOpen() const { return opened; }
+    size_t commitCount() const { return entries.size(); }
+    bool lookup(const std::string& commit_hash, Bitmap& bitmap) const;
+
+    static bool write(const std::string& path, const std::string& pack_checksum,
+                      const std::vector<std::pair<std::string, Bitmap>>& commits);
+
+private:
+    MappedFile file;
+    size_t object_count;
+    std::unordered_map<std::string, size_t> entries;   // raw hash to offset
+    bool opened;
+};
+
+// Objects reachable from some tips: those in the bitmapped pack as bits,
+// anything else (loose or in other packs) by hash
+struct ReachableSet {
+    const Pack* pack = nullptr;
+    Bitmap bits;
+    std::unordered_set<std::string> others;
+
+    size_t count() const { return bits.count() + others.size(); }
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "chunker.h"
+#include <algorithm>
+
+namespace FastCDC {
+    namespace {
+        struct GearTable {
+            uint64_t values[256];
+
+            GearTable() {
+                // Fixed-seed splitmix64 so boundaries are stable across builds
+                uint64_t state = 0x6d79676974636463ULL;
+                for (int i = 0; i < 256; i++) {
+                    state += 0x9e3779b97f4a7c15ULL;
+                    uint64_t z = state;
+                    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                    values[i] = z ^ (z >> 31);
+                }
+            }
+        };
+
+        const GearTable gear;
+
+        unsigned int log2Floor(size_t value) {
+            unsigned int bits = 0;
+            while (value > 1) {
+                value >>= 1;
+                bits++;
+            }
+            return bits;
+        }
+
+        // The gear hash shifts left, so the top bits carry the most history
+        uint64_t topBitsMask(unsigned int bits) {
+            return bits == 0 ? 0 : ~0ULL << (64 - bits);
+        }
+    }
+
+    Params paramsForAverage(size_t avg_size) {
+        avg_size = std::max<size_t>(avg_size, 256);
+        return Params{avg_size / 4, avg_size, avg_size * 4};
+    }
+
+    size_t nextChunk(const unsigned char* data, size_t len, const Params& params) {
+        if (len <= params.min_size) {
+            return len;
+        }
+
+        // Normalized chunking: a stricter mask below the average size and a
+        // looser one above it keeps chunk sizes close to the average
+        unsigned int bits = log2Floor(params.avg_size);
+        uint64_t mask_small = topBitsMask(bits + 1);
+        uint64_t mask_large = topBitsMask(bits > 1 ? bits - 1 : 1);
+
+        size_t limit = std::min(len, params.max_size);
+        size_t normal = std::min(limit, params.avg_size);
+        uint64_t fp = 0;
+        size_t i = params.min_size;
+
+        for (; i < normal; i++) {
+            fp = (fp << 1) + gear.values[data[i]];
+            if (!(fp & mask_small)) return i + 1;
+        }
+        for (; i < limit; i++) {
+            fp = (fp << 1) + gear.values[data[i]];
+            if (!(fp & mask_large)) return i + 1;
+        }
+
+        return limit;
+    }
+
+    std::vector<size_t> split(const char* data, size_t len, const Params& params) {
+        std::vector<size_t> chunks;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        size_t offset = 0;
+
+        while (offset < len) {
+            size_t n = nextChunk(p + offset, len - offset, params);
+            chunks.push_back(n);
+            offset += n;
+        }
+
+        return chunks;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// FastCDC content-defined chunking. Boundaries depend only on the bytes
+// around them, so an edit in one region of a large file leaves the chunks
+// elsewhere (and their hashes) unchanged.
+namespace FastCDC {
+    struct Params {
+        size_t min_size;
+        size_t avg_size;
+        size_t max_size;
+    };
+
+    Params paramsForAverage(size_t avg_size);
+
+    // Length of the chunk starting at data, at most len
+    size_t nextChunk(const unsigned char* data, size_t len, const Params& params);
+
+    // Lengths of consecutive chunks covering the whole buffer
+    std::vector<size_t> split(const char* data, size_t len, const Params& params);
+}
+
+#endif
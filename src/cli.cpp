@@ -0,0 +1,440 @@
+#include "cli.h"
+#include "ui_utils.h"
+#include <iostream>
+#include <map>
+
+namespace CLI {
+    void UIReporter::error(const std::string& message) {
+        UI::printError(message);
+    }
+    
+    void UIReporter::warning(const std::string& message) {
+        UI::printWarning(message);
+    }
+    
+    void UIReporter::info(const std::string& message) {
+        UI::printInfo(message);
+    }
+    
+    void UIReporter::success(const std::string& message) {
+        UI::printSuccess(message);
+    }
+    
+    void UIReporter::progress(const std::string& message) {
+        UI::printProgress(message);
+    }
+    
+    namespace {
+        // Porcelain paths are repository-relative, without the "./" that
+        // directory walks produce
+        std::string porcelainPath(const std::string& path) {
+            return path.compare(0, 2, "./") == 0 ? path.substr(2) : path;
+        }
+        
+        // "HEAD -> master, feature" style labels keyed by commit hash
+        std::map<std::string, std::string> decorations(MyGit& git) {
+            std::map<std::string, std::string> labels;
+            std::string current = git.currentBranch();
+            std::string head = git.getCurrentCommit();
+            
+            if (!head.empty()) {
+                labels[head] = current.empty() ? "HEAD" : "HEAD -> " + current;
+            }
+            for (const auto& branch : git.listBranches()) {
+                if (branch.name == current) continue;
+                std::string& label = labels[branch.hash];
+                label += (label.empty() ? "" : ", ") + branch.name;
+            }
+            return labels;
+        }
+    }
+    
+    int status(MyGit& git, const OutputFormat& format) {
+        if (!git.isRepository()) {
+            UI::printError("Not a MyGit repository (or any of the parent directories)");
+            return 1;
+        }
+        
+        if (format.porcelain) {
+            // Two-column state code as in "git status --porcelain"
+            char terminator = format.nul_terminated ? '\0' : '\n';
+            for (const auto& entry : git.status()) {
+                const char* code = entry.state == 'A' ? "A  " : entry.state == 'M' ? " M " : "?? ";
+                std::cout << code << porcelainPath(entry.path) << terminator;
+            }
+            return 0;
+        }
+        
+        std::string branch = git.currentBranch();
+        if (branch.empty()) {
+            std::cout << BOLD << "HEAD detached at " << RED << git.getCurrentCommit().substr(0, 7) << RESET << "\n";
+        } else {
+            std::cout << BOLD << "On branch " << GREEN << branch << RESET << "\n";
+        }
+        
+        if (git.getCurrentCommit().empty()) {
+            std::cout << "\n";
+            std::cout << "No commits yet\n";
+        }
+        
+        std::cout << "\n";
+        
+        auto entries = git.status();
+        
+        struct Section {
+            char state;
+            const char* color;
+            const char* title;
+            const char* hint;
+        };
+        const Section sections[] = {
+            {'A', GREEN, "Changes to be committed:", "  (use \"mygit reset HEAD <file>...\" to unstage)"},
+            {'M', RED, "Changes not staged for commit:", "  (use \"mygit add <file>...\" to update what will be committed)"},
+            {'?', "", "Untracked files:", "  (use \"mygit add <file>...\" to include in what will be committed)"},
+        };
+        
+        for (const auto& section : sections) {
+            bool any = false;
+            for (const auto& entry : entries) {
+                if (entry.state != section.state) continue;
+                if (!any) {
+                    std::cout << section.color << section.title << RESET << "\n";
+                    std::cout << DIM << section.hint << RESET << "\n";
+                    std::cout << "\n";
+                    any = true;
+                }
+                UI::printFileStatus(entry.state, entry.path);
+            }
+            if (any) {
+                std::cout << "\n";
+            }
+        }
+        
+        if (entries.empty()) {
+            std::cout << "nothing to commit, working tree clean\n";
+        }
+        
+        return 0;
+    }
+    
+    int lsTree(MyGit& git, const std::string& tree_hash, bool name_only, const OutputFormat& format) {
+        std::vector<TreeEntry> entries = git.readTree(tree_hash);
+        
+        if (format.porcelain) {
+            char terminator = format.nul_terminated ? '\0' : '\n';
+            for (const auto& entry : entries) {
+                if (!name_only) {
+                    std::cout << entry.mode << ' ' << entry.type << ' ' << entry.hash << '\t';
+                }
+                std::cout << entry.name << terminator;
+            }
+            return 0;
+        }
+        
+        if (!name_only) {
+            std::cout << "\n";
+        }
+        
+        for (const auto& entry : entries) {
+            if (name_only) {
+                std::cout << entry.name << "\n";
+            } else {
+                UI::printTreeEntry(entry.mode, entry.type, entry.hash, entry.name);
+            }
+        }
+        
+        if (!name_only) {
+            std::cout << "\n";
+            std::cout << DIM << entries.size() << " entries" << RESET << "\n";
+        }
+        
+        return 0;
+    }
+    
+    int log(MyGit& git, const OutputFormat& format, const std::string& path) {
+        auto commits = git.log("", path);
+        
+        if (format.porcelain) {
+            // One header block per commit, the message indented by four
+            // spaces; -z separates commits with NUL
+            for (const auto& commit : commits) {
+                std::cout << "commit " << commit.hash << '\n';
+                std::cout << "tree " << commit.tree_hash << '\n';
+                for (const auto& parent : commit.parents) {
+                    std::cout << "parent " << parent << '\n';
+                }
+                std::cout << "author " << commit.author << '\n';
+                std::cout << "date " << commit.timestamp << '\n';
+                std::cout << '\n';
+                
+                size_t start = 0;
+                while (start <= commit.message.size()) {
+                    size_t end = commit.message.find('\n', start);
+                    if (end == std::string::npos) end = commit.message.size();
+                    std::cout << "    " << commit.message.substr(start, end - start) << '\n';
+                    start = end + 1;
+                }
+                std::cout << (format.nul_terminated ? '\0' : '\n');
+            }
+            return 0;
+        }
+        
+        if (commits.empty()) {
+            UI::printInfo("No commits found");
+            return 0;
+        }
+        
+        UI::printSeparator();
+        
+        auto labels = decorations(git);
+        bool first = true;
+        for (const auto& commit : commits) {
+            if (!first) {
+                std::cout << YELLOW << "│" << RESET << "\n";
+            }
+            
+            std::cout << YELLOW << DOT << " " << BRIGHT_YELLOW << "commit " << commit.hash << RESET;
+            auto label = labels.find(commit.hash);
+            if (label != labels.end()) {
+                std::cout << " " << BRIGHT_CYAN << "(" << label->second << ")" << RESET;
+            }
+            std::cout << "\n";
+            
+            if (commit.parents.size() > 1) {
+                std::cout << YELLOW << "│" << RESET << " " << DIM << "Merge: ";
+                for (size_t i = 0; i < commit.parents.size(); i++) {
+                    std::cout << (i ? " " : "") << commit.parents[i].substr(0, 7);
+                }
+                std::cout << RESET << "\n";
+            } else if (!commit.parent_hash.empty()) {
+                std::cout << YELLOW << "│" << RESET << " " << DIM << "Parent: " << commit.parent_hash.substr(0, 7) << RESET << "\n";
+            }
+            
+            std::cout << YELLOW << "│" << RESET << " " << "Author: " << BRIGHT_WHITE << commit.author << RESET << "\n";
+            std::cout << YELLOW << "│" << RESET << " " << "Date:   " << DIM << commit.timestamp << RESET << "\n";
+            std::cout << YELLOW << "│" << RESET << "\n";
+            std::cout << YELLOW << "│" << RESET << "     " << commit.message.substr(0, commit.message.find('\n')) << "\n";
+            
+            first = false;
+        }
+        
+        std::cout << "\n";
+        UI::printSeparator();
+        
+        return 0;
+    }
+    
+    int show(MyGit& git, const std::string& commit_hash) {
+        CommitInfo commit;
+        if (!git.readCommit(commit_hash, commit)) {
+            UI::printError("Commit not found: " + commit_hash);
+            return 1;
+        }
+        
+        std::cout << BRIGHT_YELLOW << "commit " << commit.hash << RESET << "\n";
+        std::cout << DIM << "tree " << commit.tree_hash << RESET << "\n";
+        for (const auto& parent : commit.parents) {
+            std::cout << "parent " << parent << "\n";
+        }
+        std::cout << "author " << commit.author << " " << commit.timestamp << "\n";
+        std::cout << "\n";
+        
+        size_t start = 0;
+        while (start <= commit.message.size()) {
+            size_t end = commit.message.find('\n', start);
+            if (end == std::string::npos) end = commit.message.size();
+            std::cout << "    " << commit.message.substr(start, end - start) << "\n";
+            start = end + 1;
+        }
+        
+        std::cout << "\n";
+        UI::printSeparator();
+        std::cout << BOLD << "Files in this commit:" << RESET << "\n";
+        
+        return lsTree(git, commit.tree_hash, false, OutputFormat());
+    }
+    
+    int diff(MyGit& git) {
+        UI::printInfo("Showing differences between working directory and staging area...");
+        UI::printSeparator();
+        
+        auto entries = git.diff();
+        
+        if (entries.empty()) {
+            std::cout << "No changes detected\n";
+            return 0;
+        }
+        
+        for (const auto& entry : entries) {
+            const std::string& file = entry.path;
+            std::cout << BOLD << "diff --mygit a/" << file << " b/" << file << RESET << "\n";
+            std::cout << DIM << "index " << entry.index_hash.substr(0, 7) << ".."
+                      << (entry.worktree_hash.empty() ? "0000000" : entry.worktree_hash.substr(0, 7)) << RESET << "\n";
+            std::cout << YELLOW << "--- a/" << file << RESET << "\n";
+            std::cout << GREEN << "+++ b/" << file << RESET << "\n";
+            
+            // This is a simplified diff - in real implementation you'd show actual line differences
+            std::cout << CYAN << "@@ file modified @@" << RESET << "\n";
+            UI::printFileStatus(entry.worktree_hash.empty() ? 'D' : 'M', file);
+        }
+        
+        return 0;
+    }
+    
+    int checkout(MyGit& git, const std::string& commit_hash) {
+        if (!git.checkout(commit_hash)) {
+            return 1;
+        }
+        
+        UI::printSuccess("HEAD is now at " + commit_hash.substr(0, 7));
+        
+        CommitInfo commit;
+        if (git.readCommit(commit_hash, commit)) {
+            std::cout << DIM << "Commit message: " << commit.message.substr(0, commit.message.find('\n')) << RESET << "\n";
+        }
+        std::cout << DIM << "You are in 'detached HEAD' state; use 'mygit switch -c <branch>' to keep commits" << RESET << "\n";
+        
+        return 0;
+    }
+    
+    int branch(MyGit& git) {
+        std::string current = git.currentBranch();
+        for (const auto& branch : git.listBranches()) {
+            if (branch.name == current) {
+                std::cout << GREEN << "* " << branch.name << RESET;
+            } else {
+                std::cout << "  " << branch.name;
+            }
+            std::cout << " " << DIM << branch.hash.substr(0, 7) << RESET << "\n";
+        }
+        return 0;
+    }
+    
+    int switchBranch(MyGit& git, const std::string& name, bool create) {
+        if (!git.switchBranch(name, create)) {
+            return 1;
+        }
+        
+        UI::printSuccess(std::string(create ? "Switched to a new branch '" : "Switched to branch '") + name + "'");
+        return 0;
+    }
+    
+    int merge(MyGit& git, const std::string& name) {
+        MergeResult result;
+        if (!git.merge(name, result)) {
+            return 1;
+        }
+        
+        if (result.up_to_date) {
+            UI::printInfo("Already up to date");
+        } else if (result.fast_forward) {
+            UI::printSuccess("Fast-forwarded to " + result.commit.substr(0, 7));
+        } else if (result.conflicts.empty()) {
+            UI::printSuccess("Merge made commit " + result.commit.substr(0, 7));
+        } else {
+            for (const auto& conflict : result.conflicts) {
+                std::cout << RED << "CONFLICT" << RESET << " (" << conflict.detail << "): " << conflict.path << "\n";
+            }
+            UI::printError("Automatic merge failed; fix the conflicts and commit the result");
+            return 1;
+        }
+        return 0;
+    }
+    
+    int mergeBase(MyGit& git, const std::string& one, const std::string& two) {
+        std::vector<std::string> bases = git.mergeBases(one, two);
+        for (const auto& base : bases) {
+            std::cout << base << "\n";
+        }
+        return bases.empty() ? 1 : 0;
+    }
+    
+    int gc(MyGit& git, bool prune, long grace_seconds) {
+        GcStats stats;
+        if (!git.gc(prune, grace_seconds, stats)) {
+            return 1;
+        }
+        
+        std::cout << "Packed objects:      " << stats.packed << "\n";
+        std::cout << "Reachable objects:   " << stats.reachable << "\n";
+        std::cout << "Loose objects:       " << stats.loose << "\n";
+        std::cout << "Unreachable objects: " << stats.unreachable << "\n";
+        if (prune) {
+            std::cout << "Pruned objects:      " << stats.pruned << " (" << stats.bytes_pruned << " bytes)\n";
+        }
+        if (stats.missing > 0) {
+            UI::printWarning(std::to_string(stats.missing) + " referenced object(s) are missing");
+        }
+        return 0;
+    }
+    
+    int fsck(MyGit& git) {
+        FsckReport report;
+        if (!git.fsck(report)) {
+            return 1;
+        }
+        
+        for (const auto& problem : report.corrupt) {
+            std::cout << RED << "corrupt " << problem.hash << RESET << ": " << problem.detail << "\n";
+        }
+        for (const auto& problem : report.missing) {
+            std::cout << RED << "missing " << problem.hash << RESET << " (" << problem.detail << ")\n";
+        }
+        for (const auto& problem : report.dangling) {
+            std::cout << YELLOW << "dangling " << problem.detail << " " << problem.hash << RESET << "\n";
+        }
+        
+        std::cout << DIM << "Checked " << report.checked << " objects" << RESET << "\n";
+        return report.corrupt.empty() && report.missing.empty() ? 0 : 1;
+    }
+    
+    int repack(MyGit& git) {
+        RepackStats stats;
+        if (!git.repack(stats)) {
+            return 1;
+        }
+        
+        UI::printSuccess("Packed " + std::to_string(stats.objects) + " objects with " +
+                         std::to_string(stats.bitmaps) + " bitmap(s)");
+        std::cout << DIM << "Removed " << stats.packs_removed << " old pack(s) and "
+                  << stats.loose_removed << " loose object(s)" << RESET << "\n";
+        if (stats.unpacked > 0) {
+            std::cout << DIM << "Unpacked " << stats.unpacked << " unreachable object(s)" << RESET << "\n";
+        }
+        std::cout << DIM << "Commit graph covers " << stats.graph_commits << " commit(s)" << RESET << "\n";
+        if (stats.missing > 0) {
+            UI::printWarning(std::to_string(stats.missing) + " referenced object(s) are missing");
+        }
+        return 0;
+    }
+    
+    int grep(MyGit& git, const GrepOptions& options, const std::string& rev, bool line_numbers, bool names_only) {
+        std::vector<GrepMatch> matches;
+        bool ok = git.grep(options, matches);
+        
+        std::string prefix = rev.empty() ? "" : rev + ":";
+        const std::string* last_path = nullptr;
+        for (const auto& match : matches) {
+            if (names_only || match.line == 0) {
+                // One line per file, however many lines matched
+                if (last_path && *last_path == match.path) continue;
+                last_path = &match.path;
+                if (match.line == 0 && !names_only) {
+                    std::cout << "Binary file " << MAGENTA << prefix << match.path << RESET << " matches\n";
+                } else {
+                    std::cout << MAGENTA << prefix << match.path << RESET << "\n";
+                }
+                continue;
+            }
+            
+            std::cout << MAGENTA << prefix << match.path << RESET << CYAN << ":" << RESET;
+            if (line_numbers) {
+                std::cout << GREEN << match.line << RESET << CYAN << ":" << RESET;
+            }
+            std::cout << match.text << "\n";
+        }
+        
+        if (!ok) return 1;
+        return matches.empty() ? 1 : 0;
+    }
+}
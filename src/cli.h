@@ -0,0 +1,47 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include "mygit.h"
+#include <string>
+
+// Terminal front end: renders the structured results of MyGit with the
+// UI helpers. Each function returns the process exit code.
+namespace CLI {
+    class UIReporter : public Reporter {
+    public:
+        void error(const std::string& message) override;
+        void warning(const std::string& message) override;
+        void info(const std::string& message) override;
+        void success(const std::string& message) override;
+        void progress(const std::string& message) override;
+    };
+
+    // --porcelain selects a stable, uncolored format for scripts; -z
+    // implies it and terminates records with NUL instead of newline
+    struct OutputFormat {
+        bool porcelain = false;
+        bool nul_terminated = false;
+    };
+    
+    int status(MyGit& git, const OutputFormat& format);
+    int lsTree(MyGit& git, const std::string& tree_hash, bool name_only, const OutputFormat& format);
+    int log(MyGit& git, const OutputFormat& format, const std::string& path = "");
+    int show(MyGit& git, const std::string& commit_hash);
+    int diff(MyGit& git);
+    int checkout(MyGit& git, const std::string& commit_hash);
+    int branch(MyGit& git);
+    int switchBranch(MyGit& git, const std::string& name, bool create);
+    
+    // Exit code 1 when the merge stopped on conflicts
+    int merge(MyGit& git, const std::string& name);
+    int mergeBase(MyGit& git, const std::string& one, const std::string& two);
+    int gc(MyGit& git, bool prune, long grace_seconds);
+    int fsck(MyGit& git);
+    int repack(MyGit& git);
+    
+    // Lines as "[<rev>:]<path>:[<line>:]<text>" in Git's colors; exit code
+    // 1 when nothing matched
+    int grep(MyGit& git, const GrepOptions& options, const std::string& rev, bool line_numbers, bool names_only);
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "commit_graph.h"
+#include "pack.h"
+#include "utils.h"
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+
+namespace {
+    const uint32_t SEED0 = 0x293ae76f;
+    const uint32_t SEED1 = 0x7e646e2c;
+
+    // Magic, version, hash size, commit, edge and Bloom byte counts
+    const size_t HEADER_SIZE = 24;
+    const size_t FANOUT_SIZE = 256 * 4;
+
+    void appendBE32(std::string& out, uint32_t value) {
+        char bytes[4] = {char(value >> 24), char(value >> 16), char(value >> 8), char(value)};
+        out.append(bytes, 4);
+    }
+
+    uint32_t readBE32(const char* p) {
+        const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+        return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | u[3];
+    }
+
+    uint32_t rotl(uint32_t x, int r) {
+        return (x << r) | (x >> (32 - r));
+    }
+
+    // 32-bit murmur3, as Git computes changed-path keys
+    uint32_t murmur3(std::string_view data, uint32_t seed) {
+        const uint32_t c1 = 0xcc9e2d51, c2 = 0x1b873593;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+        size_t blocks = data.size() / 4;
+        uint32_t h = seed;
+
+        for (size_t i = 0; i < blocks; i++) {
+            uint32_t k = uint32_t(p[4 * i]) | (uint32_t(p[4 * i + 1]) << 8) |
+                         (uint32_t(p[4 * i + 2]) << 16) | (uint32_t(p[4 * i + 3]) << 24);
+            k *= c1;
+            k = rotl(k, 15);
+            k *= c2;
+            h ^= k;
+            h = rotl(h, 13);
+            h = h * 5 + 0xe6546b64;
+        }
+
+        const unsigned char* tail = p + blocks * 4;
+        uint32_t k = 0;
+        switch (data.size() & 3) {
+            case 3: k ^= uint32_t(tail[2]) << 16; // fall through
+            case 2: k ^= uint32_t(tail[1]) << 8;  // fall through
+            case 1:
+                k ^= tail[0];
+                k *= c1;
+                k = rotl(k, 15);
+                k *= c2;
+                h ^= k;
+        }
+
+        h ^= uint32_t(data.size());
+        h ^= h >> 16;
+        h *= 0x85ebca6b;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35;
+        h ^= h >> 16;
+        return h;
+    }
+}
+
+BloomFilter::Key::Key(std::string_view path) {
+    uint32_t h0 = murmur3(path, SEED0);
+    uint32_t h1 = murmur3(path, SEED1);
+    for (int i = 0; i < HASHES; i++) {
+        probes[i] = h0 + uint32_t(i) * h1;
+    }
+}
+
+std::string BloomFilter::build(const std::vector<std::string>& paths) {
+    if (paths.size() > MAX_PATHS) {
+        return std::string(1, '\xff');
+    }
+    size_t bytes = std::max<size_t>(1, (paths.size() * BITS_PER_PATH + 7) / 8);
+    std::string filter(bytes, '\0');
+    for (const auto& path : paths) {
+        Key key(path);
+        for (uint32_t probe : key.probes) {
+            size_t bit = probe % (bytes * 8);
+            filter[bit / 8] |= char(1 << (bit % 8));
+        }
+    }
+    return filter;
+}
+
+bool BloomFilter::mayContain(std::string_view filter, const Key& key) {
+    if (filter.empty()) {
+        return true;
+    }
+    size_t bits = filter.size() * 8;
+    for (uint32_t probe : key.probes) {
+        size_t bit = probe % bits;
+        if (!(filter[bit / 8] & (1 << (bit % 8)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CommitGraph::CommitGraph(const std::string& path, ObjectFormat format)
+    : hash_size(format.rawSize()), count(0), fanout(nullptr), hashes(nullptr), data(nullptr),
+      edges(nullptr), edge_count(0), bloom_index(nullptr), bloom_data(nullptr), bloom_size(0), opened(false) {
+    if (!file.open(path) || file.size() < HEADER_SIZE + FANOUT_SIZE + hash_size ||
+        memcmp(file.data(), "MGCG", 4) != 0 || readBE32(file.data() + 4) != 1 ||
+        readBE32(file.data() + 8) != hash_size) {
+        return;
+    }
+
+    count = readBE32(file.data() + 12);
+    edge_count = readBE32(file.data() + 16);
+    bloom_size = readBE32(file.data() + 20);
+    uint64_t expected = HEADER_SIZE + FANOUT_SIZE + uint64_t(count) * (hash_size + recordSize() + 4) +
+                        uint64_t(edge_count) * 4 + bloom_size + hash_size;
+    if (expected != file.size()) {
+        return;
+    }
+
+    fanout = file.data() + HEADER_SIZE;
+    hashes = fanout + FANOUT_SIZE;
+    data = hashes + size_t(count) * hash_size;
+    edges = data + size_t(count) * recordSize();
+    bloom_index = edges + size_t(edge_count) * 4;
+    bloom_data = bloom_index + size_t(count) * 4;
+    opened = readBE32(fanout + 255 * 4) == count;
+}
+
+bool CommitGraph::lookup(const std::string& hash, uint32_t& pos) const {
+    std::string raw = PackFormat::hexToRaw(hash);
+    if (!opened || raw.size() != hash_size) return false;
+
+    unsigned char first = static_cast<unsigned char>(raw[0]);
+    uint32_t lo = first == 0 ? 0 : readBE32(fanout + (first - 1) * 4);
+    uint32_t hi = readBE32(fanout + first * 4);
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(hashes + size_t(mid) * hash_size, raw.data(), hash_size);
+        if (cmp == 0) {
+            pos = mid;
+            return true;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+std::string CommitGraph::hash(uint32_t pos) const {
+    return PackFormat::rawToHex(std::string(hashes + size_t(pos) * hash_size, hash_size));
+}
+
+std::string CommitGraph::tree(uint32_t pos) const {
+    return PackFormat::rawToHex(std::string(data + size_t(pos) * recordSize(), hash_size));
+}
+
+uint32_t CommitGraph::generation(uint32_t pos) const {
+    return readBE32(data + size_t(pos) * recordSize() + hash_size);
+}
+
+uint32_t CommitGraph::parentCount(uint32_t pos) const {
+    return readBE32(data + size_t(pos) * recordSize() + hash_size + 8);
+}
+
+uint32_t CommitGraph::parent(uint32_t pos, uint32_t i) const {
+    uint32_t edge = readBE32(data + size_t(pos) * recordSize() + hash_size + 4) + i;
+    uint32_t target = edge < edge_count ? readBE32(edges + size_t(edge) * 4) : NONE;
+    return target < count ? target : NONE;
+}
+
+bool CommitGraph::mayHaveChanged(uint32_t pos, const BloomFilter::Key& key) const {
+    uint32_t begin = pos == 0 ? 0 : readBE32(bloom_index + size_t(pos - 1) * 4);
+    uint32_t end = readBE32(bloom_index + size_t(pos) * 4);
+    if (begin > end || end > bloom_size) {
+        return true;
+    }
+    return BloomFilter::mayContain(std::string_view(bloom_data + begin, end - begin), key);
+}
+
+bool CommitGraph::write(const std::string& path, ObjectFormat format, const std::vector<Commit>& commits) {
+    // Generations follow the given order, positions the sorted one
+    std::unordered_map<std::string, uint32_t> generations;
+    for (const auto& commit : commits) {
+        uint32_t generation = 1;
+        for (const auto& parent : commit.parents) {
+            auto found = generations.find(parent);
+            if (found != generations.end()) {
+                generation = std::max(generation, found->second + 1);
+            }
+        }
+        generations[commit.hash] = generation;
+    }
+
+    std::vector<const Commit*> sorted;
+    for (const auto& commit : commits) {
+        sorted.push_back(&commit);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Commit* a, const Commit* b) { return a->hash < b->hash; });
+    std::unordered_map<std::string, uint32_t> positions;
+    for (uint32_t i = 0; i < sorted.size(); i++) {
+        positions[sorted[i]->hash] = i;
+    }
+
+    uint32_t fanout[256] = {0};
+    std::string hashes, records, edges, bloom_index, bloom_data;
+    uint32_t edge_count = 0;
+    for (const Commit* commit : sorted) {
+        std::string raw = PackFormat::hexToRaw(commit->hash);
+        std::string tree = PackFormat::hexToRaw(commit->tree);
+        if (raw.size() != format.rawSize() || tree.size() != format.rawSize()) {
+            return false;
+        }
+        fanout[static_cast<unsigned char>(raw[0])]++;
+        hashes += raw;
+
+        records += tree;
+        appendBE32(records, generations[commit->hash]);
+        appendBE32(records, edge_count);
+        appendBE32(records, commit->parents.size());
+        for (const auto& parent : commit->parents) {
+            auto found = positions.find(parent);
+            appendBE32(edges, found == positions.end() ? NONE : found->second);
+            edge_count++;
+        }
+
+        bloom_data += commit->too_many ? std::string(1, '\xff') : BloomFilter::build(commit->changed);
+        appendBE32(bloom_index, bloom_data.size());
+    }
+
+    std::string out = "MGCG";
+    appendBE32(out, 1);
+    appendBE32(out, format.rawSize());
+    appendBE32(out, sorted.size());
+    appendBE32(out, edge_count);
+    appendBE32(out, bloom_data.size());
+    uint32_t total = 0;
+    for (int i = 0; i < 256; i++) {
+        total += fanout[i];
+        appendBE32(out, total);
+    }
+    out += hashes;
+    out += records;
+    out += edges;
+    out += bloom_index;
+    out += bloom_data;
+
+    Hasher hasher(format);
+    hasher.update(out);
+    out += PackFormat::hexToRaw(hasher.final());
+    return Utils::writeFileAtomic(path, out);
+}
@@ -0,0 +1,92 @@
+#ifndef COMMIT_GRAPH_H
+#define COMMIT_GRAPH_H
+
+#include "mapped_file.h"
+#include "object_format.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Bloom filter over the paths a commit changed relative to its first
+// parent, directory prefixes included. Keys use Git's parameters: two
+// murmur3 seeds combined into 7 probes, 10 bits per path.
+class BloomFilter {
+public:
+    static const int HASHES = 7;
+    static const int BITS_PER_PATH = 10;
+
+    // More changed paths than this and the commit gets a filter that
+    // matches everything
+    static const size_t MAX_PATHS = 512;
+
+    // Probes for one path, computed once per query
+    struct Key {
+        uint32_t probes[HASHES];
+        explicit Key(std::string_view path);
+    };
+
+    // Serialized filter for a set of paths; one zero byte when nothing
+    // changed, one 0xff byte when too much did
+    static std::string build(const std::vector<std::string>& paths);
+    static bool mayContain(std::string_view filter, const Key& key);
+};
+
+// objects/info/commit-graph: "MGCG", version 1, hash size, commit count,
+// parent edge count, Bloom data size, a 256-entry fan-out table and the
+// sorted raw commit hashes. Per commit follow its root tree, generation
+// number (1 for roots, else one more than the highest parent), first edge
+// and parent count; then the parent edges as positions, the end offset of
+// each commit's filter and the filter bytes. A trailing checksum covers
+// everything before it.
+//
+// Commits never change, so a graph stays correct as history grows; commits
+// made since it was written are simply not in it.
+class CommitGraph {
+public:
+    static const uint32_t NONE = 0xffffffff;
+
+    struct Commit {
+        std::string hash;
+        std::string tree;
+        std::vector<std::string> parents;
+        std::vector<std::string> changed;       // paths, for the filter
+        bool too_many = false;                  // changed was cut short
+    };
+
+    CommitGraph(const std::string& path, ObjectFormat format);
+
+    bool isOpen() const { return opened; }
+    uint32_t size() const { return count; }
+    bool lookup(const std::string& hash, uint32_t& pos) const;
+    std::string hash(uint32_t pos) const;
+    std::string tree(uint32_t pos) const;
+    uint32_t generation(uint32_t pos) const;
+    uint32_t parentCount(uint32_t pos) const;
+    uint32_t parent(uint32_t pos, uint32_t i) const;       // NONE if not in the graph
+
+    // False only when the commit certainly left the path unchanged
+    bool mayHaveChanged(uint32_t pos, const BloomFilter::Key& key) const;
+
+    // commits must list every parent before its children
+    static bool write(const std::string& path, ObjectFormat format, const std::vector<Commit>& commits);
+
+private:
+    MappedFile file;
+    size_t hash_size;
+    uint32_t count;
+    const char* fanout;
+    const char* hashes;
+    const char* data;
+    const char* edges;
+    uint32_t edge_count;
+    const char* bloom_index;
+    const char* bloom_data;
+    uint32_t bloom_size;
+    bool opened;
+
+    size_t recordSize() const { return hash_size + 12; }
+};
+
+#endif
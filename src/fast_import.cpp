@@ -0,0 +1,491 @@
+#include "mygit.h"
+#include "pack.h"
+#include "object_format.h"
+#include "utils.h"
+#include "trace.h"
+#include "tree_format.h"
+#include "refs.h"
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+
+// Bulk import from a command stream on stdin, written straight into a new
+// pack. The stream is a sequence of directives:
+//
+//   blob                      tree                       commit <branch>
+//   mark :1                   mark :2                    mark :3
+//   data <n>                  <mode> <ref> <name>        tree <ref>
+//   <n bytes>                 ...                        parent <ref>
+//                             end                        author <ident> <date>
+//                                                        data <n>
+//                                                        <n-byte message>
+//
+// "mark" lines are optional; a <ref> is either a mark or a full hash.
+// Each commit names the branch it goes on, "refs/heads/<name>"; the
+// branches move to their last commit once the pack is written, and the
+// worktree and index are left alone, as git fast-import leaves them.
+// Parsing and hashing happen on the calling thread, deflation on a pool of
+// workers, and a writer thread appends the results to the pack in input
+// order, so the stages overlap and memory is bounded by the in-flight window.
+
+namespace {
+    class StreamReader {
+    public:
+        explicit StreamReader(int fd) : fd(fd), buffer(1 << 20), pos(0), end(0) {}
+
+        bool readLine(std::string& line) {
+            line.clear();
+            while (true) {
+                const char* start = buffer.data() + pos;
+                const char* newline = static_cast<const char*>(memchr(start, '\n', end - pos));
+                if (newline) {
+                    line.append(start, newline);
+                    pos = newline - buffer.data() + 1;
+                    return true;
+                }
+                line.append(start, end - pos);
+                pos = end;
+                if (!fill()) return !line.empty();
+            }
+        }
+
+        // n comes from the stream, so the buffer only grows as the bytes
+        // actually arrive
+        bool readExact(size_t n, std::string& data) {
+            data.clear();
+            data.reserve(std::min(n, buffer.size()));
+            while (data.size() < n) {
+                if (pos == end && !fill()) return false;
+                size_t take = std::min(n - data.size(), end - pos);
+                data.append(buffer.data() + pos, take);
+                pos += take;
+            }
+            return true;
+        }
+
+    private:
+        int fd;
+        std::vector<char> buffer;
+        size_t pos;
+        size_t end;
+
+        bool fill() {
+            while (true) {
+                ssize_t n = ::read(fd, buffer.data(), buffer.size());
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                pos = 0;
+                end = n;
+                return true;
+            }
+        }
+    };
+
+    struct PendingObject {
+        std::string hash;
+        std::string type;
+        std::string content;
+        std::string deflated;
+    };
+
+    // Objects travel through the pipeline in batches so the threads hand
+    // off work once per batch rather than once per (often tiny) object
+    struct Batch {
+        std::vector<PendingObject> objects;
+        size_t bytes = 0;
+        bool done = false;
+    };
+
+    // Deflates batches on worker threads and hands them to the pack writer
+    // in submission order
+    class ImportPipeline {
+    public:
+        explicit ImportPipeline(PackWriter& writer) : writer(writer), current(std::make_shared<Batch>()),
+                                                      claimed(0), window_bytes(0), closed(false), error(false) {
+            unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned i = 0; i < workers; i++) {
+                threads.emplace_back([this]() { deflateLoop(); });
+            }
+            threads.emplace_back([this]() { writeLoop(); });
+        }
+
+        ~ImportPipeline() {
+            finish();
+        }
+
+        bool submit(std::string hash, std::string type, std::string content) {
+            current->bytes += content.size();
+            current->objects.push_back({std::move(hash), std::move(type), std::move(content), ""});
+            if (current->objects.size() < BATCH_OBJECTS && current->bytes < BATCH_BYTES) {
+                return true;
+            }
+            return push();
+        }
+
+        // Waits for every submitted object to be written
+        bool finish() {
+            if (threads.empty()) return !error;
+            push();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+            }
+            work.notify_all();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            threads.clear();
+            return !error;
+        }
+
+    private:
+        static const size_t BATCH_OBJECTS = 256;
+        static const size_t BATCH_BYTES = 1 << 20;
+        static const size_t MAX_BYTES = 64 << 20;
+
+        PackWriter& writer;
+        std::shared_ptr<Batch> current;
+        std::mutex mutex;
+        std::condition_variable work;
+        std::condition_variable space;
+        std::deque<std::shared_ptr<Batch>> window;
+        size_t claimed;
+        size_t window_bytes;
+        bool closed;
+        bool error;
+        std::vector<std::thread> threads;
+
+        bool push() {
+            if (current->objects.empty()) return !error;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            space.wait(lock, [this]() { return error || window_bytes < MAX_BYTES; });
+            if (error) return false;
+
+            window_bytes += current->bytes;
+            window.push_back(current);
+            current = std::make_shared<Batch>();
+            work.notify_all();
+            return true;
+        }
+
+        void deflateLoop() {
+            Deflater deflater;
+            while (true) {
+                std::shared_ptr<Batch> batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    work.wait(lock, [this]() { return error || claimed < window.size() || closed; });
+                    if (error || claimed == window.size()) return;
+                    batch = window[claimed++];
+                }
+
+                for (auto& object : batch->objects) {
+                    object.deflated = deflater.deflate(object.content);
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                batch->done = true;
+                work.notify_all();
+            }
+        }
+
+        void writeLoop() {
+            while (true) {
+                std::shared_ptr<Batch> batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    work.wait(lock, [this]() {
+                        return error || (!window.empty() && window.front()->done) || (closed && window.empty());
+                    });
+                    if (error || window.empty()) return;
+                    batch = window.front();
+                    window.pop_front();
+                    claimed--;
+                }
+
+                bool ok = true;
+                for (const auto& object : batch->objects) {
+                    ok = ok && !object.deflated.empty() &&
+                         writer.append(object.hash, object.type, object.content.size(), object.deflated);
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                window_bytes -= batch->bytes;
+                if (!ok) {
+                    error = true;
+                    work.notify_all();
+                }
+                space.notify_all();
+            }
+        }
+    };
+
+    bool parseDataLength(const std::string& line, size_t& length) {
+        if (line.compare(0, 5, "data ") != 0 || line.find_first_not_of("0123456789", 5) != std::string::npos) {
+            return false;
+        }
+        try {
+            size_t used = 0;
+            length = std::stoull(line.substr(5), &used);
+            return used == line.size() - 5 && length <= std::string().max_size();
+        } catch (...) {
+            return false;
+        }
+    }
+}
+
+bool MyGit::fastImport(int in_fd, const std::string& marks_path) {
+    if (!isRepository()) {
+        fail("Not a MyGit repository");
+        return false;
+    }
+
+    ObjectFormat object_format = objectFormat();
+    Utils::createDirectory(packs_path);
+    PackWriter writer(packs_path, object_format);
+    if (!writer.open()) {
+        fail("Cannot create pack in " + packs_path);
+        return false;
+    }
+
+    int format = treeFormat();
+    StreamReader in(in_fd);
+    std::unordered_map<std::string, std::string> marks;
+    std::unordered_set<std::string> written;
+    std::unordered_set<std::string> commit_hashes;
+    // branch -> (its tip before the import, its last imported commit)
+    std::map<std::string, std::pair<std::string, std::string>> branches;
+    size_t blobs = 0, trees = 0, commits = 0;
+    std::string line;
+    bool ok = true;
+
+    {
+        ImportPipeline pipeline(writer);
+
+        auto resolve = [&](const std::string& ref, std::string& hash) {
+            if (!ref.empty() && ref[0] == ':') {
+                auto it = marks.find(ref);
+                if (it == marks.end()) return false;
+                hash = it->second;
+                return true;
+            }
+            hash = ref;
+            return object_format.isHash(ref);
+        };
+
+        // Hashes here, deflates and writes on the pipeline threads
+        auto emit = [&](const std::string& type, std::string content, const std::string& mark) {
+            std::string header = type + " " + std::to_string(content.size());
+            std::string hash;
+            {
+                Trace::Scope scope(Trace::HASH);
+                Hasher checksum(object_format);
+                checksum.update(header.c_str(), header.size() + 1);
+                checksum.update(content);
+                hash = checksum.final();
+            }
+
+            if (!mark.empty()) {
+                marks[mark] = hash;
+            }
+
+            if (written.count(hash) || hasObject(hash)) {
+                Trace::count(Trace::OBJECTS_EXISTING);
+                return hash;
+            }
+            written.insert(hash);
+
+            if (!pipeline.submit(hash, type, std::move(content))) {
+                return std::string();
+            }
+            return hash;
+        };
+
+        // Reads the optional "mark :<n>" line that follows a directive
+        auto readMark = [&](std::string& mark) {
+            if (!in.readLine(line)) return false;
+            mark.clear();
+            if (line.compare(0, 6, "mark :") == 0) {
+                mark = line.substr(5);
+                if (mark.size() < 2 || mark.find_first_not_of("0123456789", 1) != std::string::npos) {
+                    return false;
+                }
+                return in.readLine(line);
+            }
+            return true;
+        };
+
+        while (ok && in.readLine(line)) {
+            if (line.empty() || line[0] == '#') continue;
+
+            std::string directive = line;
+            std::string mark;
+            size_t length = 0;
+
+            if (directive == "blob") {
+                std::string data;
+                if (!readMark(mark) || !parseDataLength(line, length) || !in.readExact(length, data)) {
+                    fail("fast-import: malformed blob");
+                    ok = false;
+                    break;
+                }
+                ok = !emit("blob", std::move(data), mark).empty();
+                blobs++;
+            } else if (directive == "tree") {
+                // Encoded the same way write-tree encodes, so identical
+                // trees hash identically whichever way they were created
+                std::vector<TreeEntry> entries;
+                bool valid = readMark(mark);
+                while (valid && line != "end") {
+                    size_t first = line.find(' ');
+                    size_t second = first == std::string::npos ? first : line.find(' ', first + 1);
+                    std::string hash;
+                    if (second == std::string::npos ||
+                        !resolve(line.substr(first + 1, second - first - 1), hash)) {
+                        valid = false;
+                        break;
+                    }
+                    entries.push_back({line.substr(0, first), "", hash, line.substr(second + 1)});
+                    valid = in.readLine(line);
+                }
+                if (!valid) {
+                    fail("fast-import: malformed tree entry: " + line);
+                    ok = false;
+                    break;
+                }
+
+                ok = !emit("tree", TreeFormat::encode(entries, format), mark).empty();
+                trees++;
+            } else if (directive.compare(0, 7, "commit ") == 0) {
+                std::string branch = directive.substr(7);
+                if (branch.compare(0, 11, "refs/heads/") != 0 || !Refs::isValidBranchName(branch.substr(11))) {
+                    fail("fast-import: commit needs a branch as refs/heads/<name>: " + directive);
+                    ok = false;
+                    break;
+                }
+
+                std::string tree_hash, author, message;
+                std::vector<std::string> parents;
+                bool valid = readMark(mark);
+                while (valid && line.compare(0, 5, "data ") != 0) {
+                    std::string hash;
+                    if (line.compare(0, 5, "tree ") == 0 && resolve(line.substr(5), hash)) {
+                        tree_hash = hash;
+                    } else if (line.compare(0, 7, "parent ") == 0 && resolve(line.substr(7), hash)) {
+                        // A parent is a commit from this stream or one
+                        // already in the repository
+                        std::string type;
+                        size_t size = 0;
+                        if (!commit_hashes.count(hash) && (!objectInfo(hash, type, size) || type != "commit")) {
+                            fail("fast-import: parent is not a known commit: " + line.substr(7));
+                            ok = false;
+                            break;
+                        }
+                        parents.push_back(hash);
+                    } else if (line.compare(0, 7, "author ") == 0) {
+                        author = line.substr(7);
+                    } else {
+                        valid = false;
+                        break;
+                    }
+                    valid = in.readLine(line);
+                }
+                if (!ok) {
+                    break;
+                }
+                if (!valid || tree_hash.empty() || !parseDataLength(line, length) || !in.readExact(length, message)) {
+                    fail("fast-import: malformed commit: " + line);
+                    ok = false;
+                    break;
+                }
+
+                if (author.empty()) {
+                    author = "MyGit <mygit@example.com> " + Utils::getCurrentTimestamp();
+                }
+                if (message.empty() || message.back() != '\n') {
+                    message += '\n';
+                }
+
+                std::string content = "tree " + tree_hash + "\n";
+                for (const auto& parent : parents) {
+                    content += "parent " + parent + "\n";
+                }
+                content += "author " + author + "\n";
+                content += "committer " + author + "\n";
+                content += "\n" + message;
+
+                std::string hash = emit("commit", std::move(content), mark);
+                ok = !hash.empty();
+                commit_hashes.insert(hash);
+                if (!branches.count(branch)) {
+                    branches[branch].first = resolveRef(branch);
+                }
+                branches[branch].second = hash;
+                commits++;
+            } else {
+                fail("fast-import: unsupported directive: " + directive);
+                ok = false;
+            }
+        }
+
+        if (!pipeline.finish() && ok) {
+            fail("fast-import: failed writing pack");
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        return false;
+    }
+
+    if (writer.objectCount() > 0) {
+        std::string pack = writer.finish();
+        if (pack.empty()) {
+            fail("fast-import: failed writing pack");
+            return false;
+        }
+        reloadPacks();
+        reporter->info("Wrote " + std::to_string(writer.objectCount()) + " object(s) to " + pack);
+    }
+
+    if (!marks_path.empty()) {
+        std::vector<std::pair<unsigned long long, std::string>> sorted;
+        for (const auto& mark : marks) {
+            sorted.push_back({std::stoull(mark.first.substr(1)), mark.second});
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        std::string out;
+        for (const auto& mark : sorted) {
+            out += ":" + std::to_string(mark.first) + " " + mark.second + "\n";
+        }
+        if (!Utils::writeFile(marks_path, out)) {
+            fail("Unable to write " + marks_path);
+            return false;
+        }
+    }
+
+    std::string current = "refs/heads/" + currentBranch();
+    for (const auto& branch : branches) {
+        if (!updateRef(branch.first, branch.second.second, branch.second.first)) {
+            return false;
+        }
+        if (branch.first == current && !branch.second.first.empty()) {
+            reporter->warning(branch.first + " is checked out; the worktree and index still hold its old commit");
+        }
+    }
+
+    reporter->success("Imported " + std::to_string(blobs) + " blob(s), " + std::to_string(trees) +
+                      " tree(s), " + std::to_string(commits) + " commit(s)");
+    return true;
+}
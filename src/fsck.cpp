@@ -0,0 +1,244 @@
+#include "mygit.h"
+#include "pack.h"
+#include "object_format.h"
+#include "utils.h"
+#include "object_reader.h"
+#include "thread_pool.h"
+#include "tree_format.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+    // Pack entries verified per task
+    const uint32_t PACK_SLICE = 4096;
+
+    // A link from one object to another, with the type the target must have
+    struct Link {
+        std::string from;
+        std::string to;         // raw hash
+        const char* expected;
+    };
+
+    // What one task found; merged into the shared result when it finishes
+    struct Findings {
+        std::vector<std::pair<std::string, std::string>> objects;  // raw hash, type
+        std::vector<Link> links;
+        std::vector<FsckProblem> corrupt;
+    };
+
+    // Checks the syntax of a commit, tree or manifest and collects the
+    // objects it refers to; returns "" or what is wrong with it
+    std::string parseLinks(ObjectFormat format, const std::string& hash, const std::string& type,
+                           const std::string& content, std::vector<Link>& links) {
+        std::string_view data(content);
+        
+        if (type == "commit") {
+            bool has_tree = false, has_author = false;
+            size_t pos = 0;
+            while (true) {
+                size_t end = data.find('\n', pos);
+                if (end == std::string_view::npos) return "unterminated commit header";
+                std::string_view line = data.substr(pos, end - pos);
+                pos = end + 1;
+                if (line.empty()) break;
+                
+                if (line.compare(0, 5, "tree ") == 0) {
+                    if (has_tree || !format.isHash(line.substr(5))) return "bad tree line";
+                    links.push_back({hash, PackFormat::hexToRaw(std::string(line.substr(5))), "tree"});
+                    has_tree = true;
+                } else if (line.compare(0, 7, "parent ") == 0) {
+                    if (!has_tree || !format.isHash(line.substr(7))) return "bad parent line";
+                    links.push_back({hash, PackFormat::hexToRaw(std::string(line.substr(7))), "commit"});
+                } else if (line.compare(0, 7, "author ") == 0) {
+                    has_author = true;
+                } else if (!has_tree) {
+                    return "commit does not start with a tree";
+                }
+            }
+            if (!has_tree) return "missing tree line";
+            if (!has_author) return "missing author line";
+            return "";
+        }
+        
+        if (type == "tree") {
+            std::vector<TreeEntry> entries;
+            if (!TreeFormat::decode(data, entries, format.rawSize())) return "malformed tree";
+            for (const auto& entry : entries) {
+                if (entry.name == "." || entry.name == ".." || entry.name.find('/') != std::string::npos) return "bad name in tree";
+                links.push_back({hash, PackFormat::hexToRaw(entry.hash), entry.type == "tree" ? "tree" : "blob"});
+            }
+            return "";
+        }
+        
+        if (type == "manifest") {
+            // "<hash> <size>" per chunk
+            size_t hex_size = format.hexSize();
+            size_t pos = 0;
+            while (pos < data.size()) {
+                size_t end = data.find('\n', pos);
+                if (end == std::string_view::npos) end = data.size();
+                std::string_view line = data.substr(pos, end - pos);
+                pos = end + 1;
+                
+                if (line.size() < hex_size + 2 || line[hex_size] != ' ' || !format.isHash(line.substr(0, hex_size)) ||
+                    line.find_first_not_of("0123456789", hex_size + 1) != std::string_view::npos) {
+                    return "bad manifest line";
+                }
+                links.push_back({hash, PackFormat::hexToRaw(std::string(line.substr(0, hex_size))), "blob"});
+            }
+            return "";
+        }
+        
+        return type == "blob" ? "" : "unknown object type '" + type + "'";
+    }
+
+    // Recomputes the hash of an object read from disk and checks its syntax
+    void verify(ObjectFormat format, const std::string& hash, const std::string& type, const std::string& content,
+                Findings& found) {
+        if (Hasher::object(format, type, content) != hash) {
+            found.corrupt.push_back({hash, "hash mismatch"});
+            return;
+        }
+        
+        std::string error = parseLinks(format, hash, type, content, found.links);
+        if (!error.empty()) {
+            found.corrupt.push_back({hash, error});
+        }
+    }
+}
+
+bool MyGit::fsck(FsckReport& report) {
+    if (!isRepository()) {
+        fail("Not a MyGit repository");
+        return false;
+    }
+    
+    report = FsckReport();
+    std::vector<std::pair<std::string, std::string>> roots;
+    if (!reachabilityRoots(roots)) {
+        return false;
+    }
+    loadPacks();
+    ObjectFormat format = objectFormat();
+    
+    std::mutex mutex;
+    std::unordered_map<std::string, std::string> objects;   // raw hash to type
+    std::vector<Link> links;
+    
+    auto merge = [&](Findings& found) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& object : found.objects) {
+            objects.emplace(std::move(object.first), std::move(object.second));
+        }
+        links.insert(links.end(), std::make_move_iterator(found.links.begin()), std::make_move_iterator(found.links.end()));
+        report.corrupt.insert(report.corrupt.end(), found.corrupt.begin(), found.corrupt.end());
+        report.checked += found.objects.size();
+    };
+    
+    {
+        // One task per loose fan-out directory and per slice of each pack,
+        // so inflating and hashing keep every core busy
+        ThreadPool pool;
+        
+        for (int i = 0; i < 256; i++) {
+            static const char digits[] = "0123456789abcdef";
+            std::string prefix = {digits[i >> 4], digits[i & 15]};
+            
+            pool.submit([&, prefix]() {
+                Findings found;
+                for (const auto& name : Utils::listDirectory(objects_path + "/" + prefix)) {
+                    std::string hash = prefix + name;
+                    if (!format.isHash(hash)) continue;
+                    found.objects.push_back({PackFormat::hexToRaw(hash), ""});
+                    
+                    ObjectReader reader(objects_path + "/" + prefix + "/" + name);
+                    if (!reader.readHeader()) {
+                        found.corrupt.push_back({hash, "unreadable object header"});
+                        continue;
+                    }
+                    found.objects.back().second = reader.type();
+                    std::string content = reader.readContent();
+                    if (reader.failed() || content.size() != reader.size()) {
+                        found.corrupt.push_back({hash, "truncated or corrupt object data"});
+                        continue;
+                    }
+                    verify(format, hash, reader.type(), content, found);
+                }
+                merge(found);
+            });
+        }
+        
+        for (const auto& pack : packs) {
+            const Pack* p = pack.get();
+            pool.submit([&, p]() {
+                if (!p->verifyChecksum()) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    report.corrupt.push_back({p->path(), "pack checksum mismatch"});
+                }
+            });
+            
+            for (uint32_t start = 0; start < p->objectCount(); start += PACK_SLICE) {
+                pool.submit([&, p, start]() {
+                    Findings found;
+                    uint32_t end = std::min(p->objectCount(), start + PACK_SLICE);
+                    for (uint32_t i = start; i < end; i++) {
+                        std::string hash = p->hashAt(i);
+                        std::string type, content;
+                        uint64_t offset;
+                        found.objects.push_back({PackFormat::hexToRaw(hash), ""});
+                        if (!p->offsetAt(i, offset) || !p->read(offset, type, content)) {
+                            found.corrupt.push_back({hash, "corrupt packed object in " + p->path()});
+                            continue;
+                        }
+                        found.objects.back().second = type;
+                        verify(format, hash, type, content, found);
+                    }
+                    merge(found);
+                });
+            }
+        }
+        pool.wait();
+    }
+    
+    // Connectivity: every link and root must name a present object of the
+    // right type; present objects nothing refers to are dangling
+    std::unordered_set<std::string> referenced;
+    std::unordered_set<std::string> reported;
+    auto check = [&](const std::string& from, const std::string& raw, const char* expected) {
+        referenced.insert(raw);
+        auto object = objects.find(raw);
+        std::string hash = PackFormat::rawToHex(raw);
+        if (object == objects.end()) {
+            if (reported.insert(raw).second) {
+                report.missing.push_back({hash, "referenced by " + from});
+            }
+        } else if (expected && !object->second.empty() && object->second != expected &&
+                   !(object->second == "manifest" && std::string(expected) == "blob")) {
+            report.corrupt.push_back({from, "links to " + object->second + " " + hash + " where a " + expected + " is expected"});
+        }
+    };
+    for (const auto& link : links) {
+        check(link.from, link.to, link.expected);
+    }
+    for (const auto& root : roots) {
+        std::string raw = PackFormat::hexToRaw(root.second);
+        if (raw.empty()) {
+            report.missing.push_back({root.second, "invalid hash in " + root.first});
+        } else {
+            check(root.first, raw, root.first.compare(0, 6, "index:") == 0 ? "blob" : "commit");
+        }
+    }
+    for (const auto& object : objects) {
+        if (!referenced.count(object.first)) {
+            report.dangling.push_back({PackFormat::rawToHex(object.first), object.second});
+        }
+    }
+    
+    auto byHash = [](const FsckProblem& a, const FsckProblem& b) { return a.hash < b.hash; };
+    std::sort(report.corrupt.begin(), report.corrupt.end(), byHash);
+    std::sort(report.missing.begin(), report.missing.end(), byHash);
+    std::sort(report.dangling.begin(), report.dangling.end(), byHash);
+    return true;
+}
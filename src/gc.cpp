@@ -0,0 +1,124 @@
+#include "mygit.h"
+#include "pack.h"
+#include "refs.h"
+#include "utils.h"
+#include "trace.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <filesystem>
+#include <ctime>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+bool MyGit::reachabilityRoots(std::vector<std::pair<std::string, std::string>>& roots) {
+    // Every ref, a detached HEAD, and whatever is staged
+    for (const auto& ref : PackedRefs(packed_refs_path).list()) {
+        roots.push_back(ref);
+    }
+    try {
+        for (const auto& entry : fs::recursive_directory_iterator(refs_path)) {
+            std::string path = entry.path().string();
+            if (entry.is_regular_file() && path.compare(path.size() - 5, 5, ".lock") != 0) {
+                std::string refname = path.substr(repo_path.size() + 1);
+                roots.push_back({refname, resolveRef(refname)});
+            }
+        }
+    } catch (const std::exception& e) {
+        fail(std::string("Error reading refs: ") + e.what());
+        return false;
+    }
+    std::string head = getCurrentCommit();
+    if (!head.empty()) {
+        roots.push_back({"HEAD", head});
+    }
+    std::string merge_head = readMergeHead();
+    if (!merge_head.empty()) {
+        roots.push_back({"MERGE_HEAD", merge_head});
+    }
+    for (const auto& entry : readIndex()) {
+        roots.push_back({"index:" + entry.first, entry.second});
+    }
+    return true;
+}
+
+bool MyGit::gc(bool prune, long grace_seconds, GcStats& stats) {
+    if (!isRepository()) {
+        fail("Not a MyGit repository");
+        return false;
+    }
+    
+    stats = GcStats();
+    
+    // repack walks everything reachable and packs only that, so a loose
+    // object is reachable exactly when the new pack holds it. Unreachable
+    // packed objects come back loose, or are dropped once past the grace
+    // period when pruning.
+    RepackStats repacked;
+    if (!packRefs() || !repack(repacked, prune ? grace_seconds : -1)) {
+        return false;
+    }
+    stats.packed = repacked.objects;
+    stats.reachable = repacked.objects;
+    stats.missing = repacked.missing;
+    
+    loadPacks();
+    auto packed = [&](const std::string& hash) {
+        uint64_t offset;
+        for (const auto& pack : packs) {
+            if (pack->find(hash, offset)) return true;
+        }
+        return false;
+    };
+    
+    // Sweep each fan-out directory on its own task. Young objects survive
+    // whatever their reachability, since a concurrent add or commit may be
+    // about to reference them.
+    std::atomic<size_t> loose(0), unreachable(0), pruned(0);
+    std::atomic<uint64_t> bytes(0);
+    time_t now = time(nullptr);
+    {
+        ThreadPool pool;
+        for (int i = 0; i < 256; i++) {
+            static const char digits[] = "0123456789abcdef";
+            std::string prefix = {digits[i >> 4], digits[i & 15]};
+            
+            pool.submit([&, prefix]() {
+                std::string dir = objects_path + "/" + prefix;
+                for (const auto& name : Utils::listDirectory(dir)) {
+                    std::string path = dir + "/" + name;
+                    struct stat st;
+                    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+                    bool expired = now - st.st_mtime >= grace_seconds;
+                    
+                    // Leftovers from interrupted object writes
+                    if (name.compare(0, 4, "tmp_") == 0) {
+                        if (prune && expired) unlink(path.c_str());
+                        continue;
+                    }
+                    
+                    if (PackFormat::hexToRaw(prefix + name).empty()) continue;
+                    loose++;
+                    if (packed(prefix + name)) continue;
+                    
+                    unreachable++;
+                    if (prune && expired && unlink(path.c_str()) == 0) {
+                        pruned++;
+                        bytes += st.st_size;
+                    }
+                }
+                if (prune) {
+                    rmdir(dir.c_str());
+                }
+            });
+        }
+        pool.wait();
+    }
+    
+    stats.loose = loose;
+    stats.unreachable = unreachable + repacked.dropped;
+    stats.pruned = pruned + repacked.dropped;
+    stats.bytes_pruned = bytes;
+    return true;
+}
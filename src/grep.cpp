@@ -0,0 +1,280 @@
+#include "grep.h"
+#include "mygit.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+
+namespace {
+    const char* const REGEX_SPECIAL = ".[]()*+?{}|^$";
+
+    // The longest run of plain characters outside any group that every
+    // match must contain, or "" when a top-level alternation means there
+    // is none. plain is left true only if the pattern is that run.
+    std::string requiredLiteral(const std::string& pattern, bool& plain) {
+        std::string best, run;
+        int depth = 0;
+        plain = true;
+        auto flush = [&]() {
+            if (run.size() > best.size()) best = run;
+            run.clear();
+        };
+
+        for (size_t i = 0; i < pattern.size(); i++) {
+            char c = pattern[i];
+            if (c == '\\' && i + 1 < pattern.size()) {
+                // Escaped letters and digits are classes or back-references
+                c = pattern[++i];
+                if (isalnum(static_cast<unsigned char>(c))) {
+                    plain = false;
+                    flush();
+                    continue;
+                }
+            } else if (strchr(REGEX_SPECIAL, c)) {
+                plain = false;
+                flush();
+                if (c == '|' && depth == 0) {
+                    return "";
+                } else if (c == '(') {
+                    depth++;
+                } else if (c == ')') {
+                    depth--;
+                } else if (c == '[') {
+                    // "]" right after "[" or "[^" is a member, not the end
+                    size_t j = i + 1;
+                    if (j < pattern.size() && pattern[j] == '^') j++;
+                    if (j < pattern.size() && pattern[j] == ']') j++;
+                    while (j < pattern.size() && pattern[j] != ']') j++;
+                    i = j;
+                }
+                continue;
+            }
+
+            char next = i + 1 < pattern.size() ? pattern[i + 1] : '\0';
+            if (depth > 0) continue;
+            if (next == '*' || next == '?' || next == '{') {
+                plain = false;
+                flush();
+                continue;
+            }
+            run += c;
+        }
+        flush();
+        return best;
+    }
+}
+
+bool LineMatcher::compile(const std::string& pattern, bool icase, std::string& error) {
+    ignore_case = icase;
+    literal = requiredLiteral(pattern, literal_only);
+    if (ignore_case) {
+        std::transform(literal.begin(), literal.end(), literal.begin(),
+                       [](unsigned char c) { return static_cast<char>(tolower(c)); });
+    }
+    if (literal_only) {
+        return true;
+    }
+
+    try {
+        auto flags = std::regex::extended | std::regex::nosubs | std::regex::optimize;
+        regex = std::regex(pattern, ignore_case ? flags | std::regex::icase : flags);
+    } catch (const std::regex_error& e) {
+        error = "Invalid pattern '" + pattern + "': " + e.what();
+        return false;
+    }
+    return true;
+}
+
+size_t LineMatcher::find(std::string_view data, size_t from) const {
+    if (!ignore_case) {
+        const void* hit = memmem(data.data() + from, data.size() - from, literal.data(), literal.size());
+        return hit ? static_cast<const char*>(hit) - data.data() : std::string_view::npos;
+    }
+
+    // Candidates are the places either case of the first byte occurs; the
+    // next of each is only looked for again once passed
+    const char* base = data.data();
+    const char* end = base + data.size();
+    unsigned char lower = literal[0];
+    unsigned char upper = toupper(lower);
+    const char* next_lower = nullptr;
+    const char* next_upper = upper == lower ? end : nullptr;
+    for (size_t pos = from; pos + literal.size() <= data.size(); pos++) {
+        if (!next_lower || next_lower < base + pos) {
+            const void* p = memchr(base + pos, lower, data.size() - pos);
+            next_lower = p ? static_cast<const char*>(p) : end;
+        }
+        if (!next_upper || next_upper < base + pos) {
+            const void* p = memchr(base + pos, upper, data.size() - pos);
+            next_upper = p ? static_cast<const char*>(p) : end;
+        }
+        pos = std::min(next_lower, next_upper) - base;
+        if (pos + literal.size() > data.size()) break;
+
+        size_t i = 1;
+        while (i < literal.size() && tolower(static_cast<unsigned char>(data[pos + i])) == static_cast<unsigned char>(literal[i])) i++;
+        if (i == literal.size()) return pos;
+    }
+    return std::string_view::npos;
+}
+
+void LineMatcher::search(std::string_view data, const std::function<bool(size_t, std::string_view)>& found) const {
+    size_t pos = 0, line_number = 1, counted = 0;
+    while (pos < data.size()) {
+        size_t start = pos;
+        if (!literal.empty()) {
+            size_t hit = find(data, pos);
+            if (hit == std::string_view::npos) return;
+            const void* newline = memrchr(data.data() + pos, '\n', hit - pos);
+            if (newline) start = static_cast<const char*>(newline) - data.data() + 1;
+        }
+        const void* newline = memchr(data.data() + start, '\n', data.size() - start);
+        size_t end = newline ? static_cast<const char*>(newline) - data.data() : data.size();
+        std::string_view line = data.substr(start, end - start);
+
+        if (literal_only || std::regex_search(line.begin(), line.end(), regex)) {
+            line_number += std::count(data.begin() + counted, data.begin() + start, '\n');
+            counted = start;
+            if (!found(line_number, line)) return;
+        }
+        pos = end + 1;
+    }
+}
+
+bool LineMatcher::isBinary(std::string_view data) {
+    return memchr(data.data(), '\0', std::min<size_t>(data.size(), 8000)) != nullptr;
+}
+
+bool MyGit::grep(const GrepOptions& options, std::vector<GrepMatch>& matches) {
+    LineMatcher matcher;
+    std::string error;
+    if (!matcher.compile(options.pattern, options.ignore_case, error)) {
+        fail(error);
+        return false;
+    }
+
+    // (path, blob hash) per file; worktree files have no hash and are
+    // read from disk at their index path
+    std::vector<std::pair<std::string, std::string>> files;
+    loadPacks();
+    if (!options.commit.empty()) {
+        std::string type, content, tree = options.commit;
+        if (!peekObject(options.commit, type, &content) || (type != "commit" && type != "tree")) {
+            fail("Not a commit or tree: " + options.commit);
+            return false;
+        }
+        if (type == "commit") {
+            std::vector<std::string> parents;
+            commitLinks(content, tree, parents);
+        }
+
+        std::function<bool(const std::string&, const std::string&)> walk = [&](const std::string& hash,
+                                                                                const std::string& prefix) {
+            std::string tree_type, tree_content;
+            if (!peekObject(hash, tree_type, &tree_content) || tree_type != "tree") {
+                fail("Unable to read tree " + hash);
+                return false;
+            }
+            for (const auto& entry : parseTree(tree_content)) {
+                if (entry.type == "tree") {
+                    if (!walk(entry.hash, prefix + entry.name + "/")) return false;
+                } else if (entry.type == "blob") {
+                    files.push_back({prefix + entry.name, entry.hash});
+                }
+            }
+            return true;
+        };
+        if (!walk(tree, "")) {
+            return false;
+        }
+    } else {
+        for (const auto& entry : readIndex()) {
+            files.push_back({entry.first, options.cached ? entry.second : ""});
+        }
+    }
+
+    // Each distinct blob is searched once, for the first path it is at
+    std::vector<size_t> first_with(files.size());
+    std::vector<size_t> unique;
+    std::unordered_map<std::string, size_t> seen;
+    for (size_t i = 0; i < files.size(); i++) {
+        auto inserted = files[i].second.empty() ? std::make_pair(seen.end(), true)
+                                                : seen.insert({files[i].second, i});
+        first_with[i] = inserted.second ? i : inserted.first->second;
+        if (inserted.second) unique.push_back(i);
+    }
+
+    std::vector<std::vector<GrepMatch>> found(files.size());
+    std::atomic<size_t> unreadable(0);
+    {
+        ThreadPool pool;
+        for (size_t i : unique) {
+            pool.submit([&, i]() {
+                MappedFile mapped;
+                std::string content;
+                std::string_view data;
+                if (files[i].second.empty()) {
+                    if (!mapped.open(files[i].first)) return;
+                    data = std::string_view(mapped.data(), mapped.size());
+                } else {
+                    // A manifest stands in for a chunked blob
+                    std::string type;
+                    if (!peekObject(files[i].second, type, &content)) {
+                        unreadable++;
+                        return;
+                    }
+                    if (type == "manifest") {
+                        std::string whole, chunk;
+                        for (const auto& part : parseManifest(content)) {
+                            if (!peekObject(part.first, type, &chunk)) {
+                                unreadable++;
+                                return;
+                            }
+                            whole += chunk;
+                        }
+                        content.swap(whole);
+                    }
+                    data = content;
+                }
+
+                if (LineMatcher::isBinary(data)) {
+                    matcher.search(data, [&](size_t, std::string_view) {
+                        found[i].push_back({files[i].first, 0, ""});
+                        return false;
+                    });
+                    return;
+                }
+                matcher.search(data, [&](size_t line, std::string_view text) {
+                    found[i].push_back({files[i].first, line, std::string(text)});
+                    return true;
+                });
+            });
+        }
+        pool.wait();
+    }
+
+    // Index paths start with "./"; results are listed by path
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        order[i] = i;
+        if (files[i].first.compare(0, 2, "./") == 0) files[i].first.erase(0, 2);
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return files[a].first < files[b].first; });
+    matches.clear();
+    for (size_t i : order) {
+        for (const auto& match : found[first_with[i]]) {
+            matches.push_back(match);
+            matches.back().path = files[i].first;
+        }
+    }
+
+    if (unreadable > 0) {
+        fail(std::to_string(unreadable.load()) + " blob(s) could not be read");
+        return false;
+    }
+    return true;
+}
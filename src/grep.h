@@ -0,0 +1,34 @@
+#ifndef GREP_H
+#define GREP_H
+
+#include <string>
+#include <string_view>
+#include <regex>
+#include <functional>
+#include <cstddef>
+
+// Line matcher for grep. Patterns are POSIX extended regular expressions.
+// Each one is reduced to a literal that every match must contain, which is
+// found with memmem (SIMD in glibc) across the whole buffer; the regex only
+// runs on the lines holding it, and not at all for plain strings.
+class LineMatcher {
+public:
+    bool compile(const std::string& pattern, bool ignore_case, std::string& error);
+
+    // found(line number, line) for each matching line, in order, until it
+    // returns false
+    void search(std::string_view data, const std::function<bool(size_t, std::string_view)>& found) const;
+
+    // Text with a NUL in its first 8000 bytes, as Git decides
+    static bool isBinary(std::string_view data);
+
+private:
+    std::string literal;        // lowercased when ignoring case
+    bool literal_only = false;
+    bool ignore_case = false;
+    std::regex regex;
+
+    size_t find(std::string_view data, size_t from) const;
+};
+
+#endif
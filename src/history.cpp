@@ -0,0 +1,382 @@
+#include "mygit.h"
+#include "commit_graph.h"
+#include "object_format.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "utils.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <atomic>
+
+const CommitGraph* MyGit::commitGraph() {
+    if (!graph_loaded) {
+        graph_loaded = true;
+        std::unique_ptr<CommitGraph> graph(new CommitGraph(objects_path + "/info/commit-graph", objectFormat()));
+        if (graph->isOpen()) {
+            commit_graph = std::move(graph);
+        }
+    }
+    return commit_graph.get();
+}
+
+bool MyGit::writeCommitGraph(size_t& written) {
+    if (!isRepository()) {
+        fail("Not a MyGit repository");
+        return false;
+    }
+
+    std::vector<std::pair<std::string, std::string>> roots;
+    if (!reachabilityRoots(roots)) {
+        return false;
+    }
+    std::vector<std::string> tips;
+    for (const auto& root : roots) {
+        if (root.first.compare(0, 6, "index:") != 0) tips.push_back(root.second);
+    }
+
+    loadPacks();
+    std::vector<std::string> order = commitOrder(tips);
+    std::vector<CommitGraph::Commit> commits(order.size());
+    ThreadPool pool;
+
+    // Links first, so each commit's diff can find its parent's tree
+    for (size_t i = 0; i < order.size(); i++) {
+        pool.submit([&, i]() {
+            std::string type, content;
+            commits[i].hash = order[i];
+            if (peekObject(order[i], type, &content)) {
+                commitLinks(content, commits[i].tree, commits[i].parents);
+            }
+        });
+    }
+    pool.wait();
+    std::unordered_map<std::string, const std::string*> trees;
+    for (const auto& commit : commits) {
+        trees[commit.hash] = &commit.tree;
+    }
+
+    // Paths that differ from the first parent, a directory whenever
+    // anything below it does. A tree that cannot be read, or too many
+    // changes, leave the commit with a filter that matches every path.
+    std::function<bool(const std::string&, const std::string&, const std::string&, std::vector<std::string>&)> diff =
+        [&](const std::string& old_tree, const std::string& new_tree, const std::string& prefix,
+            std::vector<std::string>& paths) {
+        std::vector<TreeEntry> old_entries, new_entries;
+        for (auto side : {std::make_pair(&old_tree, &old_entries), std::make_pair(&new_tree, &new_entries)}) {
+            if (side.first->empty()) continue;
+            std::string type, content;
+            if (!peekObject(*side.first, type, &content) || type != "tree") return false;
+            *side.second = parseTree(content);
+        }
+
+        std::unordered_map<std::string, const TreeEntry*> old_names;
+        for (const auto& entry : old_entries) {
+            old_names[entry.name] = &entry;
+        }
+        auto changed = [&](const TreeEntry* before, const TreeEntry* after) {
+            const TreeEntry* entry = after ? after : before;
+            std::string path = prefix + entry->name;
+            paths.push_back(path);
+            if (paths.size() > BloomFilter::MAX_PATHS) return false;
+
+            bool old_dir = before && before->type == "tree";
+            bool new_dir = after && after->type == "tree";
+            return !(old_dir || new_dir) ||
+                   diff(old_dir ? before->hash : "", new_dir ? after->hash : "", path + "/", paths);
+        };
+        for (const auto& entry : new_entries) {
+            auto found = old_names.find(entry.name);
+            const TreeEntry* before = found == old_names.end() ? nullptr : found->second;
+            if (before) old_names.erase(found);
+            if (before && before->hash == entry.hash && before->mode == entry.mode) continue;
+            if (!changed(before, &entry)) return false;
+        }
+        for (const auto& entry : old_names) {
+            if (!changed(entry.second, nullptr)) return false;
+        }
+        return true;
+    };
+
+    for (auto& commit : commits) {
+        pool.submit([&]() {
+            std::string parent_tree;
+            if (!commit.parents.empty()) {
+                auto found = trees.find(commit.parents[0]);
+                parent_tree = found == trees.end() ? "" : *found->second;
+            }
+            commit.too_many = commit.tree.empty() || !diff(parent_tree, commit.tree, "", commit.changed);
+            if (commit.too_many) commit.changed.clear();
+        });
+    }
+    pool.wait();
+
+    Utils::createDirectory(objects_path + "/info");
+    if (!CommitGraph::write(objects_path + "/info/commit-graph", objectFormat(), commits)) {
+        fail("Unable to write commit graph");
+        return false;
+    }
+    commit_graph.reset();
+    graph_loaded = false;
+    written = commits.size();
+    return true;
+}
+
+std::string MyGit::treeEntry(const std::string& tree_hash, std::string_view path) {
+    std::string hash = tree_hash, entry;
+    while (!path.empty() && !hash.empty()) {
+        size_t slash = path.find('/');
+        std::string_view name = path.substr(0, slash);
+        path = slash == std::string_view::npos ? std::string_view() : path.substr(slash + 1);
+
+        std::string next;
+        for (const auto& child : readTree(hash)) {
+            if (child.name == name && (path.empty() || child.type == "tree")) {
+                next = child.hash;
+                entry = child.mode + " " + child.hash;
+                break;
+            }
+        }
+        hash = next;
+    }
+    return hash.empty() ? "" : entry;
+}
+
+std::vector<CommitInfo> MyGit::log(const std::string& start, const std::string& path) {
+    std::vector<CommitInfo> commits;
+    std::string current_hash = start.empty() ? getCurrentCommit() : start;
+
+    // "./src/" and "src" name the same path; "." is the whole tree
+    std::string_view wanted = path;
+    while (wanted.compare(0, 2, "./") == 0) wanted.remove_prefix(2);
+    while (!wanted.empty() && wanted.back() == '/') wanted.remove_suffix(1);
+    if (wanted == ".") wanted = "";
+
+    if (wanted.empty()) {
+        // Reversed, parents-first order puts each merge before the commits
+        // only its later parents reach, and those before its first parent
+        if (current_hash.empty()) {
+            return commits;
+        }
+        loadPacks();
+        std::vector<std::string> order = commitOrder({current_hash});
+        for (auto hash = order.rbegin(); hash != order.rend(); ++hash) {
+            CommitInfo info;
+            if (readCommit(*hash, info)) {
+                commits.push_back(std::move(info));
+            }
+        }
+        return commits;
+    }
+
+    // Git's history simplification: a commit whose entry at the path
+    // matches some parent's is TREESAME to it, is not shown, and only that
+    // parent is followed; any other commit is shown and all its parents
+    // walked. Filters record the paths changed against the first parent,
+    // so a commit in the graph whose filter rules the path out follows its
+    // first parent without reading it or its trees.
+    const CommitGraph* graph = commitGraph();
+    BloomFilter::Key key(wanted);
+    struct Node {
+        bool read = false;
+        std::string tree;
+        std::vector<std::string> parents;
+        bool filtered = false;
+        bool entry_read = false;
+        std::string entry;
+    };
+    std::unordered_map<std::string, Node> nodes;
+    auto node = [&](const std::string& hash) -> Node& {
+        auto found = nodes.find(hash);
+        if (found != nodes.end()) return found->second;
+
+        Node& links = nodes[hash];
+        uint32_t pos;
+        bool complete = graph && graph->lookup(hash, pos);
+        for (uint32_t i = 0; complete && i < graph->parentCount(pos); i++) {
+            uint32_t parent = graph->parent(pos, i);
+            complete = parent != CommitGraph::NONE;
+            if (complete) links.parents.push_back(graph->hash(parent));
+        }
+        if (complete) {
+            links.read = true;
+            links.tree = graph->tree(pos);
+            links.filtered = !graph->mayHaveChanged(pos, key);
+            return links;
+        }
+
+        CommitInfo info;
+        links.read = readCommit(hash, info);
+        links.tree = info.tree_hash;
+        links.parents = links.read ? info.parents : std::vector<std::string>();
+        return links;
+    };
+    auto entry = [&](Node& links) -> const std::string& {
+        if (!links.entry_read) {
+            links.entry = treeEntry(links.tree, wanted);
+            links.entry_read = true;
+        }
+        return links.entry;
+    };
+
+    // Depth-first as in commitOrder, so the commits come out parents
+    // first; reversed, that is the order of the unlimited log
+    std::vector<std::pair<std::string, bool>> order;
+    std::unordered_set<std::string> seen;
+    std::vector<std::pair<std::string, int>> stack = {{current_hash, -1}};
+    while (!stack.empty()) {
+        auto top = stack.back();
+        stack.pop_back();
+        if (top.second >= 0) {
+            order.push_back({top.first, top.second == 1});
+            continue;
+        }
+        if (!seen.insert(top.first).second) continue;
+
+        Node& links = node(top.first);
+        if (!links.read) continue;
+        std::vector<std::string> follow;
+        if (links.filtered) {
+            Trace::count(Trace::FILTER_SKIPS);
+            if (!links.parents.empty()) follow.push_back(links.parents[0]);
+        } else {
+            for (const auto& parent : links.parents) {
+                Node& parent_links = node(parent);
+                if (entry(links) == (parent_links.read ? entry(parent_links) : "")) {
+                    follow = {parent};
+                    break;
+                }
+            }
+        }
+        bool shown = !links.filtered && follow.empty() && (!links.parents.empty() || !entry(links).empty());
+        if (shown) follow = links.parents;
+
+        stack.push_back({top.first, shown ? 1 : 0});
+        for (auto parent = follow.rbegin(); parent != follow.rend(); ++parent) {
+            stack.push_back({*parent, -1});
+        }
+    }
+
+    for (auto commit = order.rbegin(); commit != order.rend(); ++commit) {
+        CommitInfo info;
+        if (commit->second && readCommit(commit->first, info)) {
+            commits.push_back(std::move(info));
+        }
+    }
+    return commits;
+}
+
+std::vector<std::string> MyGit::mergeBases(const std::string& one, const std::string& two) {
+    // Parents and generations come from the commit graph where it has
+    // them; commits made since it was written are read and numbered here
+    const CommitGraph* graph = commitGraph();
+    std::unordered_map<std::string, std::vector<std::string>> parents_of;
+    auto parents = [&](const std::string& hash) -> const std::vector<std::string>& {
+        auto found = parents_of.find(hash);
+        if (found != parents_of.end()) return found->second;
+
+        std::vector<std::string>& list = parents_of[hash];
+        uint32_t pos;
+        bool complete = graph && graph->lookup(hash, pos);
+        for (uint32_t i = 0; complete && i < graph->parentCount(pos); i++) {
+            uint32_t parent = graph->parent(pos, i);
+            complete = parent != CommitGraph::NONE;
+            if (complete) list.push_back(graph->hash(parent));
+        }
+        if (!complete) {
+            CommitInfo info;
+            list = readCommit(hash, info) ? info.parents : std::vector<std::string>();
+        }
+        return list;
+    };
+
+    std::unordered_map<std::string, uint32_t> generations;
+    auto generation = [&](const std::string& start) {
+        std::vector<std::string> stack = {start};
+        while (!stack.empty()) {
+            std::string hash = stack.back();
+            uint32_t pos;
+            if (generations.count(hash)) {
+                stack.pop_back();
+                continue;
+            }
+            if (graph && graph->lookup(hash, pos)) {
+                generations[hash] = graph->generation(pos);
+                stack.pop_back();
+                continue;
+            }
+
+            // Numbered once every parent is
+            uint32_t number = 1;
+            bool ready = true;
+            for (const auto& parent : parents(hash)) {
+                auto found = generations.find(parent);
+                if (found == generations.end()) {
+                    stack.push_back(parent);
+                    ready = false;
+                } else {
+                    number = std::max(number, found->second + 1);
+                }
+            }
+            if (ready) {
+                generations[hash] = number;
+                stack.pop_back();
+            }
+        }
+        return generations[start];
+    };
+
+    // Git's paint-down-to-common. Commits are taken highest generation
+    // first, so all of a commit's children are done before it is; one
+    // reached from both sides is a base, and everything below it is stale.
+    // The walk ends when only stale commits are left.
+    enum { ONE = 1, TWO = 2, STALE = 4, RESULT = 8, QUEUED = 16 };
+    std::unordered_map<std::string, int> flags;
+    std::set<std::pair<uint32_t, std::string>> queue;
+    size_t active = 0;      // queued and not stale
+    auto paint = [&](const std::string& hash, int add) {
+        int& flag = flags[hash];
+        int old = flag;
+        flag |= add;
+        if (!(old & QUEUED)) {
+            queue.insert({generation(hash), hash});
+            flag |= QUEUED;
+            if (!(flag & STALE)) active++;
+        } else if (!(old & STALE) && (flag & STALE)) {
+            active--;
+        }
+    };
+
+    if (one == two) {
+        return {one};
+    }
+    paint(one, ONE);
+    paint(two, TWO);
+    std::vector<std::string> bases;
+    while (active > 0) {
+        auto top = std::prev(queue.end());
+        std::string hash = top->second;
+        queue.erase(top);
+        int& flag = flags[hash];
+        flag &= ~QUEUED;
+        if (!(flag & STALE)) active--;
+
+        int sides = flag & (ONE | TWO | STALE);
+        if (sides == (ONE | TWO)) {
+            if (!(flag & RESULT)) {
+                flag |= RESULT;
+                bases.push_back(hash);
+            }
+            sides |= STALE;
+        }
+        for (const auto& parent : parents(hash)) {
+            if ((flags[parent] & sides) != sides) paint(parent, sides);
+        }
+    }
+
+    bases.erase(std::remove_if(bases.begin(), bases.end(),
+                               [&](const std::string& hash) { return flags[hash] & STALE; }),
+                bases.end());
+    return bases;
+}
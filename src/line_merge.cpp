@@ -0,0 +1,178 @@
+#include "line_merge.h"
+#include <unordered_map>
+
+namespace {
+    // Myers' O((N+M)D) diff in linear space: find the middle snake of an
+    // optimal path, then solve the two halves on either side of it
+    class Differ {
+    public:
+        Differ(const std::vector<int>& a, const std::vector<int>& b)
+            : a(a), b(b), forward(2 * (a.size() + b.size()) + 4), backward(forward.size()), matched(a.size(), -1) {}
+
+        std::vector<int> run() {
+            compare(0, a.size(), 0, b.size());
+            return matched;
+        }
+
+    private:
+        const std::vector<int>& a;
+        const std::vector<int>& b;
+        std::vector<int> forward, backward;
+        std::vector<int> matched;
+
+        void compare(int a0, int a1, int b0, int b1) {
+            while (a0 < a1 && b0 < b1 && a[a0] == b[b0]) {
+                matched[a0++] = b0++;
+            }
+            while (a0 < a1 && b0 < b1 && a[a1 - 1] == b[b1 - 1]) {
+                matched[--a1] = --b1;
+            }
+            if (a0 == a1 || b0 == b1) return;
+
+            int x0, y0, x1, y1;
+            middleSnake(a0, a1, b0, b1, x0, y0, x1, y1);
+            compare(a0, x0, b0, y0);
+            for (int x = x0, y = y0; x < x1; x++, y++) {
+                matched[x] = y;
+            }
+            compare(x1, a1, y1, b1);
+        }
+
+        // Sets (x0, y0)-(x1, y1) to a diagonal run that some shortest edit
+        // script passes through; only called with at least two edits to make
+        void middleSnake(int a0, int a1, int b0, int b1, int& x0, int& y0, int& x1, int& y1) {
+            int n = a1 - a0, m = b1 - b0;
+            int delta = n - m;
+            bool odd = delta & 1;
+            int limit = (n + m + 1) / 2;
+            int offset = limit + 1;
+            forward[offset + 1] = 0;
+            backward[offset + 1] = 0;
+
+            for (int d = 0; d <= limit; d++) {
+                for (int k = -d; k <= d; k += 2) {
+                    int x = (k == -d || (k != d && forward[offset + k - 1] < forward[offset + k + 1]))
+                                ? forward[offset + k + 1] : forward[offset + k - 1] + 1;
+                    int y = x - k;
+                    int sx = x, sy = y;
+                    while (x < n && y < m && a[a0 + x] == b[b0 + y]) {
+                        x++;
+                        y++;
+                    }
+                    forward[offset + k] = x;
+                    if (odd && k >= delta - (d - 1) && k <= delta + (d - 1) &&
+                        x + backward[offset + delta - k] >= n) {
+                        x0 = a0 + sx, y0 = b0 + sy, x1 = a0 + x, y1 = b0 + y;
+                        return;
+                    }
+                }
+                // Backward paths run from the end; their diagonal k is the
+                // forward diagonal delta - k
+                for (int k = -d; k <= d; k += 2) {
+                    int x = (k == -d || (k != d && backward[offset + k - 1] < backward[offset + k + 1]))
+                                ? backward[offset + k + 1] : backward[offset + k - 1] + 1;
+                    int y = x - k;
+                    int sx = x, sy = y;
+                    while (x < n && y < m && a[a1 - 1 - x] == b[b1 - 1 - y]) {
+                        x++;
+                        y++;
+                    }
+                    backward[offset + k] = x;
+                    if (!odd && delta - k >= -d && delta - k <= d && x + forward[offset + delta - k] >= n) {
+                        x0 = a1 - x, y0 = b1 - y, x1 = a1 - sx, y1 = b1 - sy;
+                        return;
+                    }
+                }
+            }
+            x0 = x1 = a0, y0 = y1 = b0;
+        }
+    };
+
+    bool sameLines(const std::vector<std::string_view>& a, int a0, int a1,
+                   const std::vector<std::string_view>& b, int b0, int b1) {
+        if (a1 - a0 != b1 - b0) return false;
+        for (int i = 0; i < a1 - a0; i++) {
+            if (a[a0 + i] != b[b0 + i]) return false;
+        }
+        return true;
+    }
+
+    void append(std::string& out, const std::vector<std::string_view>& lines, int from, int to) {
+        for (int i = from; i < to; i++) {
+            out.append(lines[i].data(), lines[i].size());
+        }
+    }
+}
+
+namespace LineMerge {
+    std::vector<std::string_view> split(std::string_view text) {
+        std::vector<std::string_view> lines;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            end = end == std::string_view::npos ? text.size() : end + 1;
+            lines.push_back(text.substr(start, end - start));
+            start = end;
+        }
+        return lines;
+    }
+
+    std::vector<int> match(const std::vector<std::string_view>& a, const std::vector<std::string_view>& b) {
+        // Lines are compared as small integers
+        std::unordered_map<std::string_view, int> ids;
+        std::vector<int> a_ids, b_ids;
+        for (auto line : a) {
+            a_ids.push_back(ids.emplace(line, ids.size()).first->second);
+        }
+        for (auto line : b) {
+            b_ids.push_back(ids.emplace(line, ids.size()).first->second);
+        }
+        return Differ(a_ids, b_ids).run();
+    }
+
+    size_t merge(std::string_view base, std::string_view ours, std::string_view theirs,
+                 const std::string& ours_label, const std::string& theirs_label, std::string& merged) {
+        auto base_lines = split(base), our_lines = split(ours), their_lines = split(theirs);
+        std::vector<int> to_ours = match(base_lines, our_lines);
+        std::vector<int> to_theirs = match(base_lines, their_lines);
+        int nb = base_lines.size(), no = our_lines.size(), nt = their_lines.size();
+
+        merged.clear();
+        size_t conflicts = 0;
+        int i = 0, j = 0, k = 0;
+        while (true) {
+            // Lines kept by both sides where neither inserted anything
+            while (i < nb && to_ours[i] == j && to_theirs[i] == k) {
+                merged.append(base_lines[i].data(), base_lines[i].size());
+                i++, j++, k++;
+            }
+            if (i == nb && j == no && k == nt) break;
+
+            // Up to the next base line both sides kept
+            int next = i;
+            while (next < nb && (to_ours[next] < 0 || to_theirs[next] < 0)) next++;
+            int j_end = next < nb ? to_ours[next] : no;
+            int k_end = next < nb ? to_theirs[next] : nt;
+
+            if (sameLines(base_lines, i, next, our_lines, j, j_end)) {
+                append(merged, their_lines, k, k_end);
+            } else if (sameLines(base_lines, i, next, their_lines, k, k_end) ||
+                       sameLines(our_lines, j, j_end, their_lines, k, k_end)) {
+                append(merged, our_lines, j, j_end);
+            } else {
+                conflicts++;
+                auto marker = [&](const std::string& text) {
+                    if (!merged.empty() && merged.back() != '\n') merged += '\n';
+                    merged += text;
+                };
+                marker("<<<<<<< " + ours_label + "\n");
+                append(merged, our_lines, j, j_end);
+                marker("=======\n");
+                append(merged, their_lines, k, k_end);
+                marker(">>>>>>> " + theirs_label + "\n");
+            }
+            i = next, j = j_end, k = k_end;
+        }
+        return conflicts;
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef LINE_MERGE_H
+#define LINE_MERGE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Line-level three-way merge (diff3). Each side is diffed against the base
+// with Myers' linear-space algorithm; stretches where only one side changed
+// take that side, identical changes are taken once, and anything else is
+// left between Git-style conflict markers.
+namespace LineMerge {
+    // For each line of a, the index of the line of b it is kept as, or -1
+    // for a deleted line; the kept pairs form a longest common subsequence
+    std::vector<int> match(const std::vector<std::string_view>& a, const std::vector<std::string_view>& b);
+
+    // Lines with their newlines; a last line without one is kept as is
+    std::vector<std::string_view> split(std::string_view text);
+
+    // Returns the number of conflicting stretches written into merged
+    size_t merge(std::string_view base, std::string_view ours, std::string_view theirs,
+                 const std::string& ours_label, const std::string& theirs_label, std::string& merged);
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "lockfile.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+LockFile::LockFile(const std::string& path) : path(path), lock_path(path + ".lock"), fd(-1) {}
+
+LockFile::~LockFile() {
+    rollback();
+}
+
+bool LockFile::acquire(int timeout_ms) {
+    if (fd >= 0) return true;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    int delay_ms = 1;
+
+    while (true) {
+        fd = ::open(lock_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd >= 0) return true;
+        if (errno != EEXIST || std::chrono::steady_clock::now() >= deadline) return false;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+        delay_ms = std::min(delay_ms * 2, 100);
+    }
+}
+
+bool LockFile::commit(std::string_view content) {
+    if (fd < 0) return false;
+
+    const char* data = content.data();
+    size_t len = content.size();
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            rollback();
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+
+    int lock_fd = fd;
+    fd = -1;
+    if (::close(lock_fd) != 0 || rename(lock_path.c_str(), path.c_str()) != 0) {
+        unlink(lock_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void LockFile::rollback() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+        unlink(lock_path.c_str());
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef LOCKFILE_H
+#define LOCKFILE_H
+
+#include <string>
+#include <string_view>
+
+// Exclusive update of a file through "<path>.lock". The lock is taken by
+// creating that file with O_EXCL, the new content is written into it, and
+// commit() renames it over the target so readers only ever see the old or
+// the new file. A lock that is never committed is removed on destruction.
+class LockFile {
+public:
+    explicit LockFile(const std::string& path);
+    ~LockFile();
+
+    LockFile(const LockFile&) = delete;
+    LockFile& operator=(const LockFile&) = delete;
+
+    // Retries with backoff while another process holds the lock
+    bool acquire(int timeout_ms = 5000);
+    bool commit(std::string_view content);
+    void rollback();
+
+    bool held() const { return fd >= 0; }
+    const std::string& lockPath() const { return lock_path; }
+
+private:
+    std::string path;
+    std::string lock_path;
+    int fd;
+};
+
+#endif
@@ -1,64 +1,108 @@
 #include "mygit.h"
+#include "cli.h"
 #include "ui_utils.h"
+#include "trace.h"
+#include "sha256.h"
 #include <iostream>
 #include <vector>
 #include <string>
 #include <iomanip>
+#include <unistd.h>
 
 void printUsage() {
     UI::printHeader();
     
-    std::cout << BOLD << "USAGE:" << RESET << std::endl;
-    std::cout << "  mygit <command> [options]" << std::endl;
-    std::cout << std::endl;
-    
-    std::cout << BOLD << "COMMANDS:" << RESET << std::endl;
-    
-    std::cout << BRIGHT_GREEN << "  Repository Management:" << RESET << std::endl;
-    std::cout << "    " << CYAN << "init" << RESET << "                     Initialize a new repository" << std::endl;
-    std::cout << "    " << CYAN << "status" << RESET << "                   Show working tree status" << std::endl;
-    
-    std::cout << std::endl;
-    std::cout << BRIGHT_GREEN << "  File Operations:" << RESET << std::endl;
-    std::cout << "    " << CYAN << "add" << RESET << " <files...>           Add files to staging area" << std::endl;
-    std::cout << "    " << CYAN << "commit" << RESET << " [-m <message>]    Create a commit" << std::endl;
-    std::cout << "    " << CYAN << "checkout" << RESET << " <hash>          Checkout a commit" << std::endl;
-    
-    std::cout << std::endl;
-    std::cout << BRIGHT_GREEN << "  History & Information:" << RESET << std::endl;
-    std::cout << "    " << CYAN << "log" << RESET << "                      Show commit history" << std::endl;
-    std::cout << "    " << CYAN << "show" << RESET << " <hash>              Show commit details" << std::endl;
-    std::cout << "    " << CYAN << "diff" << RESET << "                     Show changes" << std::endl;
-    
-    std::cout << std::endl;
-    std::cout << BRIGHT_GREEN << "  Low-level Commands:" << RESET << std::endl;
-    std::cout << "    " << CYAN << "hash-object" << RESET << " [-w] <file>  Compute object hash" << std::endl;
-    std::cout << "    " << CYAN << "cat-file" << RESET << " <flag> <hash>   Display object content" << std::endl;
-    std::cout << "    " << CYAN << "write-tree" << RESET << "               Write tree object" << std::endl;
-    std::cout << "    " << CYAN << "ls-tree" << RESET << " [--name-only] <hash>  List tree contents" << std::endl;
-    
-    std::cout << std::endl;
-    std::cout << BOLD << "OPTIONS:" << RESET << std::endl;
-    std::cout << "    " << DIM << "-h, --help               Show this help message" << RESET << std::endl;
-    std::cout << "    " << DIM << "-v, --version            Show version information" << RESET << std::endl;
-    
-    std::cout << std::endl;
-    std::cout << BOLD << "EXAMPLES:" << RESET << std::endl;
-    std::cout << DIM << "    mygit init" << RESET << std::endl;
-    std::cout << DIM << "    mygit add file.txt" << RESET << std::endl;
-    std::cout << DIM << "    mygit commit -m \"Initial commit\"" << RESET << std::endl;
-    std::cout << DIM << "    mygit log" << RESET << std::endl;
-    
-    std::cout << std::endl;
+    std::cout << BOLD << "USAGE:" << RESET << "\n";
+    std::cout << "  mygit <command> [options]\n";
+    std::cout << "\n";
+    
+    std::cout << BOLD << "COMMANDS:" << RESET << "\n";
+    
+    std::cout << BRIGHT_GREEN << "  Repository Management:" << RESET << "\n";
+    std::cout << "    " << CYAN << "init" << RESET << " [--object-format=sha1|sha256]\n";
+    std::cout << "                             Initialize a new repository\n";
+    std::cout << "    " << CYAN << "status" << RESET << " [--porcelain] [-z] Show working tree status\n";
+    std::cout << "    " << CYAN << "config" << RESET << " <key> [<value>]   Get or set a repository option\n";
+    
+    std::cout << "\n";
+    std::cout << BRIGHT_GREEN << "  File Operations:" << RESET << "\n";
+    std::cout << "    " << CYAN << "add" << RESET << " <files...>           Add files to staging area\n";
+    std::cout << "    " << CYAN << "commit" << RESET << " [-m <message>]    Create a commit\n";
+    std::cout << "    " << CYAN << "checkout" << RESET << " <hash>          Checkout a commit (detaches HEAD)\n";
+    
+    std::cout << "\n";
+    std::cout << BRIGHT_GREEN << "  Branches:" << RESET << "\n";
+    std::cout << "    " << CYAN << "branch" << RESET << "                   List branches\n";
+    std::cout << "    " << CYAN << "branch" << RESET << " <name> [<hash>]   Create a branch\n";
+    std::cout << "    " << CYAN << "branch" << RESET << " -d <name>         Delete a branch\n";
+    std::cout << "    " << CYAN << "switch" << RESET << " [-c] <name>       Switch to (or create) a branch\n";
+    std::cout << "    " << CYAN << "merge" << RESET << " <branch|hash>      Merge another line of history into HEAD\n";
+    std::cout << "    " << CYAN << "merge" << RESET << " --abort            Give up a merge that stopped on conflicts\n";
+    std::cout << "    " << CYAN << "sparse-checkout" << RESET << " set <dir>...  Check out only these directories\n";
+    std::cout << "    " << CYAN << "sparse-checkout" << RESET << " list|disable  Show the cone, or check out everything again\n";
+    std::cout << "    " << CYAN << "pack-refs" << RESET << "                Move loose refs into packed-refs\n";
+    std::cout << "    " << CYAN << "gc" << RESET << " [--prune[=now|<seconds>]]  Pack refs and remove unreachable objects\n";
+    std::cout << "    " << CYAN << "fsck" << RESET << "                     Verify object integrity and connectivity\n";
+    std::cout << "    " << CYAN << "repack" << RESET << "                   Pack reachable objects with bitmaps\n";
+    std::cout << "    " << CYAN << "commit-graph" << RESET << " write       Record generations and changed-path filters\n";
+    std::cout << "    " << CYAN << "migrate" << RESET << "                  Rewrite trees in Git's encoding (format 1)\n";
+    std::cout << "    " << CYAN << "count-objects" << RESET << " <hash> [^<hash>]  Count objects reachable from a commit\n";
+    
+    std::cout << "\n";
+    std::cout << BRIGHT_GREEN << "  History & Information:" << RESET << "\n";
+    std::cout << "    " << CYAN << "log" << RESET << " [--porcelain] [-z]    Show commit history\n";
+    std::cout << "    " << CYAN << "log" << RESET << " -- <path>            Show commits that changed a path\n";
+    std::cout << "    " << CYAN << "show" << RESET << " <hash>              Show commit details\n";
+    std::cout << "    " << CYAN << "diff" << RESET << "                     Show changes\n";
+    std::cout << "    " << CYAN << "merge-base" << RESET << " <hash> <hash>  Show the best common ancestors\n";
+    std::cout << "    " << CYAN << "grep" << RESET << " [-i] [-n] [-l] [--cached] <pattern> [<hash>]  Search tracked files\n";
+    
+    std::cout << "\n";
+    std::cout << BRIGHT_GREEN << "  Low-level Commands:" << RESET << "\n";
+    std::cout << "    " << CYAN << "hash-object" << RESET << " [-w] <file>  Compute object hash\n";
+    std::cout << "    " << CYAN << "cat-file" << RESET << " <flag> <hash>   Display object content\n";
+    std::cout << "    " << CYAN << "cat-file" << RESET << " --batch[-check] Read hashes from stdin, print objects\n";
+    std::cout << "    " << CYAN << "archive" << RESET << " [--format=tar|tar.gz] [--prefix=<dir>/] <hash>  Write a tarball to stdout\n";
+    std::cout << "    " << CYAN << "write-tree" << RESET << "               Write tree object\n";
+    std::cout << "    " << CYAN << "fast-import" << RESET << " [--export-marks=<file>]  Import a stream from stdin into a pack\n";
+    std::cout << "    " << CYAN << "ls-tree" << RESET << " [--name-only] [--porcelain] [-z] <hash>  List tree contents\n";
+    
+    std::cout << "\n";
+    std::cout << BOLD << "OPTIONS:" << RESET << "\n";
+    std::cout << "    " << DIM << "-h, --help               Show this help message" << RESET << "\n";
+    std::cout << "    " << DIM << "-v, --version            Show version information" << RESET << "\n";
+    std::cout << "    " << DIM << "--trace[=json|<file>]    Report per-phase timings and counters" << RESET << "\n";
+    
+    std::cout << "\n";
+    std::cout << BOLD << "EXAMPLES:" << RESET << "\n";
+    std::cout << DIM << "    mygit init" << RESET << "\n";
+    std::cout << DIM << "    mygit add file.txt" << RESET << "\n";
+    std::cout << DIM << "    mygit commit -m \"Initial commit\"" << RESET << "\n";
+    std::cout << DIM << "    mygit log" << RESET << "\n";
+    
+    std::cout << "\n";
     UI::printSeparator();
-    std::cout << DIM << "For more information, visit: https://github.com/yourusername/mygit" << RESET << std::endl;
+    std::cout << DIM << "For more information, visit: https://github.com/yourusername/mygit" << RESET << "\n";
+}
+
+bool parseFormatOption(const std::string& arg, CLI::OutputFormat& format) {
+    if (arg == "--porcelain") {
+        format.porcelain = true;
+    } else if (arg == "-z") {
+        format.porcelain = true;
+        format.nul_terminated = true;
+    } else {
+        return false;
+    }
+    return true;
 }
 
 void printVersion() {
     UI::printHeader();
-    std::cout << "MyGit version 1.0.0" << std::endl;
-    std::cout << DIM << "Built on: " << __DATE__ << " " << __TIME__ << RESET << std::endl;
-    std::cout << DIM << "Compatible with Git object format" << RESET << std::endl;
+    std::cout << "MyGit version 1.0.0\n";
+    std::cout << DIM << "Built on: " << __DATE__ << " " << __TIME__ << RESET << "\n";
+    std::cout << DIM << "Objects use Git's encoding in repository format 1 (run 'mygit migrate' on older repositories)" << RESET << "\n";
+    std::cout << DIM << "Object formats: sha1, sha256 (" << SHA256::kernel() << ")" << RESET << "\n";
 }
 
 int main(int argc, char* argv[]) {
@@ -67,9 +111,34 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    // Global options come before the command
+    std::string trace_spec;
+    while (argc >= 2 && std::string(argv[1]).rfind("--trace", 0) == 0) {
+        std::string option = argv[1];
+        if (option != "--trace" && option.compare(0, 8, "--trace=") != 0) {
+            UI::printError("Unknown option: " + option);
+            return 1;
+        }
+        trace_spec = option == "--trace" ? "1" : option.substr(8);
+        argv++;
+        argc--;
+    }
+    
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+    
+    UI::initOutput();
+    
     MyGit git;
+    CLI::UIReporter reporter;
+    git.setReporter(reporter);
     std::string command = argv[1];
     
+    Trace::init(trace_spec, command);
+    Trace::Scope command_scope(Trace::COMMAND);
+    
     // Handle help and version flags
     if (command == "-h" || command == "--help" || command == "help") {
         printUsage();
@@ -82,15 +151,49 @@ int main(int argc, char* argv[]) {
     }
     
     if (command == "init") {
-        bool result = git.init();
+        std::string object_format = "sha1";
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.compare(0, 16, "--object-format=") == 0) {
+                object_format = arg.substr(16);
+            } else {
+                UI::printError("Usage: mygit init [--object-format=sha1|sha256]");
+                return 1;
+            }
+        }
+        bool result = git.init(object_format);
         if (result) {
             UI::printSuccess("Initialized empty MyGit repository in .mygit/");
-            std::cout << DIM << "Ready to track your changes!" << RESET << std::endl;
+            std::cout << DIM << "Ready to track your changes!" << RESET << "\n";
         }
         return result ? 0 : 1;
     }
     else if (command == "status") {
-        return git.status() ? 0 : 1;
+        CLI::OutputFormat format;
+        for (int i = 2; i < argc; i++) {
+            if (!parseFormatOption(argv[i], format)) {
+                UI::printError("Usage: mygit status [--porcelain] [-z]");
+                return 1;
+            }
+        }
+        return CLI::status(git, format);
+    }
+    else if (command == "config") {
+        if (argc != 3 && argc != 4) {
+            UI::printError("Usage: mygit config <key> [<value>]");
+            return 1;
+        }
+        
+        if (argc == 4) {
+            return git.setConfig(argv[2], argv[3]) ? 0 : 1;
+        }
+        
+        std::string value = git.getConfig(argv[2]);
+        if (value.empty()) {
+            return 1;
+        }
+        std::cout << value << "\n";
+        return 0;
     }
     else if (command == "hash-object") {
         if (argc < 3) {
@@ -112,16 +215,24 @@ int main(int argc, char* argv[]) {
         if (hash.empty()) {
             return 1;
         }
-        std::cout << BRIGHT_YELLOW << hash << RESET << std::endl;
+        std::cout << BRIGHT_YELLOW << hash << RESET << "\n";
         return 0;
     }
     else if (command == "cat-file") {
+        if (argc == 3 && (std::string(argv[2]) == "--batch" || std::string(argv[2]) == "--batch-check")) {
+            return git.catFileBatch(std::string(argv[2]) == "--batch", STDIN_FILENO, STDOUT_FILENO) ? 0 : 1;
+        }
+        
         if (argc != 4) {
             UI::printError("Usage: mygit cat-file <flag> <hash>");
             return 1;
         }
         
-        return git.catFile(argv[2], argv[3]) ? 0 : 1;
+        std::string hash;
+        if (!git.resolveHash(argv[3], hash)) {
+            return 1;
+        }
+        return git.catFile(argv[2], hash, std::cout) ? 0 : 1;
     }
     else if (command == "write-tree") {
         UI::printProgress("Writing tree object...");
@@ -129,26 +240,189 @@ int main(int argc, char* argv[]) {
         if (tree_hash.empty()) {
             return 1;
         }
-        std::cout << BRIGHT_YELLOW << tree_hash << RESET << std::endl;
+        std::cout << BRIGHT_YELLOW << tree_hash << RESET << "\n";
         return 0;
     }
     else if (command == "ls-tree") {
-        if (argc < 3) {
-            UI::printError("Usage: mygit ls-tree [--name-only] <hash>");
-            return 1;
-        }
-        
         bool name_only = false;
+        CLI::OutputFormat format;
         std::string tree_hash;
         
-        if (argc == 4 && std::string(argv[2]) == "--name-only") {
-            name_only = true;
-            tree_hash = argv[3];
-        } else {
-            tree_hash = argv[2];
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--name-only") {
+                name_only = true;
+            } else if (!parseFormatOption(arg, format)) {
+                tree_hash = arg;
+            }
+        }
+        
+        if (tree_hash.empty()) {
+            UI::printError("Usage: mygit ls-tree [--name-only] [--porcelain] [-z] <hash>");
+            return 1;
+        }
+        
+        if (!git.resolveHash(tree_hash, tree_hash)) {
+            return 1;
         }
         
-        return git.lsTree(tree_hash, name_only) ? 0 : 1;
+        return CLI::lsTree(git, tree_hash, name_only, format);
+    }
+    else if (command == "fast-import") {
+        std::string marks_path;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--export-marks=", 0) == 0) {
+                marks_path = arg.substr(15);
+            } else {
+                UI::printError("Usage: mygit fast-import [--export-marks=<file>]");
+                return 1;
+            }
+        }
+        return git.fastImport(STDIN_FILENO, marks_path) ? 0 : 1;
+    }
+    else if (command == "branch") {
+        if (argc == 2) {
+            return CLI::branch(git);
+        }
+        if (argc == 4 && std::string(argv[2]) == "-d") {
+            return git.deleteBranch(argv[3]) ? 0 : 1;
+        }
+        if (argc == 3 || argc == 4) {
+            std::string start;
+            if (argc == 4 && !git.resolveHash(argv[3], start)) {
+                return 1;
+            }
+            return git.createBranch(argv[2], start) ? 0 : 1;
+        }
+        UI::printError("Usage: mygit branch [-d] [<name> [<hash>]]");
+        return 1;
+    }
+    else if (command == "switch") {
+        bool create = argc == 4 && std::string(argv[2]) == "-c";
+        if (argc != 3 && !create) {
+            UI::printError("Usage: mygit switch [-c] <branch>");
+            return 1;
+        }
+        return CLI::switchBranch(git, argv[argc - 1], create);
+    }
+    else if (command == "merge") {
+        if (argc != 3) {
+            UI::printError("Usage: mygit merge (<branch> | <hash> | --abort)");
+            return 1;
+        }
+        if (std::string(argv[2]) == "--abort") {
+            return git.abortMerge() ? 0 : 1;
+        }
+        return CLI::merge(git, argv[2]);
+    }
+    else if (command == "merge-base") {
+        std::string one, two;
+        if (argc != 4) {
+            UI::printError("Usage: mygit merge-base <hash> <hash>");
+            return 1;
+        }
+        if (!git.resolveHash(argv[2], one) || !git.resolveHash(argv[3], two)) {
+            return 1;
+        }
+        return CLI::mergeBase(git, one, two);
+    }
+    else if (command == "sparse-checkout") {
+        std::string action = argc >= 3 ? argv[2] : "";
+        if (action == "set" && argc >= 4) {
+            return git.setSparseCheckout(std::vector<std::string>(argv + 3, argv + argc)) ? 0 : 1;
+        } else if (action == "list" && argc == 3) {
+            for (const auto& directory : git.sparseDirectories()) {
+                std::cout << directory << "\n";
+            }
+            return 0;
+        } else if (action == "disable" && argc == 3) {
+            return git.disableSparseCheckout() ? 0 : 1;
+        }
+        UI::printError("Usage: mygit sparse-checkout (set <dir>... | list | disable)");
+        return 1;
+    }
+    else if (command == "pack-refs") {
+        return git.packRefs() ? 0 : 1;
+    }
+    else if (command == "gc") {
+        // Unreachable objects younger than two weeks are kept by default
+        bool prune = false;
+        long grace_seconds = 14 * 24 * 60 * 60;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--prune") {
+                prune = true;
+            } else if (arg.compare(0, 8, "--prune=") == 0) {
+                prune = true;
+                std::string value = arg.substr(8);
+                if (value == "now") {
+                    grace_seconds = 0;
+                } else if (!value.empty() && value.find_first_not_of("0123456789") == std::string::npos) {
+                    grace_seconds = std::stol(value);
+                } else {
+                    UI::printError("Invalid --prune value: " + value);
+                    return 1;
+                }
+            } else {
+                UI::printError("Usage: mygit gc [--prune[=now|<seconds>]]");
+                return 1;
+            }
+        }
+        return CLI::gc(git, prune, grace_seconds);
+    }
+    else if (command == "fsck") {
+        return CLI::fsck(git);
+    }
+    else if (command == "repack") {
+        return CLI::repack(git);
+    }
+    else if (command == "commit-graph") {
+        if (argc != 3 || std::string(argv[2]) != "write") {
+            UI::printError("Usage: mygit commit-graph write");
+            return 1;
+        }
+        size_t commits = 0;
+        if (!git.writeCommitGraph(commits)) {
+            return 1;
+        }
+        UI::printSuccess("Wrote commit graph with " + std::to_string(commits) + " commit(s)");
+        return 0;
+    }
+    else if (command == "migrate") {
+        size_t trees = 0, commits = 0;
+        if (!git.migrate(trees, commits)) {
+            return 1;
+        }
+        UI::printSuccess("Repository format is 1; rewrote " + std::to_string(trees) + " tree(s) and " +
+                         std::to_string(commits) + " commit(s)");
+        return 0;
+    }
+    else if (command == "count-objects") {
+        // count-objects <hash> [^<hash>]: reachable from the first commit
+        // and not from the excluded one
+        std::string include, exclude;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            std::string& target = arg[0] == '^' ? exclude : include;
+            if (!target.empty()) {
+                include.clear();
+                break;
+            }
+            if (!git.resolveHash(arg[0] == '^' ? arg.substr(1) : arg, target)) {
+                return 1;
+            }
+        }
+        if (include.empty()) {
+            UI::printError("Usage: mygit count-objects <hash> [^<hash>]");
+            return 1;
+        }
+        size_t count = 0;
+        if (!git.countObjects(include, exclude, count)) {
+            return 1;
+        }
+        std::cout << count << "\n";
+        return 0;
     }
     else if (command == "add") {
         if (argc < 3) {
@@ -177,22 +451,106 @@ int main(int argc, char* argv[]) {
         std::string commit_hash = git.commit(message);
         if (!commit_hash.empty()) {
             UI::printSuccess("Created commit " + commit_hash.substr(0, 7));
-            std::cout << BRIGHT_YELLOW << commit_hash << RESET << std::endl;
+            std::cout << BRIGHT_YELLOW << commit_hash << RESET << "\n";
         }
         return commit_hash.empty() ? 1 : 0;
     }
     else if (command == "log") {
-        return git.log() ? 0 : 1;
+        // log [options] [-- <path>]: only commits that changed the path
+        CLI::OutputFormat format;
+        std::string path;
+        for (int i = 2; i < argc; i++) {
+            if (std::string(argv[i]) == "--" && i + 2 == argc) {
+                path = argv[++i];
+            } else if (!parseFormatOption(argv[i], format)) {
+                UI::printError("Usage: mygit log [--porcelain] [-z] [-- <path>]");
+                return 1;
+            }
+        }
+        return CLI::log(git, format, path);
     }
     else if (command == "show") {
         if (argc != 3) {
             UI::printError("Usage: mygit show <commit_hash>");
             return 1;
         }
-        return git.show(argv[2]) ? 0 : 1;
+        
+        std::string commit_hash;
+        if (!git.resolveHash(argv[2], commit_hash)) {
+            return 1;
+        }
+        return CLI::show(git, commit_hash);
     }
     else if (command == "diff") {
-        return git.diff() ? 0 : 1;
+        return CLI::diff(git);
+    }
+    else if (command == "archive") {
+        // archive [--format=tar|tar.gz] [--prefix=<dir>/] <hash> > out.tar
+        bool gzip = false;
+        std::string prefix, hash;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--format=tar" || arg == "--format=tar.gz" || arg == "--format=tgz") {
+                gzip = arg != "--format=tar";
+            } else if (arg.compare(0, 9, "--prefix=") == 0) {
+                prefix = arg.substr(9);
+            } else if (hash.empty() && arg[0] != '-') {
+                hash = arg;
+            } else {
+                hash.clear();
+                break;
+            }
+        }
+        if (hash.empty()) {
+            UI::printError("Usage: mygit archive [--format=tar|tar.gz] [--prefix=<dir>/] <hash>");
+            return 1;
+        }
+        if (isatty(STDOUT_FILENO)) {
+            UI::printError("Refusing to write an archive to a terminal; redirect the output");
+            return 1;
+        }
+        
+        std::string resolved;
+        if (!git.resolveHash(hash, resolved)) {
+            return 1;
+        }
+        return git.archive(resolved, prefix, gzip, std::cout) ? 0 : 1;
+    }
+    else if (command == "grep") {
+        // Searches the worktree by default, the index with --cached, and
+        // a commit's tree when one is given; -e marks a pattern that
+        // starts with '-'
+        GrepOptions options;
+        bool line_numbers = false, names_only = false, usage = false;
+        std::vector<std::string> args;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "-i") {
+                options.ignore_case = true;
+            } else if (arg == "-n") {
+                line_numbers = true;
+            } else if (arg == "-l") {
+                names_only = true;
+            } else if (arg == "--cached") {
+                options.cached = true;
+            } else if (arg == "-e" && i + 1 < argc && args.empty()) {
+                args.push_back(argv[++i]);
+            } else if (arg[0] == '-' && args.empty()) {
+                usage = true;
+            } else {
+                args.push_back(arg);
+            }
+        }
+        if (usage || args.empty() || args.size() > 2 || (options.cached && args.size() == 2)) {
+            UI::printError("Usage: mygit grep [-i] [-n] [-l] [--cached] [-e] <pattern> [<hash>]");
+            return 1;
+        }
+        
+        options.pattern = args[0];
+        if (args.size() == 2 && !git.resolveHash(args[1], options.commit)) {
+            return 1;
+        }
+        return CLI::grep(git, options, args.size() == 2 ? args[1] : "", line_numbers, names_only);
     }
     else if (command == "checkout") {
         if (argc != 3) {
@@ -200,12 +558,17 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         
-        UI::printProgress("Checking out commit " + std::string(argv[2]).substr(0, 7) + "...");
-        return git.checkout(argv[2]) ? 0 : 1;
+        std::string commit_hash;
+        if (!git.resolveHash(argv[2], commit_hash)) {
+            return 1;
+        }
+        
+        UI::printProgress("Checking out commit " + commit_hash.substr(0, 7) + "...");
+        return CLI::checkout(git, commit_hash);
     }
     else {
         UI::printError("Unknown command: " + command);
-        std::cout << DIM << "Run 'mygit --help' for usage information" << RESET << std::endl;
+        std::cout << DIM << "Run 'mygit --help' for usage information" << RESET << "\n";
         return 1;
     }
 }
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "mygit.h"
+#include "grep.h"
+#include "line_merge.h"
+#include "sparse.h"
+#include "tree_format.h"
+#include "trace.h"
+#include "utils.h"
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    bool sameEntry(const TreeEntry* a, const TreeEntry* b) {
+        return a == b || (a && b && a->hash == b->hash && a->mode == b->mode);
+    }
+
+    bool isTree(const TreeEntry* entry) {
+        return entry && entry->type == "tree";
+    }
+}
+
+std::string MyGit::mergeTrees(const std::string& base, const std::string& ours, const std::string& theirs,
+                              const std::string& prefix, const std::string& theirs_label,
+                              std::vector<MergeConflict>& conflicts) {
+    // A subtree only one side touched is taken whole, without reading it
+    if (ours == theirs || base == theirs) {
+        return ours;
+    }
+    if (base == ours) {
+        return theirs;
+    }
+    Trace::count(Trace::TREES_MERGED);
+
+    // (base, ours, theirs) for every name on any side
+    std::array<std::vector<TreeEntry>, 3> lists;
+    const std::string* hashes[3] = {&base, &ours, &theirs};
+    std::map<std::string, std::array<const TreeEntry*, 3>> names;
+    for (int side = 0; side < 3; side++) {
+        if (!hashes[side]->empty()) lists[side] = readTree(*hashes[side]);
+        for (const auto& entry : lists[side]) {
+            names[entry.name][side] = &entry;
+        }
+    }
+
+    // Text of a blob, false for one that cannot be merged line by line
+    auto text = [&](const TreeEntry* entry, std::string& content) {
+        if (!entry || entry->type != "blob") return true;
+        std::string object = readObject(entry->hash);
+        size_t null_pos = object.find('\0');
+        if (null_pos == std::string::npos || object.compare(0, 5, "blob ") != 0) return false;
+        content = object.substr(null_pos + 1);
+        return !LineMatcher::isBinary(content);
+    };
+
+    std::vector<TreeEntry> merged;
+    for (const auto& name : names) {
+        const TreeEntry* base_entry = name.second[0];
+        const TreeEntry* our_entry = name.second[1];
+        const TreeEntry* their_entry = name.second[2];
+        std::string path = prefix + name.first;
+
+        if (sameEntry(our_entry, their_entry) || sameEntry(base_entry, their_entry)) {
+            if (our_entry) merged.push_back(*our_entry);
+            continue;
+        }
+        if (sameEntry(base_entry, our_entry)) {
+            if (their_entry) merged.push_back(*their_entry);
+            continue;
+        }
+
+        if (isTree(our_entry) && isTree(their_entry)) {
+            std::string hash = mergeTrees(isTree(base_entry) ? base_entry->hash : "", our_entry->hash,
+                                          their_entry->hash, path + "/", theirs_label, conflicts);
+            if (hash.empty()) return "";
+            merged.push_back({our_entry->mode, "tree", hash, name.first});
+        } else if (!our_entry || !their_entry) {
+            // The side that changed it is kept for the user to decide
+            conflicts.push_back({path, "modify/delete"});
+            merged.push_back(our_entry ? *our_entry : *their_entry);
+        } else if (isTree(our_entry) || isTree(their_entry)) {
+            conflicts.push_back({path, "file/directory"});
+            merged.push_back(*our_entry);
+        } else {
+            std::string base_text, our_text, their_text, result;
+            if (!text(base_entry, base_text) || !text(our_entry, our_text) || !text(their_entry, their_text)) {
+                conflicts.push_back({path, "binary"});
+                merged.push_back(*our_entry);
+                continue;
+            }
+            if (LineMerge::merge(base_text, our_text, their_text, "HEAD", theirs_label, result) > 0) {
+                conflicts.push_back({path, base_entry ? "content" : "add/add"});
+            }
+            // The mode merges like the content: a side that kept the base's
+            // takes the other's, and two different changes conflict
+            std::string mode = our_entry->mode;
+            if (base_entry && base_entry->mode == our_entry->mode) {
+                mode = their_entry->mode;
+            } else if (their_entry->mode != our_entry->mode && (!base_entry || base_entry->mode != their_entry->mode)) {
+                conflicts.push_back({path, "mode"});
+            }
+
+            std::string hash = storeObject(result, "blob");
+            if (hash.empty()) return "";
+            merged.push_back({mode, "blob", hash, name.first});
+        }
+    }
+
+    std::string hash = storeObject(TreeFormat::encode(merged, treeFormat()), "tree");
+    if (hash.empty()) {
+        fail("Unable to write merged tree for " + (prefix.empty() ? std::string(".") : prefix));
+    }
+    return hash;
+}
+
+bool MyGit::updateWorktree(const std::string& from_tree, const std::string& to_tree, const std::string& path) {
+    if (from_tree == to_tree) {
+        return true;
+    }
+
+    std::map<std::string, std::pair<const TreeEntry*, const TreeEntry*>> names;
+    std::vector<TreeEntry> before = from_tree.empty() ? std::vector<TreeEntry>() : readTree(from_tree);
+    std::vector<TreeEntry> after = to_tree.empty() ? std::vector<TreeEntry>() : readTree(to_tree);
+    for (const auto& entry : before) {
+        names[entry.name].first = &entry;
+    }
+    for (const auto& entry : after) {
+        names[entry.name].second = &entry;
+    }
+
+    for (const auto& name : names) {
+        const TreeEntry* old_entry = name.second.first;
+        const TreeEntry* new_entry = name.second.second;
+        if (sameEntry(old_entry, new_entry)) continue;
+
+        std::string full_path = path == "." ? name.first : path + "/" + name.first;
+        if (isTree(new_entry) && sparseCone().directory(full_path) == SparseCone::OUTSIDE) {
+            // Left out of a sparse checkout, and so never on disk
+            if (old_entry && !isTree(old_entry)) unlink(full_path.c_str());
+            continue;
+        }
+        if (isTree(old_entry) && isTree(new_entry)) {
+            if (!updateWorktree(old_entry->hash, new_entry->hash, full_path)) return false;
+            continue;
+        }
+        if (old_entry) {
+            std::error_code ec;
+            fs::remove_all(full_path, ec);
+        }
+        if (isTree(new_entry)) {
+            Utils::createDirectory(full_path);
+            if (!updateWorktree("", new_entry->hash, full_path)) return false;
+        } else if (new_entry && !checkoutBlob(new_entry->hash, full_path)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MyGit::merge(const std::string& name, MergeResult& result) {
+    result = MergeResult();
+    if (!isRepository()) {
+        fail("Not a MyGit repository");
+        return false;
+    }
+    if (!readMergeHead().empty()) {
+        fail("A merge is already in progress; commit the result or run 'mygit merge --abort'");
+        return false;
+    }
+
+    // A branch name, or a commit hash or prefix
+    std::string head = getCurrentCommit();
+    std::string theirs = resolveRef("refs/heads/" + name);
+    bool branch = !theirs.empty();
+    if (!branch && !resolveHash(name, theirs)) {
+        return false;
+    }
+    CommitInfo our_info, their_info;
+    if (head.empty() || !readCommit(head, our_info)) {
+        fail("Nothing to merge into: HEAD has no commits");
+        return false;
+    }
+    if (!readCommit(theirs, their_info)) {
+        fail("Not a commit: " + name);
+        return false;
+    }
+
+    // The worktree is only ever moved between trees, so it must hold
+    // exactly what HEAD does
+    std::string worktree = writeTree();
+    if (worktree.empty()) {
+        return false;
+    }
+    if (worktree != our_info.tree_hash) {
+        fail("The worktree has uncommitted changes; commit them before merging");
+        return false;
+    }
+
+    std::vector<std::string> bases = mergeBases(head, theirs);
+    if (std::find(bases.begin(), bases.end(), theirs) != bases.end()) {
+        result.up_to_date = true;
+        result.commit = head;
+        return true;
+    }
+    if (std::find(bases.begin(), bases.end(), head) != bases.end()) {
+        if (!updateHead(theirs, head)) {
+            return false;
+        }
+        result.fast_forward = true;
+        result.commit = theirs;
+        return updateWorktree(our_info.tree_hash, their_info.tree_hash, ".");
+    }
+
+    // With several bases (criss-cross history) the first stands in for
+    // all of them; unrelated histories merge as if both added everything
+    std::string base_tree;
+    CommitInfo base_info;
+    if (!bases.empty() && readCommit(bases[0], base_info)) {
+        base_tree = base_info.tree_hash;
+    }
+    std::string tree = mergeTrees(base_tree, our_info.tree_hash, their_info.tree_hash, "", name, result.conflicts);
+    if (tree.empty()) {
+        return false;
+    }
+
+    if (!result.conflicts.empty()) {
+        if (!updateWorktree(our_info.tree_hash, tree, ".")) {
+            return false;
+        }
+        // The merged tree stands in for HEAD's in the directories a sparse
+        // checkout leaves out
+        if (!Utils::writeFile(merge_head_path, theirs + "\n") || !Utils::writeFile(merge_tree_path, tree + "\n")) {
+            fail("Unable to write " + merge_head_path);
+            return false;
+        }
+        return true;
+    }
+
+    std::string message = branch ? "Merge branch '" + name + "'" : "Merge commit '" + theirs.substr(0, 7) + "'";
+    result.commit = storeCommit(tree, {head, theirs}, message);
+    if (result.commit.empty() || !updateHead(result.commit, head)) {
+        return false;
+    }
+    return updateWorktree(our_info.tree_hash, tree, ".");
+}
+
+bool MyGit::abortMerge() {
+    if (readMergeHead().empty()) {
+        fail("There is no merge to abort");
+        return false;
+    }
+    if (!restoreWorktree(getCurrentCommit())) {
+        return false;
+    }
+    unlink(merge_head_path.c_str());
+    unlink(merge_tree_path.c_str());
+    return true;
+}
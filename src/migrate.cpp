@@ -0,0 +1,107 @@
+#include "mygit.h"
+#include "tree_format.h"
+#include <map>
+#include <unordered_map>
+
+bool MyGit::migrate(size_t& trees, size_t& commits) {
+    trees = 0;
+    commits = 0;
+    if (!isRepository()) {
+        fail("Not a MyGit repository");
+        return false;
+    }
+    if (treeFormat() == TreeFormat::RAW) {
+        return true;
+    }
+    
+    // Every ref, a loose one overriding its packed entry, and HEAD only
+    // when it is detached
+    std::vector<std::pair<std::string, std::string>> roots;
+    if (!reachabilityRoots(roots)) {
+        return false;
+    }
+    std::map<std::string, std::string> refs;
+    for (const auto& root : roots) {
+        if (root.first.compare(0, 6, "index:") == 0) continue;
+        if (root.first == "HEAD" && !currentBranch().empty()) continue;
+        refs[root.first] = root.second;
+    }
+    
+    // Old hash to new for every tree and commit rewritten so far. Blobs and
+    // manifests keep their hashes, so the index needs no change.
+    std::unordered_map<std::string, std::string> rewritten;
+    std::function<std::string(const std::string&)> convertTree = [&](const std::string& hash) -> std::string {
+        auto done = rewritten.find(hash);
+        if (done != rewritten.end()) return done->second;
+        
+        std::string type, content;
+        if (!peekObject(hash, type, &content) || type != "tree") {
+            fail("Cannot read tree " + hash);
+            return "";
+        }
+        std::vector<TreeEntry> entries = parseTree(content);
+        for (auto& entry : entries) {
+            if (entry.type != "tree") continue;
+            entry.hash = convertTree(entry.hash);
+            if (entry.hash.empty()) return "";
+        }
+        
+        std::string converted = storeObject(TreeFormat::encode(entries, TreeFormat::RAW), "tree");
+        if (converted != hash) trees++;
+        rewritten[hash] = converted;
+        return converted;
+    };
+    
+    std::vector<std::string> tips;
+    for (const auto& ref : refs) {
+        tips.push_back(ref.second);
+    }
+    loadPacks();
+    for (const auto& commit : commitOrder(tips)) {
+        std::string type, content;
+        if (!peekObject(commit, type, &content)) {
+            fail("Cannot read commit " + commit);
+            return false;
+        }
+        
+        // Only the tree and parent header lines change
+        std::string header = content.substr(0, content.find("\n\n") + 1);
+        std::string converted;
+        size_t pos = 0;
+        while (pos < header.size()) {
+            size_t end = header.find('\n', pos);
+            std::string line = header.substr(pos, end - pos);
+            if (line.compare(0, 5, "tree ") == 0) {
+                std::string tree = convertTree(line.substr(5));
+                if (tree.empty()) return false;
+                line = "tree " + tree;
+            } else if (line.compare(0, 7, "parent ") == 0) {
+                auto parent = rewritten.find(line.substr(7));
+                if (parent != rewritten.end()) line = "parent " + parent->second;
+            }
+            converted += line + "\n";
+            pos = end + 1;
+        }
+        converted += content.substr(header.size());
+        
+        std::string hash = storeObject(converted, "commit");
+        if (hash.empty()) return false;
+        if (hash != commit) commits++;
+        rewritten[commit] = hash;
+    }
+    
+    // New trees are written in the new format from here on; the reader
+    // accepts both, so history is readable at every step
+    if (!setConfig("core.repositoryFormatVersion", std::to_string(TreeFormat::RAW))) {
+        return false;
+    }
+    for (const auto& ref : refs) {
+        auto moved = rewritten.find(ref.second);
+        if (moved == rewritten.end() || moved->second == ref.second) continue;
+        
+        bool ok = ref.first == "HEAD" ? writeHead(moved->second, ref.second)
+                                      : updateRef(ref.first, moved->second, ref.second);
+        if (!ok) return false;
+    }
+    return true;
+}
@@ -1,7 +1,19 @@
 #include "mygit.h"
-#include "sha1.h"
+#include "object_format.h"
 #include "utils.h"
-#include "ui_utils.h"
+#include "object_reader.h"
+#include "chunker.h"
+#include "trace.h"
+#include "output.h"
+#include "pack.h"
+#include "bitmap.h"
+#include "commit_graph.h"
+#include "lockfile.h"
+#include "refs.h"
+#include "thread_pool.h"
+#include "tree_format.h"
+#include "arena.h"
+#include "sparse.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -9,353 +21,1045 @@
 #include <algorithm>
 #include <zlib.h>
 #include <cstring>
-#include <iomanip>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
 
 namespace fs = std::filesystem;
 
+namespace {
+    Reporter silent_reporter;
+    
+    // Files hashed per write-tree task
+    const size_t WRITE_TREE_BATCH = 32;
+    
+    // Smallest object stored uncompressed when deflate gains too little
+    const size_t RAW_MIN_SIZE = 64 * 1024;
+}
+
 MyGit::MyGit() {
     repo_path = ".mygit";
     objects_path = repo_path + "/objects";
     refs_path = repo_path + "/refs";
     index_path = repo_path + "/index";
     head_path = repo_path + "/HEAD";
+    config_path = repo_path + "/config";
+    packs_path = objects_path + "/pack";
+    packed_refs_path = repo_path + "/packed-refs";
+    merge_head_path = repo_path + "/MERGE_HEAD";
+    merge_tree_path = repo_path + "/MERGE_TREE";
+    sparse_path = repo_path + "/info/sparse-checkout";
+    config_loaded = false;
+    packs_loaded = false;
+    bitmap_pack = nullptr;
+    graph_loaded = false;
+    tree_format = -1;
+    chunk_threshold = -1;
+    object_format = -1;
+    object_cache_bytes = 0;
+    reporter = &silent_reporter;
+}
+
+MyGit::~MyGit() = default;
+
+void MyGit::fail(const std::string& message) {
+    std::lock_guard<std::mutex> lock(report_mutex);
+    last_error = message;
+    reporter->error(message);
+}
+
+bool MyGit::isRepository() {
+    return Utils::directoryExists(repo_path);
 }
 
-bool MyGit::init() {
+bool MyGit::init(const std::string& object_format) {
+    ObjectFormat format;
+    if (!ObjectFormat::parse(object_format, format)) {
+        fail("Unknown object format: " + object_format);
+        return false;
+    }
+    
     try {
         if (Utils::directoryExists(repo_path)) {
-            UI::printWarning("Repository already initialized");
+            reporter->warning("Repository already initialized");
             return true;
         }
         
-        UI::printProgress("Initializing repository structure...");
+        reporter->progress("Initializing repository structure...");
         
         if (!Utils::createDirectory(repo_path)) {
-            UI::printError("Failed to create .mygit directory");
+            fail("Failed to create .mygit directory");
             return false;
         }
         
         if (!Utils::createDirectory(objects_path)) {
-            UI::printError("Failed to create objects directory");
+            fail("Failed to create objects directory");
             return false;
         }
         
-        if (!Utils::createDirectory(refs_path)) {
-            UI::printError("Failed to create refs directory");
+        if (!Utils::createDirectory(refs_path + "/heads")) {
+            fail("Failed to create refs directory");
             return false;
         }
         
-        Utils::writeFile(head_path, "");
+        // HEAD starts on an unborn master branch
+        Utils::writeFile(head_path, "ref: refs/heads/master\n");
         Utils::writeFile(index_path, "");
         
+        // New repositories write trees in Git's encoding
+        if (!setConfig("core.repositoryFormatVersion", std::to_string(TreeFormat::RAW))) {
+            return false;
+        }
+        if (format != ObjectFormat() && !setConfig("extensions.objectFormat", format.name())) {
+            return false;
+        }
+        
         // Create a .gitignore file
         std::string gitignore = "# MyGit ignore file\n*.o\n*.exe\nmygit\n.DS_Store\n";
         Utils::writeFile(".mygitignore", gitignore);
         
         return true;
     } catch (const std::exception& e) {
-        UI::printError(std::string("Error initializing repository: ") + e.what());
+        fail(std::string("Error initializing repository: ") + e.what());
         return false;
     }
 }
 
 std::string MyGit::storeObject(const std::string& content, const std::string& type) {
-    // Create the full object with header
+    // The header is hashed ahead of the content instead of being copied in
+    // front of it; the full object is only assembled if it must be written
     std::string header = type + " " + std::to_string(content.length());
-    std::string full_content = header + '\0' + content;
+    header += '\0';
+    
+    std::string hash;
+    {
+        Trace::Scope scope(Trace::HASH);
+        Hasher checksum(objectFormat());
+        checksum.update(header);
+        checksum.update(content);
+        hash = checksum.final();
+    }
+    
+    // Objects are immutable, so an existing one never needs rewriting
+    if (hasObject(hash)) {
+        Trace::count(Trace::OBJECTS_EXISTING);
+        return hash;
+    }
     
-    // Calculate hash of the full content (header + null + content)
-    std::string hash = sha1(full_content);
+    std::string object_path = getObjectPath(hash);
+    std::string full_content;
+    full_content.reserve(header.size() + content.size());
+    full_content += header;
+    full_content += content;
     
     // Compress the full content
     std::string compressed = Utils::compress(full_content);
     
-    // If compression fails, store uncompressed
-    std::string to_store = compressed.empty() ? full_content : compressed;
-    
-    std::string object_path = getObjectPath(hash);
+    // Stored uncompressed if compression fails, or if a large object
+    // barely shrinks; checkout then copies such blobs file to file
+    bool incompressible = full_content.size() >= RAW_MIN_SIZE &&
+                          compressed.size() > full_content.size() - full_content.size() / 32;
+    const std::string& to_store = compressed.empty() || incompressible ? full_content : compressed;
     
     // Create directory structure
     std::string dir_path = object_path.substr(0, object_path.find_last_of('/'));
     Utils::createDirectory(dir_path);
     
-    Utils::writeFile(object_path, to_store);
+    // Written under a temporary name and renamed, so concurrent writers of
+    // the same object need no lock and readers never see a partial file
+    if (!Utils::writeFileAtomic(object_path, to_store)) {
+        fail("Failed to write object " + hash);
+        return "";
+    }
+    Trace::count(Trace::OBJECTS_WRITTEN);
     
     return hash;
 }
 
 std::string MyGit::readObject(const std::string& hash) {
-    std::string object_path = getObjectPath(hash);
+    auto cached = object_cache.find(hash);
+    if (cached != object_cache.end()) {
+        Trace::count(Trace::CACHE_HITS);
+        return cached->second;
+    }
     
-    if (!Utils::fileExists(object_path)) {
+    if (hash.length() < 3) {
         return "";
     }
     
-    std::string stored_content = Utils::readFile(object_path);
-    if (stored_content.empty()) {
+    std::string object_path = getObjectPath(hash);
+    std::string content;
+    
+    if (Utils::fileExists(object_path)) {
+        // The header gives the exact size, so the result is allocated once
+        ObjectReader reader(object_path);
+        content = reader.readAll();
+        if (reader.failed()) {
+            return "";
+        }
+    } else if (!readPacked(hash, content)) {
         return "";
     }
     
-    // Try to decompress first
-    std::string decompressed = Utils::decompress(stored_content);
+    // Chunked files read back as the blob they represent
+    if (content.compare(0, 9, "manifest ") == 0) {
+        std::ostringstream blob;
+        if (!writeManifestContent(content.substr(content.find('\0') + 1), blob)) {
+            return "";
+        }
+        std::string data = blob.str();
+        content = "blob " + std::to_string(data.size()) + '\0' + data;
+    }
+    
+    // Bounded so a long-running reader cannot grow without limit
+    const size_t cache_limit = 64 << 20;
+    if (content.size() <= cache_limit / 16) {
+        if (object_cache_bytes + content.size() > cache_limit) {
+            object_cache.clear();
+            object_cache_bytes = 0;
+        }
+        object_cache_bytes += content.size();
+        object_cache.emplace(hash, content);
+    }
+    
+    return content;
+}
+
+bool MyGit::objectInfo(const std::string& hash, std::string& type, size_t& size) {
+    auto cached = object_cache.find(hash);
+    if (cached != object_cache.end()) {
+        Trace::count(Trace::CACHE_HITS);
+        const std::string& content = cached->second;
+        size_t space_pos = content.find(' ');
+        size_t null_pos = content.find('\0');
+        type = content.substr(0, space_pos);
+        size = content.size() - null_pos - 1;
+        return true;
+    }
+    
+    auto info = object_info_cache.find(hash);
+    if (info != object_info_cache.end()) {
+        Trace::count(Trace::CACHE_HITS);
+        type = info->second.first;
+        size = info->second.second;
+        return true;
+    }
+    
+    if (hash.length() < 3) {
+        return false;
+    }
+    
+    if (Utils::fileExists(getObjectPath(hash))) {
+        ObjectReader reader(getObjectPath(hash));
+        if (!reader.readHeader()) {
+            return false;
+        }
+        
+        type = reader.type();
+        size = reader.size();
+        
+        if (type == "manifest") {
+            type = "blob";
+            size = 0;
+            for (const auto& chunk : parseManifest(reader.readContent())) {
+                size += chunk.second;
+            }
+        }
+    } else {
+        // Packed entries carry type and size in their own header, so only
+        // manifests need inflating
+        loadPacks();
+        bool found = false;
+        for (const auto& pack : packs) {
+            uint64_t offset;
+            if (pack->find(hash, offset) && pack->readHeader(offset, type, size)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        
+        if (type == "manifest") {
+            std::string content = readObject(hash);
+            if (content.empty()) {
+                return false;
+            }
+            type = "blob";
+            size = content.size() - content.find('\0') - 1;
+        }
+    }
+    
+    if (object_info_cache.size() >= 65536) {
+        object_info_cache.clear();
+    }
+    object_info_cache.emplace(hash, std::make_pair(type, size));
+    
+    return true;
+}
+
+std::string MyGit::getObjectPath(const std::string& hash) const {
+    std::string path;
+    path.reserve(objects_path.size() + hash.size() + 2);
+    path += objects_path;
+    path += '/';
+    path.append(hash, 0, 2);
+    path += '/';
+    path.append(hash, 2, std::string::npos);
+    return path;
+}
+
+bool MyGit::hasObject(const std::string& hash) {
+    if (hash.length() < 3) {
+        return false;
+    }
+    if (Utils::fileExists(getObjectPath(hash))) {
+        return true;
+    }
+    
+    loadPacks();
+    uint64_t offset;
+    for (const auto& pack : packs) {
+        if (pack->find(hash, offset)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MyGit::loadPacks() {
+    if (packs_loaded) {
+        return;
+    }
+    packs_loaded = true;
+    ObjectFormat format = objectFormat();
+    
+    for (const auto& name : Utils::listDirectory(packs_path)) {
+        if (name.size() > 5 && name.compare(name.size() - 5, 5, ".pack") == 0) {
+            std::unique_ptr<Pack> pack(new Pack(packs_path + "/" + name, format));
+            if (!pack->isOpen()) continue;
+            
+            std::string bitmap_path = packs_path + "/" + name.substr(0, name.size() - 5) + ".bitmap";
+            if (!pack_bitmap && Utils::fileExists(bitmap_path)) {
+                std::unique_ptr<PackBitmap> bitmap(new PackBitmap(bitmap_path, *pack));
+                if (bitmap->isOpen()) {
+                    pack_bitmap = std::move(bitmap);
+                    bitmap_pack = pack.get();
+                }
+            }
+            packs.push_back(std::move(pack));
+        }
+    }
+}
+
+void MyGit::reloadPacks() {
+    pack_bitmap.reset();
+    bitmap_pack = nullptr;
+    packs.clear();
+    packs_loaded = false;
+    loadPacks();
+}
+
+bool MyGit::resolveHash(const std::string& prefix, std::string& hash) {
+    size_t hex_size = objectFormat().hexSize();
+    if (prefix.size() < 4 || prefix.size() > hex_size ||
+        prefix.find_first_not_of("0123456789abcdef") != std::string::npos) {
+        fail("Not a valid object name: " + prefix);
+        return false;
+    }
+    
+    if (prefix.size() == hex_size) {
+        hash = prefix;
+        return true;
+    }
+    
+    // Only the one fan-out directory and each pack's fanout range are
+    // searched, both by binary search over sorted names
+    const size_t limit = 8;
+    std::vector<std::string> matches;
+    
+    std::vector<std::string> names = Utils::listDirectory(objects_path + "/" + prefix.substr(0, 2));
+    std::sort(names.begin(), names.end());
+    std::string rest = prefix.substr(2);
+    for (auto it = std::lower_bound(names.begin(), names.end(), rest);
+         it != names.end() && it->compare(0, rest.size(), rest) == 0 && matches.size() < limit; ++it) {
+        matches.push_back(prefix.substr(0, 2) + *it);
+    }
+    
+    loadPacks();
+    for (const auto& pack : packs) {
+        pack->findPrefix(prefix, matches, limit);
+    }
+    
+    // The same object may be both loose and packed
+    std::sort(matches.begin(), matches.end());
+    matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+    
+    if (matches.empty()) {
+        fail("Object not found: " + prefix);
+        return false;
+    }
+    
+    if (matches.size() > 1) {
+        std::string candidates;
+        for (const auto& match : matches) {
+            candidates += " " + match.substr(0, 12);
+        }
+        fail("Short hash " + prefix + " is ambiguous; candidates:" + candidates);
+        return false;
+    }
+    
+    hash = matches[0];
+    return true;
+}
+
+bool MyGit::peekObject(const std::string& hash, std::string& type, std::string* content) const {
+    if (hash.length() < 3) {
+        return false;
+    }
     
-    // If decompression fails, assume it's uncompressed
-    if (decompressed.empty()) {
-        return stored_content;
+    ObjectReader reader(getObjectPath(hash));
+    if (reader.readHeader()) {
+        type = reader.type();
+        if (content) {
+            *content = reader.readContent();
+        }
+        return !reader.failed();
     }
     
-    return decompressed;
+    for (const auto& pack : packs) {
+        uint64_t offset;
+        size_t size;
+        if (pack->find(hash, offset)) {
+            return content ? pack->read(offset, type, *content) : pack->readHeader(offset, type, size);
+        }
+    }
+    return false;
 }
 
-std::string MyGit::getObjectPath(const std::string& hash) {
-    return objects_path + "/" + hash.substr(0, 2) + "/" + hash.substr(2);
+bool MyGit::readPacked(const std::string& hash, std::string& object) {
+    loadPacks();
+    
+    for (const auto& pack : packs) {
+        uint64_t offset;
+        std::string type, content;
+        if (pack->find(hash, offset) && pack->read(offset, type, content)) {
+            object = type + " " + std::to_string(content.size()) + '\0' + content;
+            return true;
+        }
+    }
+    return false;
 }
 
 std::string MyGit::hashObject(const std::string& filepath, bool write) {
     if (!Utils::fileExists(filepath)) {
-        UI::printError("File not found: " + filepath);
+        fail("File not found: " + filepath);
         return "";
     }
     
     std::string content = Utils::readFile(filepath);
     
-    // Create the full object format for hashing
-    std::string header = "blob " + std::to_string(content.length());
-    std::string full_content = header + '\0' + content;
-    
-    // Calculate hash
-    std::string hash = sha1(full_content);
+    size_t threshold = chunkThreshold();
+    if (threshold > 0 && content.size() >= threshold) {
+        return storeChunked(content, write);
+    }
     
     if (write) {
-        storeObject(content, "blob");
+        return storeObject(content, "blob");
     }
     
-    return hash;
+    std::string header = "blob " + std::to_string(content.length());
+    header += '\0';
+    
+    Trace::Scope scope(Trace::HASH);
+    Hasher checksum(objectFormat());
+    checksum.update(header);
+    checksum.update(content);
+    return checksum.final();
 }
 
-bool MyGit::catFile(const std::string& flag, const std::string& hash) {
-    std::string content = readObject(hash);
-    if (content.empty()) {
-        UI::printError("Object not found: " + hash);
+bool MyGit::catFile(const std::string& flag, const std::string& hash, std::ostream& out) {
+    if (flag != "-p" && flag != "-s" && flag != "-t") {
+        fail("Unknown flag: " + flag);
+        return false;
+    }
+    
+    // Only the header is inflated for -s and -t
+    std::string type;
+    size_t size = 0;
+    if (!objectInfo(hash, type, size)) {
+        fail("Object not found: " + hash);
         return false;
     }
     
-    // Parse header
-    size_t null_pos = content.find('\0');
-    if (null_pos == std::string::npos) {
-        UI::printError("Invalid object format");
+    if (flag == "-p") {
+        if (type != "tree") {
+            return readObjectContent(hash, out);
+        }
+        
+        // Trees hold raw hashes, so they are listed the way Git prints them
+        for (const auto& entry : readTree(hash)) {
+            out << entry.mode << ' ' << entry.type << ' ' << entry.hash << '\t' << entry.name << '\n';
+        }
+        return true;
+    }
+    
+    if (flag == "-s") {
+        out << size << "\n";
+    } else {
+        out << type << "\n";
+    }
+    
+    return true;
+}
+
+bool MyGit::readObjectContent(const std::string& hash, std::ostream& out) {
+    if (!hasObject(hash)) {
+        fail("Object not found: " + hash);
         return false;
     }
     
-    std::string header = content.substr(0, null_pos);
-    std::string data = content.substr(null_pos + 1);
+    if (!Utils::fileExists(getObjectPath(hash))) {
+        std::string content = readObject(hash);
+        size_t null_pos = content.find('\0');
+        if (null_pos == std::string::npos) {
+            fail("Corrupt object: " + hash);
+            return false;
+        }
+        out.write(content.data() + null_pos + 1, content.size() - null_pos - 1);
+        return true;
+    }
     
-    size_t space_pos = header.find(' ');
-    if (space_pos == std::string::npos) {
-        UI::printError("Invalid object header");
+    ObjectReader reader(getObjectPath(hash));
+    if (!reader.readHeader()) {
+        fail("Invalid object format");
         return false;
     }
     
-    std::string type = header.substr(0, space_pos);
-    std::string size_str = header.substr(space_pos + 1);
+    // A manifest stands in for a chunked blob
+    if (reader.type() == "manifest") {
+        return writeManifestContent(reader.readContent(), out);
+    }
+    
+    // Raw objects are written straight from the mapping, compressed ones
+    // are streamed in fixed-size chunks
+    if (reader.isRaw()) {
+        std::string_view content = reader.view();
+        out.write(content.data(), content.size());
+        return !reader.failed();
+    }
     
-    if (flag == "-p") {
-        std::cout << data;
-    } else if (flag == "-s") {
-        std::cout << size_str << std::endl;
-    } else if (flag == "-t") {
-        std::cout << type << std::endl;
-    } else {
-        UI::printError("Unknown flag: " + flag);
+    std::vector<char> buf(65536);
+    size_t n;
+    while ((n = reader.read(buf.data(), buf.size())) > 0) {
+        out.write(buf.data(), n);
+    }
+    if (reader.failed()) {
+        out.flush();
+        fail("Corrupt object: " + hash);
         return false;
     }
     
     return true;
 }
 
-std::string MyGit::writeTree(const std::string& path) {
-    std::string tree_content = "";
+bool MyGit::catFileBatch(bool print_content, int in_fd, int out_fd) {
+    // One writer for the whole session; it is flushed when it fills or when
+    // no further request is waiting on the input, so pipelined requests
+    // share syscalls
+    OutputBuffer out(out_fd);
+    OutputStreamBuf out_buf(out);
+    std::ostream content_out(&out_buf);
+    std::vector<char> in_buf(65536);
+    std::string line;
     
-    try {
-        std::vector<std::pair<std::string, std::string>> entries;
+    auto answer = [&](std::string hash) {
+        hash.erase(hash.find_last_not_of(" \r\t") + 1);
+        if (hash.empty()) return true;
+        
+        std::string type;
+        size_t size = 0;
+        if (!objectInfo(hash, type, size)) {
+            out.write(hash + " missing\n");
+            return true;
+        }
+        
+        out.write(hash + " " + type + " " + std::to_string(size) + "\n");
+        if (!print_content) {
+            return true;
+        }
+        
+        // Content goes out in chunks from the mapping or the inflater; past
+        // the header there is no way to report a bad object but to stop
+        if (!readObjectContent(hash, content_out)) {
+            return false;
+        }
+        out.put('\n');
+        return true;
+    };
+    
+    while (true) {
+        struct pollfd ready = {in_fd, POLLIN, 0};
+        if (poll(&ready, 1, 0) == 0) {
+            out.flush();
+        }
+        ssize_t n = ::read(in_fd, in_buf.data(), in_buf.size());
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        
+        const char* p = in_buf.data();
+        const char* end = p + n;
+        while (p < end) {
+            const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+            if (!newline) {
+                line.append(p, end);
+                break;
+            }
+            line.append(p, newline);
+            if (!answer(line)) {
+                out.flush();
+                return false;
+            }
+            line.clear();
+            p = newline + 1;
+        }
+    }
+    
+    bool answered = answer(line);
+    return out.flush() && answered;
+}
+
+std::string MyGit::writeTree(const std::string& path) {
+    Trace::Scope scope(Trace::WALK);
+    
+    // One node per directory. A node finishes once its own scan and every
+    // task it spawned (subdirectories and batches of files) are done; the
+    // last of them builds and stores its tree, fills in the parent's entry
+    // and may in turn finish the parent.
+    //
+    // Nodes, names, paths and hashes live in per-thread arenas that are
+    // released together when the tree is written, so the scan itself costs
+    // no heap allocation per entry.
+    struct Node {
+        std::string_view path;
+        Node* parent;
+        size_t slot;
+        TreeFormat::EntryRef* entries = nullptr;
+        size_t count = 0;
+        std::atomic<size_t> pending;
+        std::string_view hash;
         
-        for (const auto& entry : fs::directory_iterator(path)) {
-            if (entry.path().filename() == ".mygit") continue;
+        Node(std::string_view path, Node* parent, size_t slot) : path(path), parent(parent), slot(slot), pending(1) {}
+    };
+    
+    // Hashing and storing from several threads needs the packs and config
+    // loaded up front
+    loadPacks();
+    chunkThreshold();
+    int format = treeFormat();
+    
+    std::vector<std::unique_ptr<Arena>> arenas;
+    ThreadPool pool;
+    for (unsigned i = 0; i <= pool.size(); i++) {
+        arenas.emplace_back(new Arena());
+    }
+    auto arena = [&]() -> Arena& { return *arenas[pool.workerIndex()]; };
+    Node* root = arena().make<Node>(arena().copy(path), nullptr, 0);
+    
+    // Set by any directory that cannot be read or object that cannot be
+    // stored; the walk still runs to the end, but no tree is returned
+    std::atomic<bool> failed(false);
+    
+    std::function<void(Node*)> finish = [&](Node* node) {
+        while (node) {
+            if (!failed) {
+                node->hash = arena().copy(storeObject(TreeFormat::encode(node->entries, node->count, format), "tree"));
+                if (node->hash.empty()) failed = true;
+            }
             
-            std::string name = entry.path().filename().string();
-            std::string mode, type, hash;
+            Node* parent = node->parent;
+            if (!parent) return;
+            parent->entries[node->slot].hash = node->hash;
+            node = --parent->pending == 0 ? parent : nullptr;
+        }
+    };
+    
+    std::function<void(Node*)> scan = [&](Node* node) {
+        // Scratch lists reused by every scan on this thread; the entries are
+        // copied into the arena once their number is known
+        thread_local std::vector<TreeFormat::EntryRef> found;
+        thread_local std::vector<size_t> files;
+        thread_local std::vector<Node*> children;
+        found.clear();
+        files.clear();
+        children.clear();
+        
+        Arena& memory = arena();
+        bool ok = Utils::scanDirectory(node->path.data(), [&](const Utils::DirectoryEntry& entry) {
+            if (strcmp(entry.name, ".mygit") == 0) return;
             
-            if (entry.is_directory()) {
-                mode = "040000";
-                type = "tree";
-                hash = writeTree(entry.path().string());
+            std::string_view name = memory.copy(entry.name);
+            if (entry.directory) {
+                children.push_back(memory.make<Node>(memory.join(node->path, name), node, found.size()));
+                found.push_back({"040000", name, ""});
             } else {
-                mode = "100644";
-                type = "blob";
-                hash = hashObject(entry.path().string(), true);
-            }
-            
-            if (!hash.empty()) {
-                entries.push_back({mode + " " + name, hash});
+                files.push_back(found.size());
+                found.push_back({"100644", name, ""});
             }
+        });
+        if (!ok) {
+            fail("Error writing tree: " + std::string(node->path) + ": " + strerror(errno));
+            failed = true;
+            found.clear();
+            files.clear();
+            children.clear();
         }
         
-        // Sort entries by name for consistent tree hashes
-        std::sort(entries.begin(), entries.end());
+        node->entries = memory.array<TreeFormat::EntryRef>(found.size());
+        node->count = found.size();
+        std::copy(found.begin(), found.end(), node->entries);
+        size_t* slots = memory.array<size_t>(files.size());
+        std::copy(files.begin(), files.end(), slots);
         
-        for (const auto& entry : entries) {
-            tree_content += entry.first + "\0" + entry.second;
+        // Entries are complete before any task is spawned, so tasks only
+        // ever write their own slots
+        size_t batches = (files.size() + WRITE_TREE_BATCH - 1) / WRITE_TREE_BATCH;
+        node->pending += children.size() + batches;
+        for (Node* child : children) {
+            pool.submit([&, child]() { scan(child); });
+        }
+        for (size_t start = 0; start < files.size(); start += WRITE_TREE_BATCH) {
+            size_t end = std::min(files.size(), start + WRITE_TREE_BATCH);
+            pool.submit([&, node, slots, start, end]() {
+                Arena& memory = arena();
+                for (size_t i = start; i < end; i++) {
+                    auto& entry = node->entries[slots[i]];
+                    entry.hash = memory.copy(hashObject(std::string(memory.join(node->path, entry.name)), true));
+                    if (entry.hash.empty()) failed = true;
+                }
+                if (--node->pending == 0) finish(node);
+            });
         }
         
-        return storeObject(tree_content, "tree");
-    } catch (const std::exception& e) {
-        UI::printError("Error writing tree: " + std::string(e.what()));
+        if (--node->pending == 0) finish(node);
+    };
+    
+    pool.submit([&]() { scan(root); });
+    pool.wait();
+    if (failed) {
         return "";
     }
+    
+    // Directories outside a sparse checkout are not on disk; they keep
+    // what HEAD, or the merge in progress, has
+    std::string hash(root->hash);
+    if (path == "." && !hash.empty() && sparseCone().isActive()) {
+        std::string base = Utils::fileExists(merge_tree_path) ? Utils::readFile(merge_tree_path) : "";
+        CommitInfo head;
+        if (base.empty() && readCommit(getCurrentCommit(), head)) {
+            base = head.tree_hash;
+        }
+        base.erase(base.find_last_not_of(" \n\r\t") + 1);
+        hash = sparseTree(hash, base, "");
+    }
+    return hash;
 }
 
 std::vector<TreeEntry> MyGit::readTree(const std::string& tree_hash) {
-    std::vector<TreeEntry> entries;
     std::string content = readObject(tree_hash);
     
-    if (content.empty()) {
-        return entries;
-    }
-    
     // Skip header
     size_t data_start = content.find('\0');
-    if (data_start == std::string::npos) {
-        return entries;
+    if (content.empty() || data_start == std::string::npos) {
+        return {};
     }
     
-    std::string tree_data = content.substr(data_start + 1);
-    
-    size_t pos = 0;
-    while (pos < tree_data.length()) {
-        // Find space (between mode and name)
-        size_t space_pos = tree_data.find(' ', pos);
-        if (space_pos == std::string::npos) break;
-        
-        // Find null (between name and hash)
-        size_t null_pos = tree_data.find('\0', space_pos);
-        if (null_pos == std::string::npos) break;
-        
-        // Make sure we have enough data for the hash (40 characters)
-        if (null_pos + 40 > tree_data.length()) break;
-        
-        TreeEntry entry;
-        entry.mode = tree_data.substr(pos, space_pos - pos);
-        entry.name = tree_data.substr(space_pos + 1, null_pos - space_pos - 1);
-        entry.hash = tree_data.substr(null_pos + 1, 40);
-        entry.type = (entry.mode == "040000") ? "tree" : "blob";
-        
-        entries.push_back(entry);
-        
-        // Move to next entry
-        pos = null_pos + 1 + 40;
+    return parseTree(std::string_view(content).substr(data_start + 1));
+}
+
+std::vector<TreeEntry> MyGit::parseTree(std::string_view tree_data) {
+    // Trees of either repository format, so history written before a
+    // migration stays readable
+    std::vector<TreeEntry> entries;
+    if (!TreeFormat::decode(tree_data, entries, objectFormat().rawSize())) {
+        entries.clear();
     }
-    
     return entries;
 }
 
-bool MyGit::lsTree(const std::string& tree_hash, bool name_only) {
-    std::vector<TreeEntry> entries = readTree(tree_hash);
-    
-    if (!name_only) {
-        std::cout << std::endl;
+ObjectFormat MyGit::objectFormat() {
+    if (object_format < 0) {
+        std::string name = getConfig("extensions.objectFormat", "sha1");
+        ObjectFormat format;
+        if (!ObjectFormat::parse(name, format)) {
+            fail("Unknown object format '" + name + "' in config; assuming sha1");
+        }
+        object_format = format.algorithm();
     }
-    
-    for (const auto& entry : entries) {
-        if (name_only) {
-            std::cout << entry.name << std::endl;
-        } else {
-            UI::printTreeEntry(entry.mode, entry.type, entry.hash, entry.name);
+    return ObjectFormat(static_cast<ObjectFormat::Algorithm>(object_format));
+}
+
+int MyGit::treeFormat() {
+    if (tree_format < 0) {
+        try {
+            tree_format = std::stoi(getConfig("core.repositoryFormatVersion", "0"));
+        } catch (...) {
+            tree_format = TreeFormat::HEX;
         }
     }
-    
-    if (!name_only) {
-        std::cout << std::endl;
-        std::cout << DIM << entries.size() << " entries" << RESET << std::endl;
+    return tree_format;
+}
+
+size_t MyGit::chunkThreshold() {
+    // Read once, since every file hashed asks
+    if (chunk_threshold < 0) {
+        try {
+            chunk_threshold = std::stoull(getConfig("chunking.threshold", "0"));
+        } catch (...) {
+            chunk_threshold = 0;
+        }
     }
-    
-    return true;
+    return chunk_threshold;
 }
 
-std::map<std::string, std::string> MyGit::readIndex() {
-    std::map<std::string, std::string> index;
+std::string MyGit::storeChunked(const std::string& content, bool write) {
+    size_t avg_size = 65536;
+    try {
+        avg_size = std::stoull(getConfig("chunking.avgSize", "65536"));
+    } catch (...) {}
     
-    if (!Utils::fileExists(index_path)) {
-        return index;
+    FastCDC::Params params = FastCDC::paramsForAverage(avg_size);
+    
+    // Each chunk is an ordinary blob, so unchanged regions of a new revision
+    // hash to objects that already exist and are never written again
+    std::string manifest;
+    size_t offset = 0;
+    for (size_t length : FastCDC::split(content.data(), content.size(), params)) {
+        std::string chunk = content.substr(offset, length);
+        std::string hash;
+        if (write) {
+            hash = storeObject(chunk, "blob");
+        } else {
+            Trace::Scope scope(Trace::HASH);
+            hash = Hasher::object(objectFormat(), "blob", chunk);
+        }
+        manifest += hash + " " + std::to_string(length) + "\n";
+        offset += length;
     }
     
-    std::string content = Utils::readFile(index_path);
-    std::istringstream iss(content);
+    if (write) {
+        return storeObject(manifest, "manifest");
+    }
+    return Hasher::object(objectFormat(), "manifest", manifest);
+}
+
+std::vector<std::pair<std::string, size_t>> MyGit::parseManifest(const std::string& manifest) {
+    std::vector<std::pair<std::string, size_t>> chunks;
+    std::istringstream iss(manifest);
     std::string line;
     
     while (std::getline(iss, line)) {
-        if (line.empty()) continue;
-        
         size_t space_pos = line.find(' ');
-        if (space_pos != std::string::npos) {
-            std::string hash = line.substr(0, space_pos);
-            std::string filename = line.substr(space_pos + 1);
-            index[filename] = hash;
+        if (space_pos == std::string::npos) continue;
+        try {
+            chunks.push_back({line.substr(0, space_pos), std::stoull(line.substr(space_pos + 1))});
+        } catch (...) {
+            return {};
         }
     }
     
-    return index;
+    return chunks;
 }
 
-void MyGit::writeIndex(const std::map<std::string, std::string>& index) {
-    std::ostringstream oss;
+bool MyGit::writeManifestContent(const std::string& manifest, std::ostream& out) {
+    // Chunks are streamed one at a time, so memory stays bounded by the
+    // copy buffer no matter how large the file is
+    std::vector<char> buf(65536);
     
-    for (const auto& pair : index) {
-        oss << pair.second << " " << pair.first << std::endl;
+    for (const auto& chunk : parseManifest(manifest)) {
+        if (chunk.first.length() < 3) return false;
+        
+        if (!Utils::fileExists(getObjectPath(chunk.first))) {
+            std::string object;
+            if (!readPacked(chunk.first, object) || object.size() - object.find('\0') - 1 != chunk.second) {
+                fail("Missing chunk: " + chunk.first);
+                return false;
+            }
+            out.write(object.data() + object.size() - chunk.second, chunk.second);
+            continue;
+        }
+        
+        ObjectReader reader(getObjectPath(chunk.first));
+        if (!reader.readHeader() || reader.size() != chunk.second) {
+            fail("Missing chunk: " + chunk.first);
+            return false;
+        }
+        
+        size_t n;
+        while ((n = reader.read(buf.data(), buf.size())) > 0) {
+            out.write(buf.data(), n);
+        }
+        if (reader.failed()) {
+            fail("Corrupt chunk: " + chunk.first);
+            return false;
+        }
     }
     
-    Utils::writeFile(index_path, oss.str());
+    return true;
+}
+
+std::string MyGit::getConfig(const std::string& key, const std::string& default_value) {
+    if (!config_loaded) {
+        config_loaded = true;
+        
+        std::istringstream iss(Utils::readFile(config_path));
+        std::string line;
+        while (std::getline(iss, line)) {
+            size_t eq_pos = line.find('=');
+            if (line.empty() || line[0] == '#' || eq_pos == std::string::npos) continue;
+            
+            std::string name = line.substr(0, eq_pos);
+            std::string value = line.substr(eq_pos + 1);
+            name.erase(name.find_last_not_of(" \t") + 1);
+            value.erase(0, value.find_first_not_of(" \t"));
+            config[name] = value;
+        }
+    }
+    
+    auto it = config.find(key);
+    return it == config.end() ? default_value : it->second;
+}
+
+bool MyGit::setConfig(const std::string& key, const std::string& value) {
+    LockFile lock(config_path);
+    if (!lock.acquire()) {
+        fail("Unable to lock " + lock.lockPath() + ": another mygit process may be running");
+        return false;
+    }
+    
+    // Re-read under the lock so a concurrent change to another key survives
+    config.clear();
+    config_loaded = false;
+    tree_format = -1;
+    chunk_threshold = -1;
+    object_format = -1;
+    getConfig(key);
+    config[key] = value;
+    
+    std::ostringstream oss;
+    for (const auto& pair : config) {
+        oss << pair.first << " = " << pair.second << "\n";
+    }
+    
+    return lock.commit(oss.str());
+}
+
+std::map<std::string, std::string> MyGit::readIndex() {
+    Trace::Scope scope(Trace::INDEX_READ);
+    std::map<std::string, std::string> index;
+    
+    if (!Utils::fileExists(index_path)) {
+        return index;
+    }
+    
+    std::string content = Utils::readFile(index_path);
+    std::istringstream iss(content);
+    std::string line;
+    
+    while (std::getline(iss, line)) {
+        if (line.empty()) continue;
+        
+        size_t space_pos = line.find(' ');
+        if (space_pos != std::string::npos) {
+            std::string hash = line.substr(0, space_pos);
+            std::string filename = line.substr(space_pos + 1);
+            index[filename] = hash;
+        }
+    }
+    
+    return index;
+}
+
+bool MyGit::writeIndex(const std::map<std::string, std::string>& index, LockFile& lock) {
+    Trace::Scope scope(Trace::INDEX_WRITE);
+    std::ostringstream oss;
+    
+    for (const auto& pair : index) {
+        oss << pair.second << " " << pair.first << "\n";
+    }
+    
+    return lock.commit(oss.str());
 }
 
 bool MyGit::add(const std::vector<std::string>& files) {
-    std::map<std::string, std::string> index = readIndex();
+    // Files are hashed before the index is locked, so concurrent adds only
+    // serialize on the short read-merge-write of the index itself
+    std::map<std::string, std::string> staged;
     int added_count = 0;
     
     for (const std::string& file : files) {
         if (file == ".") {
-            UI::printProgress("Adding all files...");
+            reporter->progress("Adding all files...");
+            Trace::Scope scope(Trace::WALK);
             try {
-                for (const auto& entry : fs::recursive_directory_iterator(".")) {
+                const SparseCone& cone = sparseCone();
+                for (auto it = fs::recursive_directory_iterator("."); it != fs::recursive_directory_iterator(); ++it) {
+                    const auto& entry = *it;
+                    Trace::count(Trace::FILES_STATED);
+                    if (entry.is_directory() && cone.directory(entry.path().string()) == SparseCone::OUTSIDE) {
+                        it.disable_recursion_pending();
+                        continue;
+                    }
                     if (entry.is_regular_file() && 
                         entry.path().string().find(".mygit") == std::string::npos) {
                         std::string filepath = entry.path().string();
                         std::string hash = hashObject(filepath, true);
                         if (!hash.empty()) {
-                            index[filepath] = hash;
+                            staged[filepath] = hash;
                             added_count++;
                         }
                     }
                 }
             } catch (const std::exception& e) {
-                UI::printError(std::string("Error adding files: ") + e.what());
+                fail(std::string("Error adding files: ") + e.what());
                 return false;
             }
         } else {
+            if (!sparseCone().includesFile(file)) {
+                fail("Outside the sparse-checkout cone: " + file);
+                return false;
+            }
             std::string hash = hashObject(file, true);
             if (!hash.empty()) {
-                index[file] = hash;
-                UI::printSuccess("Added: " + file);
+                staged[file] = hash;
+                reporter->success("Added: " + file);
                 added_count++;
             } else {
-                UI::printError("Failed to add file: " + file);
+                fail("Failed to add file: " + file);
                 return false;
             }
         }
     }
     
-    writeIndex(index);
+    LockFile lock(index_path);
+    if (!lock.acquire()) {
+        fail("Unable to lock " + lock.lockPath() + ": another mygit process may be running");
+        return false;
+    }
+    
+    std::map<std::string, std::string> index = readIndex();
+    for (const auto& pair : staged) {
+        index[pair.first] = pair.second;
+    }
+    
+    if (!writeIndex(index, lock)) {
+        fail("Failed to write index");
+        return false;
+    }
     
     if (added_count > 0) {
-        UI::printInfo(std::to_string(added_count) + " file(s) added to staging area");
+        reporter->info(std::to_string(added_count) + " file(s) added to staging area");
     }
     
     return true;
@@ -365,191 +1069,487 @@ std::string MyGit::commit(const std::string& message) {
     // Create tree from staged files
     std::string tree_hash = writeTree();
     if (tree_hash.empty()) {
-        UI::printError("Failed to create tree");
+        fail("Failed to create tree");
         return "";
     }
     
-    // Get parent commit
+    // Get parent commit, and the other side of an unfinished merge
     std::string parent_hash = getCurrentCommit();
+    std::string merge_head = readMergeHead();
     
     // Create commit object
-    std::string commit_message = message.empty() ? "Default commit message" : message;
+    std::vector<std::string> parents;
+    if (!parent_hash.empty()) {
+        parents.push_back(parent_hash);
+    }
+    if (!merge_head.empty()) {
+        parents.push_back(merge_head);
+    }
+    std::string commit_hash = storeCommit(tree_hash, parents, message.empty() ? "Default commit message" : message);
+    
+    // Only advances HEAD if no other commit landed since the parent was read
+    if (commit_hash.empty() || !updateHead(commit_hash, parent_hash)) {
+        return "";
+    }
+    if (!merge_head.empty()) {
+        unlink(merge_head_path.c_str());
+        unlink(merge_tree_path.c_str());
+    }
+    
+    return commit_hash;
+}
+
+std::string MyGit::storeCommit(const std::string& tree_hash, const std::vector<std::string>& parents,
+                               const std::string& message) {
     std::string timestamp = Utils::getCurrentTimestamp();
     
     std::ostringstream commit_content;
     commit_content << "tree " << tree_hash << std::endl;
-    if (!parent_hash.empty()) {
-        commit_content << "parent " << parent_hash << std::endl;
+    for (const auto& parent : parents) {
+        commit_content << "parent " << parent << std::endl;
     }
     commit_content << "author MyGit <mygit@example.com> " << timestamp << std::endl;
     commit_content << "committer MyGit <mygit@example.com> " << timestamp << std::endl;
     commit_content << std::endl;
-    commit_content << commit_message << std::endl;
-    
-    std::string commit_hash = storeObject(commit_content.str(), "commit");
+    commit_content << message << std::endl;
     
-    // Update HEAD
-    updateHead(commit_hash);
-    
-    return commit_hash;
+    return storeObject(commit_content.str(), "commit");
 }
 
-std::string MyGit::getCurrentCommit() {
-    if (!Utils::fileExists(head_path)) {
+namespace {
+    // The ref HEAD points at, or "" when it holds a commit hash. An empty
+    // HEAD (repositories created before branches existed) is an unborn master.
+    std::string symbolicTarget(const std::string& head) {
+        if (head.empty()) return "refs/heads/master";
+        if (head.compare(0, 5, "ref: ") == 0) return head.substr(5);
         return "";
     }
-    
+}
+
+std::string MyGit::readHead() {
     std::string head_content = Utils::readFile(head_path);
     // Remove trailing whitespace
     head_content.erase(head_content.find_last_not_of(" \n\r\t") + 1);
     return head_content;
 }
 
-void MyGit::updateHead(const std::string& commit_hash) {
-    Utils::writeFile(head_path, commit_hash);
+std::string MyGit::readMergeHead() {
+    if (!Utils::fileExists(merge_head_path)) {
+        return "";
+    }
+    std::string hash = Utils::readFile(merge_head_path);
+    hash.erase(hash.find_last_not_of(" \n\r\t") + 1);
+    return hash;
+}
+
+std::string MyGit::getCurrentCommit() {
+    std::string head = readHead();
+    std::string ref = symbolicTarget(head);
+    return ref.empty() ? head : resolveRef(ref);
 }
 
-bool MyGit::log() {
-    std::string current_hash = getCurrentCommit();
+std::string MyGit::currentBranch() {
+    std::string ref = symbolicTarget(readHead());
+    return ref.compare(0, 11, "refs/heads/") == 0 ? ref.substr(11) : "";
+}
+
+std::string MyGit::resolveRef(const std::string& refname) {
+    // A loose ref file overrides the packed entry
+    std::string path = repo_path + "/" + refname;
+    if (Utils::fileExists(path)) {
+        std::string hash = Utils::readFile(path);
+        hash.erase(hash.find_last_not_of(" \n\r\t") + 1);
+        return hash;
+    }
     
-    if (current_hash.empty()) {
-        UI::printInfo("No commits found");
-        return true;
+    std::string hash;
+    PackedRefs packed(packed_refs_path);
+    return packed.lookup(refname, hash) ? hash : "";
+}
+
+bool MyGit::updateRef(const std::string& refname, const std::string& hash, const std::string& expected) {
+    std::string path = repo_path + "/" + refname;
+    Utils::createDirectory(path.substr(0, path.find_last_of('/')));
+    
+    LockFile lock(path);
+    if (!lock.acquire()) {
+        fail("Unable to lock " + lock.lockPath() + ": another mygit process may be running");
+        return false;
     }
     
-    UI::printSeparator();
+    // Compare-and-swap under the lock
+    std::string current = resolveRef(refname);
+    if (current != expected) {
+        fail(refname + " moved to " + (current.empty() ? std::string("(none)") : current.substr(0, 7)) +
+             " while this command ran; not updating it");
+        return false;
+    }
     
-    bool first = true;
-    while (!current_hash.empty()) {
-        std::string commit_content = readObject(current_hash);
-        if (commit_content.empty()) {
-            break;
+    if (!lock.commit(hash + "\n")) {
+        fail("Failed to update " + refname);
+        return false;
+    }
+    return true;
+}
+
+bool MyGit::writeHead(const std::string& content, const std::string& expected) {
+    LockFile lock(head_path);
+    if (!lock.acquire()) {
+        fail("Unable to lock " + lock.lockPath() + ": another mygit process may be running");
+        return false;
+    }
+    
+    if (readHead() != expected) {
+        fail("HEAD changed while this command ran; not updating it");
+        return false;
+    }
+    
+    if (!lock.commit(content + "\n")) {
+        fail("Failed to update HEAD");
+        return false;
+    }
+    return true;
+}
+
+bool MyGit::updateHead(const std::string& commit_hash, const std::string& expected) {
+    // On a branch the branch moves; a detached HEAD is rewritten in place
+    std::string head = readHead();
+    std::string ref = symbolicTarget(head);
+    if (!ref.empty()) {
+        return updateRef(ref, commit_hash, expected);
+    }
+    
+    if (head != expected) {
+        fail("HEAD moved to " + head.substr(0, 7) + " while this command ran; not updating it");
+        return false;
+    }
+    return writeHead(commit_hash, head);
+}
+
+std::vector<BranchEntry> MyGit::listBranches() {
+    std::map<std::string, std::string> branches;
+    
+    PackedRefs packed(packed_refs_path);
+    for (const auto& ref : packed.list("refs/heads/")) {
+        branches[ref.first.substr(11)] = ref.second;
+    }
+    
+    std::string heads_path = refs_path + "/heads";
+    if (Utils::directoryExists(heads_path)) {
+        try {
+            for (const auto& entry : fs::recursive_directory_iterator(heads_path)) {
+                std::string name = entry.path().string().substr(heads_path.size() + 1);
+                if (entry.is_regular_file() && Refs::isValidBranchName(name)) {
+                    branches[name] = resolveRef("refs/heads/" + name);
+                }
+            }
+        } catch (...) {}
+    }
+    
+    std::vector<BranchEntry> result;
+    for (const auto& branch : branches) {
+        result.push_back({branch.first, branch.second});
+    }
+    return result;
+}
+
+bool MyGit::createBranch(const std::string& name, const std::string& start) {
+    if (!Refs::isValidBranchName(name)) {
+        fail("Not a valid branch name: " + name);
+        return false;
+    }
+    
+    std::string refname = "refs/heads/" + name;
+    if (!resolveRef(refname).empty()) {
+        fail("A branch named '" + name + "' already exists");
+        return false;
+    }
+    
+    std::string hash = start.empty() ? getCurrentCommit() : start;
+    CommitInfo info;
+    if (hash.empty() || !readCommit(hash, info)) {
+        fail("Not a valid starting commit: " + (start.empty() ? std::string("HEAD") : start));
+        return false;
+    }
+    
+    return updateRef(refname, hash, "");
+}
+
+bool MyGit::deleteBranch(const std::string& name) {
+    if (name == currentBranch()) {
+        fail("Cannot delete the checked-out branch '" + name + "'");
+        return false;
+    }
+    
+    std::string refname = "refs/heads/" + name;
+    std::string path = repo_path + "/" + refname;
+    LockFile ref_lock(path);
+    LockFile packed_lock(packed_refs_path);
+    if (!Refs::isValidBranchName(name) || !ref_lock.acquire() || !packed_lock.acquire()) {
+        fail("Unable to lock branch '" + name + "'");
+        return false;
+    }
+    
+    bool loose = Utils::fileExists(path);
+    std::vector<std::pair<std::string, std::string>> packed = PackedRefs(packed_refs_path).list();
+    auto it = std::find_if(packed.begin(), packed.end(), [&](const std::pair<std::string, std::string>& ref) {
+        return ref.first == refname;
+    });
+    
+    if (!loose && it == packed.end()) {
+        fail("Branch not found: " + name);
+        return false;
+    }
+    
+    if (it != packed.end()) {
+        packed.erase(it);
+        if (!PackedRefs::write(packed_lock, packed)) {
+            fail("Failed to update packed-refs");
+            return false;
         }
-        
-        // Parse commit
-        size_t data_start = commit_content.find('\0');
-        if (data_start != std::string::npos) {
-            commit_content = commit_content.substr(data_start + 1);
+    }
+    if (loose) {
+        unlink(path.c_str());
+    }
+    return true;
+}
+
+bool MyGit::switchBranch(const std::string& name, bool create) {
+    std::string previous = readHead();
+    
+    if (create) {
+        if (!Refs::isValidBranchName(name)) {
+            fail("Not a valid branch name: " + name);
+            return false;
         }
-        
-        std::istringstream iss(commit_content);
-        std::string line;
-        std::string tree_hash, parent_hash, author, committer, message;
-        
-        while (std::getline(iss, line)) {
-            if (line.empty()) {
-                std::getline(iss, message);
-                break;
-            } else if (line.substr(0, 5) == "tree ") {
-                tree_hash = line.substr(5);
-            } else if (line.substr(0, 7) == "parent ") {
-                parent_hash = line.substr(7);
-            } else if (line.substr(0, 7) == "author ") {
-                author = line.substr(7);
-            } else if (line.substr(0, 10) == "committer ") {
-                committer = line.substr(10);
-            }
+        // An unborn HEAD is only renamed, there is nothing to branch from
+        if (!getCurrentCommit().empty() && !createBranch(name)) {
+            return false;
         }
-        
-        // Display enhanced commit info
-        if (!first) {
-            std::cout << YELLOW << "│" << RESET << std::endl;
+    } else {
+        std::string hash = resolveRef("refs/heads/" + name);
+        if (hash.empty()) {
+            fail("Branch not found: " + name);
+            return false;
         }
-        
-        std::cout << YELLOW << DOT << " " << BRIGHT_YELLOW << "commit " << current_hash << RESET;
-        if (first) {
-            std::cout << " " << BRIGHT_CYAN << "(HEAD -> master)" << RESET;
+        std::string head = getCurrentCommit();
+        if (hash != head) {
+            CommitInfo from, to;
+            if (!readCommit(hash, to)) {
+                fail("Invalid commit format: no tree found");
+                return false;
+            }
+            
+            // Only the paths that differ between the two commits are
+            // rewritten, so nothing may be uncommitted
+            if (!head.empty()) {
+                std::string worktree = writeTree();
+                if (worktree.empty() || !readCommit(head, from)) {
+                    return false;
+                }
+                if (worktree != from.tree_hash) {
+                    fail("The worktree has uncommitted changes; commit them before switching branches");
+                    return false;
+                }
+            }
+            if (!updateWorktree(from.tree_hash, to.tree_hash, ".")) {
+                return false;
+            }
         }
-        std::cout << std::endl;
-        
-        if (!parent_hash.empty()) {
-            std::cout << YELLOW << "│" << RESET << " " << DIM << "Parent: " << parent_hash.substr(0, 7) << RESET << std::endl;
+    }
+    
+    return writeHead("ref: refs/heads/" + name, previous);
+}
+
+bool MyGit::packRefs() {
+    LockFile packed_lock(packed_refs_path);
+    if (!packed_lock.acquire()) {
+        fail("Unable to lock " + packed_lock.lockPath());
+        return false;
+    }
+    
+    std::map<std::string, std::string> refs;
+    for (const auto& ref : PackedRefs(packed_refs_path).list()) {
+        refs[ref.first] = ref.second;
+    }
+    
+    std::map<std::string, std::string> loose;
+    try {
+        for (const auto& entry : fs::recursive_directory_iterator(refs_path)) {
+            std::string path = entry.path().string();
+            if (!entry.is_regular_file() || path.size() < 5 || path.compare(path.size() - 5, 5, ".lock") == 0) {
+                continue;
+            }
+            std::string refname = path.substr(repo_path.size() + 1);
+            loose[refname] = refs[refname] = resolveRef(refname);
         }
-        
-        std::cout << YELLOW << "│" << RESET << " " << "Author: " << BRIGHT_WHITE << author << RESET << std::endl;
-        std::cout << YELLOW << "│" << RESET << " " << "Date:   " << DIM << committer << RESET << std::endl;
-        std::cout << YELLOW << "│" << RESET << std::endl;
-        std::cout << YELLOW << "│" << RESET << "     " << message << std::endl;
-        
-        current_hash = parent_hash;
-        first = false;
+    } catch (const std::exception& e) {
+        fail(std::string("Error reading refs: ") + e.what());
+        return false;
     }
     
-    std::cout << std::endl;
-    UI::printSeparator();
+    if (!PackedRefs::write(packed_lock, std::vector<std::pair<std::string, std::string>>(refs.begin(), refs.end()))) {
+        fail("Failed to write packed-refs");
+        return false;
+    }
     
+    // Loose files are only removed if nobody moved them meanwhile
+    for (const auto& ref : loose) {
+        std::string path = repo_path + "/" + ref.first;
+        LockFile lock(path);
+        if (lock.acquire(0) && resolveRef(ref.first) == ref.second) {
+            unlink(path.c_str());
+        }
+    }
     return true;
 }
 
-void MyGit::restoreTree(const std::string& tree_hash, const std::string& path) {
-    std::vector<TreeEntry> entries = readTree(tree_hash);
+bool MyGit::readCommit(const std::string& commit_hash, CommitInfo& info) {
+    std::string commit_content = readObject(commit_hash);
+    size_t data_start = commit_content.find('\0');
+    if (commit_content.empty() || data_start == std::string::npos ||
+        commit_content.compare(0, 7, "commit ") != 0) {
+        return false;
+    }
+    
+    info = CommitInfo();
+    info.hash = commit_hash;
+    
+    std::istringstream iss(commit_content.substr(data_start + 1));
+    std::string line;
+    
+    while (std::getline(iss, line)) {
+        if (line.empty()) {
+            // Everything after the blank line is the message
+            std::ostringstream message;
+            message << iss.rdbuf();
+            info.message = message.str();
+            info.message.erase(info.message.find_last_not_of("\n") + 1);
+            break;
+        } else if (line.substr(0, 5) == "tree ") {
+            info.tree_hash = line.substr(5);
+        } else if (line.substr(0, 7) == "parent ") {
+            info.parents.push_back(line.substr(7));
+            if (info.parent_hash.empty()) info.parent_hash = info.parents.back();
+        } else if (line.substr(0, 7) == "author ") {
+            // "Name <email> timestamp"
+            std::string author = line.substr(7);
+            size_t email_end = author.find('>');
+            if (email_end != std::string::npos) {
+                info.author = author.substr(0, email_end + 1);
+                info.timestamp = author.substr(std::min(email_end + 2, author.size()));
+            } else {
+                info.author = author;
+            }
+        }
+    }
+    
+    return !info.tree_hash.empty();
+}
+
+bool MyGit::restoreTree(const std::string& tree_hash, std::string_view path, Arena& arena) {
+    // Entries point into the tree object, so it is kept until they are done
+    std::string content = readObject(tree_hash);
+    size_t data_start = content.find('\0');
+    std::pmr::vector<TreeFormat::EntryRef> entries(&arena);
+    if (content.empty() || data_start == std::string::npos ||
+        !TreeFormat::decode(std::string_view(content).substr(data_start + 1), entries, arena,
+                            objectFormat().rawSize())) {
+        fail("Corrupt object " + tree_hash);
+        return false;
+    }
     
+    const SparseCone& cone = sparseCone();
     for (const auto& entry : entries) {
         // Only skip build artifacts and the executable itself
         if (entry.name == "mygit" ||
             entry.name == "makefile" ||
             entry.name == "Makefile" ||
             entry.name == ".mygit" ||
-            entry.name.find(".o") != std::string::npos) {  // Object files
+            entry.name.find(".o") != std::string_view::npos) {  // Object files
             continue;
         }
         
-        std::string full_path;
-        if (path == ".") {
-            full_path = entry.name;
-        } else {
-            full_path = path + "/" + entry.name;
-        }
+        std::string_view full_path = arena.join(path == "." ? std::string_view() : path, entry.name);
+        std::string hash(entry.hash);
         
-        if (entry.type == "tree") {
-            Utils::createDirectory(full_path);
-            restoreTree(entry.hash, full_path);
-        } else {
-            // This is a blob
-            std::string blob_content = readObject(entry.hash);
-            if (!blob_content.empty()) {
-                // Skip header
-                size_t data_start = blob_content.find('\0');
-                if (data_start != std::string::npos) {
-                    std::string file_content = blob_content.substr(data_start + 1);
-                    Utils::writeFile(full_path, file_content);
-                }
+        if (entry.isTree()) {
+            // Subtrees outside a sparse checkout are not even read
+            if (cone.directory(full_path) == SparseCone::OUTSIDE) {
+                continue;
             }
+            Utils::createDirectory(std::string(full_path));
+            if (!restoreTree(hash, full_path, arena)) {
+                return false;
+            }
+        } else if (!checkoutBlob(hash, std::string(full_path))) {
+            return false;
         }
     }
+    return true;
 }
 
-bool MyGit::checkout(const std::string& commit_hash) {
-    std::string commit_content = readObject(commit_hash);
-    if (commit_content.empty()) {
-        UI::printError("Commit not found: " + commit_hash);
-        return false;
+bool MyGit::checkoutBlob(const std::string& hash, const std::string& file_path) {
+    ObjectReader reader(getObjectPath(hash));
+    bool written;
+    if (!reader.readHeader()) {
+        // Not loose, so it comes from a pack
+        std::string object = readObject(hash);
+        size_t null_pos = object.find('\0');
+        if (null_pos == std::string::npos) {
+            fail("Corrupt object " + hash);
+            return false;
+        }
+        written = Utils::writeFile(file_path, std::string_view(object).substr(null_pos + 1));
+    } else if (reader.type() == "manifest") {
+        std::ofstream out(file_path, std::ios::binary);
+        return writeManifestContent(reader.readContent(), out);
+    } else if (reader.isRaw()) {
+        // A view shorter than the header's size means the file was cut off
+        std::string_view content = reader.view();
+        if (reader.failed() || content.size() != reader.size()) {
+            fail("Corrupt object " + hash);
+            return false;
+        }
+        // The kernel copies (or shares) the extents after the header; the
+        // mapping is only read if it cannot
+        written = Utils::copyFileRange(getObjectPath(hash), reader.offset(), content.size(), file_path) ||
+                  Utils::writeFile(file_path, content);
+    } else {
+        std::string file_content = reader.readContent();
+        if (reader.failed()) {
+            fail("Corrupt object " + hash);
+            return false;
+        }
+        written = Utils::writeFile(file_path, file_content);
     }
     
-    // Parse commit to get tree hash
-    size_t data_start = commit_content.find('\0');
-    if (data_start != std::string::npos) {
-        commit_content = commit_content.substr(data_start + 1);
+    if (!written) {
+        fail("Unable to write " + file_path);
     }
-    
-    std::istringstream iss(commit_content);
-    std::string line;
-    std::string tree_hash;
-    
-    while (std::getline(iss, line)) {
-        if (line.substr(0, 5) == "tree ") {
-            tree_hash = line.substr(5);
-            // Remove any trailing whitespace from tree hash
-            tree_hash.erase(tree_hash.find_last_not_of(" \n\r\t") + 1);
-            break;
-        }
+    return written;
+}
+
+bool MyGit::checkout(const std::string& commit_hash) {
+    if (!hasObject(commit_hash)) {
+        fail("Commit not found: " + commit_hash);
+        return false;
     }
     
-    if (tree_hash.empty()) {
-        UI::printError("Invalid commit format: no tree found");
+    // Checking out a commit detaches HEAD from any branch
+    std::string previous_head = readHead();
+    return restoreWorktree(commit_hash) && writeHead(commit_hash, previous_head);
+}
+
+bool MyGit::restoreWorktree(const std::string& commit_hash) {
+    CommitInfo info;
+    if (!readCommit(commit_hash, info)) {
+        fail("Invalid commit format: no tree found");
         return false;
     }
     
+    std::string tree_hash = info.tree_hash;
+    
     // Clear current directory (except .mygit AND important files)
     try {
         for (const auto& entry : fs::directory_iterator(".")) {
@@ -571,188 +1571,95 @@ bool MyGit::checkout(const std::string& commit_hash) {
             fs::remove_all(entry.path());
         }
     } catch (const std::exception& e) {
-        UI::printError("Error clearing directory: " + std::string(e.what()));
+        fail("Error clearing directory: " + std::string(e.what()));
         return false;
     }
     
     // Restore tree
-    restoreTree(tree_hash, ".");
-    
-    // Update HEAD
-    updateHead(commit_hash);
-    
-    UI::printSuccess("HEAD is now at " + commit_hash.substr(0, 7));
-    
-    // Show commit message
-    iss.clear();
-    iss.str(commit_content);
-    std::string message;
-    
-    while (std::getline(iss, line)) {
-        if (line.empty()) {
-            std::getline(iss, message);
-            std::cout << DIM << "Commit message: " << message << RESET << std::endl;
-            break;
-        }
-    }
-    
-    return true;
+    Arena arena;
+    return restoreTree(tree_hash, ".", arena);
 }
 
-// Status command implementation
-bool MyGit::status() {
-    if (!Utils::directoryExists(repo_path)) {
-        UI::printError("Not a MyGit repository (or any of the parent directories)");
-        return false;
-    }
-    
-    std::cout << BOLD << "On branch " << GREEN << "master" << RESET << std::endl;
+std::vector<StatusEntry> MyGit::status() {
+    std::vector<StatusEntry> entries;
+    auto index = readIndex();
     
-    std::string current = getCurrentCommit();
-    if (current.empty()) {
-        std::cout << std::endl;
-        std::cout << "No commits yet" << std::endl;
+    // Paths outside a sparse checkout are neither shown nor looked for
+    const SparseCone& cone = sparseCone();
+    for (auto it = index.begin(); it != index.end();) {
+        it = cone.includesFile(it->first) ? std::next(it) : index.erase(it);
     }
     
-    std::cout << std::endl;
-    
-    // Get file states
-    auto staged = getStagedFiles();
-    auto modified = getModifiedFiles();
-    auto untracked = getUntrackedFiles();
-    
-    if (!staged.empty()) {
-        std::cout << GREEN << "Changes to be committed:" << RESET << std::endl;
-        std::cout << DIM << "  (use \"mygit reset HEAD <file>...\" to unstage)" << RESET << std::endl;
-        std::cout << std::endl;
-        for (const auto& file : staged) {
-            UI::printFileStatus('A', file);
-        }
-        std::cout << std::endl;
-    }
-   
-    if (!modified.empty()) {
-        std::cout << RED << "Changes not staged for commit:" << RESET << std::endl;
-        std::cout << DIM << "  (use \"mygit add <file>...\" to update what will be committed)" << RESET << std::endl;
-        std::cout << std::endl;
-        for (const auto& file : modified) {
-            UI::printFileStatus('M', file);
-        }
-        std::cout << std::endl;
+    for (const auto& file : getStagedFiles(index)) {
+        entries.push_back({'A', file});
     }
-   
-    if (!untracked.empty()) {
-        std::cout << "Untracked files:" << std::endl;
-        std::cout << DIM << "  (use \"mygit add <file>...\" to include in what will be committed)" << RESET << std::endl;
-        std::cout << std::endl;
-        for (const auto& file : untracked) {
-            UI::printFileStatus('?', file);
-        }
-        std::cout << std::endl;
+    for (const auto& file : getModifiedFiles(index)) {
+        entries.push_back({'M', file});
     }
-    
-    if (staged.empty() && modified.empty() && untracked.empty()) {
-        std::cout << "nothing to commit, working tree clean" << std::endl;
+    for (const auto& file : getUntrackedFiles(index)) {
+        entries.push_back({'?', file});
     }
     
-    return true;
+    return entries;
 }
 
-// Show command (like git show)
-bool MyGit::show(const std::string& commit_hash) {
-    std::string commit_content = readObject(commit_hash);
-    if (commit_content.empty()) {
-        UI::printError("Commit not found: " + commit_hash);
-        return false;
-    }
-    
-    // Parse and display commit details
-    size_t data_start = commit_content.find('\0');
-    if (data_start != std::string::npos) {
-        commit_content = commit_content.substr(data_start + 1);
-    }
-    
-    std::cout << BRIGHT_YELLOW << "commit " << commit_hash << RESET << std::endl;
-    
-    std::istringstream iss(commit_content);
-    std::string line;
-    std::string tree_hash;
+std::vector<DiffEntry> MyGit::diff() {
+    std::vector<DiffEntry> entries;
+    auto index = readIndex();
+    const SparseCone& cone = sparseCone();
     
-    while (std::getline(iss, line)) {
-        if (line.empty()) {
-            std::cout << std::endl;
-            std::string message;
-            std::getline(iss, message);
-            std::cout << "    " << message << std::endl;
-            break;
-        } else if (line.substr(0, 5) == "tree ") {
-            tree_hash = line.substr(5);
-            std::cout << DIM << line << RESET << std::endl;
-        } else {
-            std::cout << line << std::endl;
+    for (const auto& pair : index) {
+        if (!cone.includesFile(pair.first)) {
+            continue;
+        }
+        std::string current_hash = Utils::fileExists(pair.first) ? hashObject(pair.first, false) : "";
+        if (current_hash != pair.second) {
+            entries.push_back({pair.first, pair.second, current_hash});
         }
     }
     
-    std::cout << std::endl;
-    UI::printSeparator();
-    std::cout << BOLD << "Files in this commit:" << RESET << std::endl;
-    
-    // Show tree contents
-    lsTree(tree_hash, false);
-    
-    return true;
-}
-
-// Diff command (basic implementation)
-bool MyGit::diff() {
-    UI::printInfo("Showing differences between working directory and staging area...");
-    UI::printSeparator();
-    
-    auto modified = getModifiedFiles();
-    
-    if (modified.empty()) {
-        std::cout << "No changes detected" << std::endl;
-        return true;
-    }
-    
-    for (const auto& file : modified) {
-        std::cout << BOLD << "diff --mygit a/" << file << " b/" << file << RESET << std::endl;
-        std::cout << YELLOW << "--- a/" << file << RESET << std::endl;
-        std::cout << GREEN << "+++ b/" << file << RESET << std::endl;
-        
-        // This is a simplified diff - in real implementation you'd show actual line differences
-        std::cout << CYAN << "@@ file modified @@" << RESET << std::endl;
-        UI::printFileStatus('M', file);
-    }
-    
-    return true;
+    return entries;
 }
 
 // Helper methods
-std::vector<std::string> MyGit::getUntrackedFiles() {
+std::vector<std::string> MyGit::getUntrackedFiles(const std::map<std::string, std::string>& index) {
     std::vector<std::string> untracked;
-    auto index = readIndex();
     
-    try {
-        for (const auto& entry : fs::recursive_directory_iterator(".")) {
-            if (entry.is_regular_file()) {
-                std::string path = entry.path().string();
-                if (path.find(".mygit") == std::string::npos && 
-                    path.find(".o") == std::string::npos &&
-                    path != "./mygit" &&
-                    index.find(path) == index.end()) {
-                    untracked.push_back(path);
-                }
+    // Scanned paths are built in an arena and looked up among the interned
+    // index paths, so only the untracked ones become strings
+    Arena arena;
+    PathPool tracked(arena);
+    for (const auto& pair : index) {
+        tracked.intern(pair.first);
+    }
+    
+    // Nothing below a directory whose path already fails the filter is
+    // reported, so such directories are not descended into; nor are
+    // directories outside a sparse checkout
+    const SparseCone& cone = sparseCone();
+    auto skipped = [](std::string_view path) {
+        return path.find(".mygit") != std::string_view::npos || path.find(".o") != std::string_view::npos;
+    };
+    
+    Trace::Scope scope(Trace::WALK);
+    std::function<void(std::string_view)> walk = [&](std::string_view dir) {
+        Utils::scanDirectory(dir.data(), [&](const Utils::DirectoryEntry& entry) {
+            std::string_view path = arena.join(dir, entry.name);
+            if (skipped(path)) return;
+            if (entry.directory && !entry.symlink) {
+                if (cone.directory(path) != SparseCone::OUTSIDE) walk(path);
+            } else if (entry.regular && path != "./mygit" && !tracked.contains(path)) {
+                untracked.push_back(std::string(path));
             }
-        }
-    } catch (...) {}
+        });
+    };
+    walk(".");
     
     return untracked;
 }
 
-std::vector<std::string> MyGit::getStagedFiles() {
+std::vector<std::string> MyGit::getStagedFiles(const std::map<std::string, std::string>& index) {
     std::vector<std::string> staged;
-    auto index = readIndex();
     
     for (const auto& pair : index) {
         staged.push_back(pair.first);
@@ -761,16 +1668,15 @@ std::vector<std::string> MyGit::getStagedFiles() {
     return staged;
 }
 
-std::vector<std::string> MyGit::getModifiedFiles() {
+std::vector<std::string> MyGit::getModifiedFiles(const std::map<std::string, std::string>& index) {
     std::vector<std::string> modified;
-    auto index = readIndex();
    
     for (const auto& pair : index) {
-        std::string current_hash = hashObject(pair.first, false);
+        std::string current_hash = Utils::fileExists(pair.first) ? hashObject(pair.first, false) : "";
         if (current_hash != pair.second) {
             modified.push_back(pair.first);
         }
     }
    
     return modified;
-}
\ No newline at end of file
+}
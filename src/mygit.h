@@ -4,6 +4,13 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <memory>
+#include <iosfwd>
+#include <string_view>
+#include <cstdint>
+#include <functional>
+#include <mutex>
 
 struct TreeEntry {
     std::string mode;
@@ -15,12 +22,108 @@ struct TreeEntry {
 struct CommitInfo {
     std::string hash;
     std::string tree_hash;
-    std::string parent_hash;
+    std::string parent_hash;            // the first parent
+    std::vector<std::string> parents;   // all of them, more than one for a merge
     std::string message;
     std::string timestamp;
     std::string author;
 };
 
+struct StatusEntry {
+    char state;             // 'A' staged, 'M' modified, '?' untracked
+    std::string path;
+};
+
+struct BranchEntry {
+    std::string name;       // without the refs/heads/ prefix
+    std::string hash;
+};
+
+struct DiffEntry {
+    std::string path;
+    std::string index_hash;
+    std::string worktree_hash;
+};
+
+struct GrepOptions {
+    std::string pattern;        // POSIX extended regular expression
+    bool ignore_case = false;
+    bool cached = false;        // search the index instead of the worktree
+    std::string commit;         // search this commit or tree instead
+};
+
+struct GrepMatch {
+    std::string path;
+    size_t line = 0;            // from 1; 0 for a binary file that matches
+    std::string text;
+};
+
+struct MergeConflict {
+    std::string path;
+    std::string detail;     // "content", "add/add", "mode", "modify/delete", "binary" or "file/directory"
+};
+
+struct MergeResult {
+    std::string commit;     // the merge commit, or where HEAD fast-forwarded to
+    bool up_to_date = false;
+    bool fast_forward = false;
+    std::vector<MergeConflict> conflicts;   // left marked in the worktree
+};
+
+struct RepackStats {
+    size_t objects = 0;         // written to the new pack
+    size_t bitmaps = 0;         // commits with a stored reachability bitmap
+    size_t packs_removed = 0;
+    size_t loose_removed = 0;
+    size_t unpacked = 0;        // unreachable packed objects written out loose
+    size_t dropped = 0;         // unreachable packed objects past the grace period
+    size_t missing = 0;
+    size_t graph_commits = 0;   // commits in the rewritten commit graph
+};
+
+struct GcStats {
+    size_t packed = 0;
+    size_t reachable = 0;       // objects marked from refs, HEAD and the index
+    size_t missing = 0;         // referenced but not present
+    size_t loose = 0;
+    size_t unreachable = 0;     // loose objects nothing refers to, and packed ones dropped
+    size_t pruned = 0;
+    uint64_t bytes_pruned = 0;
+};
+
+struct FsckProblem {
+    std::string hash;       // object, ref or pack the problem was found in
+    std::string detail;
+};
+
+struct FsckReport {
+    size_t checked = 0;
+    std::vector<FsckProblem> corrupt;
+    std::vector<FsckProblem> missing;
+    std::vector<FsckProblem> dangling;     // detail is the object type
+};
+
+// Receives diagnostics from MyGit operations. The default implementation
+// discards them, so embedding the library produces no terminal output.
+class Reporter {
+public:
+    virtual ~Reporter() = default;
+    virtual void error(const std::string&) {}
+    virtual void warning(const std::string&) {}
+    virtual void info(const std::string&) {}
+    virtual void success(const std::string&) {}
+    virtual void progress(const std::string&) {}
+};
+
+class Pack;
+class PackBitmap;
+class CommitGraph;
+class SparseCone;
+class LockFile;
+class Arena;
+class ObjectFormat;
+struct ReachableSet;
+
 class MyGit {
 private:
     std::string repo_path;
@@ -28,41 +131,235 @@ private:
     std::string refs_path;
     std::string index_path;
     std::string head_path;
+    std::string config_path;
+    std::string packs_path;
+    std::string packed_refs_path;
+    std::string merge_head_path;    // the other side of a merge awaiting its commit
+    std::string merge_tree_path;    // and the tree it was merged into
+    std::string sparse_path;
+    
+    std::map<std::string, std::string> config;
+    bool config_loaded;
+    int tree_format;                // core.repositoryFormatVersion, -1 until read
+    int64_t chunk_threshold;        // chunking.threshold, -1 until read
+    int object_format;              // ObjectFormat::Algorithm, -1 until read
+    
+    // Inflated objects kept for the lifetime of this instance
+    std::unordered_map<std::string, std::string> object_cache;
+    size_t object_cache_bytes;
+    std::unordered_map<std::string, std::pair<std::string, size_t>> object_info_cache;
+    
+    // Packfiles under objects/pack, opened on first use
+    std::vector<std::unique_ptr<Pack>> packs;
+    bool packs_loaded;
+    
+    // Reachability bitmaps of at most one pack, the one repack wrote
+    std::unique_ptr<PackBitmap> pack_bitmap;
+    const Pack* bitmap_pack;
+    
+    // objects/info/commit-graph, opened on first use
+    std::unique_ptr<CommitGraph> commit_graph;
+    bool graph_loaded;
+    
+    // info/sparse-checkout while core.sparseCheckout is set, read on first
+    // use; otherwise a cone that covers everything
+    std::unique_ptr<SparseCone> sparse_cone;
+    
+    Reporter* reporter;
+    std::string last_error;
+    std::mutex report_mutex;        // fail() may be called from worker threads
     
     std::string storeObject(const std::string& content, const std::string& type);
+    std::string storeCommit(const std::string& tree_hash, const std::vector<std::string>& parents,
+                            const std::string& message);
     std::string readObject(const std::string& hash);
-    std::string getObjectPath(const std::string& hash);
-    std::vector<TreeEntry> readTree(const std::string& tree_hash);
-    void restoreTree(const std::string& tree_hash, const std::string& path = ".");
-    std::string getCurrentCommit();
-    void updateHead(const std::string& commit_hash);
+    std::string getObjectPath(const std::string& hash) const;
+    bool hasObject(const std::string& hash);
+    void loadPacks();
+    void reloadPacks();
+    bool readPacked(const std::string& hash, std::string& object);
+    
+    // Cache-free read, safe from several threads once loadPacks() has run;
+    // only the type is read when content is null
+    bool peekObject(const std::string& hash, std::string& type, std::string* content) const;
+    std::vector<TreeEntry> parseTree(std::string_view tree_data);
+    int treeFormat();
+    
+    // extensions.objectFormat; loadPacks() reads it, so it is cached before
+    // any parallel work starts
+    ObjectFormat objectFormat();
+    // (label, hash) for every ref, HEAD and each index entry
+    bool reachabilityRoots(std::vector<std::pair<std::string, std::string>>& roots);
+    
+    // Walks commits and then trees, manifests and blobs from the given tips,
+    // the trees in parallel. mark() returns false for objects seen before and
+    // is never called twice at once; covered() may claim a commit (already
+    // seen, or its bitmap merged) so it is not walked.
+    // Returns the number of objects that could not be read.
+    size_t walkReachable(const std::vector<std::string>& commits, const std::vector<std::string>& objects,
+                         const std::function<bool(const std::string&)>& mark,
+                         const std::function<bool(const std::string&)>& covered);
+    
+    // Commits reachable from tips, every parent before its children; a
+    // commit's first parent is walked before its others
+    std::vector<std::string> commitOrder(const std::vector<std::string>& tips);
+    static void commitLinks(const std::string& content, std::string& tree, std::vector<std::string>& parents);
+    const CommitGraph* commitGraph();
+    const SparseCone& sparseCone();
+    
+    // A worktree tree with the directories outside the sparse cone taken
+    // from base, since they are not checked out
+    std::string sparseTree(const std::string& worktree, const std::string& base, const std::string& prefix);
+    bool applySparse(const SparseCone& cone, bool enable);
+    
+    // "<mode> <hash>" of the entry at path below a tree, "" if there is none
+    std::string treeEntry(const std::string& tree_hash, std::string_view path);
+    size_t collectReachable(const std::vector<std::string>& commits, const std::vector<std::string>& objects,
+                            ReachableSet& set);
+    // Entries and paths come from the arena, which the caller keeps for
+    // the whole checkout
+    bool restoreTree(const std::string& tree_hash, std::string_view path, Arena& arena);
+    bool restoreWorktree(const std::string& commit_hash);
+    // Writes a blob to file_path; a corrupt object fails and leaves the
+    // file alone
+    bool checkoutBlob(const std::string& hash, const std::string& file_path);
+    
+    // Takes a worktree that matches from_tree to to_tree, descending only
+    // into subtrees whose hashes differ
+    bool updateWorktree(const std::string& from_tree, const std::string& to_tree, const std::string& path);
+    
+    // Three-way merge of trees ("" for one that is absent), recursing only
+    // where the three hashes disagree. Conflicting files are stored with
+    // markers (or as ours, if they cannot be merged by line) and listed.
+    std::string mergeTrees(const std::string& base, const std::string& ours, const std::string& theirs,
+                           const std::string& prefix, const std::string& theirs_label,
+                           std::vector<MergeConflict>& conflicts);
+    
+    // Ref and HEAD updates only happen if the old value still matches
+    // expected once the lock is held
+    std::string readHead();
+    std::string readMergeHead();        // "" unless a merge is in progress
+    bool writeHead(const std::string& content, const std::string& expected);
+    bool updateRef(const std::string& refname, const std::string& hash, const std::string& expected);
+    bool updateHead(const std::string& commit_hash, const std::string& expected);
     std::map<std::string, std::string> readIndex();
-    void writeIndex(const std::map<std::string, std::string>& index);
-
+    bool writeIndex(const std::map<std::string, std::string>& index, LockFile& lock);
+    
+    // Large-file mode: content-defined chunks plus a manifest object
+    size_t chunkThreshold();
+    std::string storeChunked(const std::string& content, bool write);
+    std::vector<std::pair<std::string, size_t>> parseManifest(const std::string& manifest);
+    bool writeManifestContent(const std::string& manifest, std::ostream& out);
+    
+    void fail(const std::string& message);
+    
 public:
     MyGit();
+    ~MyGit();
+    
+    // Diagnostics go to the reporter; the most recent error is also kept
+    void setReporter(Reporter& r) { reporter = &r; }
+    const std::string& lastError() const { return last_error; }
     
     // Commands
-    bool init();
+    // object_format is "sha1" or "sha256"; an existing repository keeps
+    // the format it was created with
+    bool init(const std::string& object_format = "sha1");
     std::string hashObject(const std::string& filepath, bool write = false);
-    bool catFile(const std::string& flag, const std::string& hash);
+    bool catFile(const std::string& flag, const std::string& hash, std::ostream& out);
+    bool catFileBatch(bool print_content, int in_fd, int out_fd);
     std::string writeTree(const std::string& path = ".");
-    bool lsTree(const std::string& tree_hash, bool name_only = false);
     bool add(const std::vector<std::string>& files);
     std::string commit(const std::string& message = "");
-    bool log();
     bool checkout(const std::string& commit_hash);
     
-    // New enhanced methods
-    bool status();
-    bool show(const std::string& commit_hash);
-    bool diff();
+    // Merges a branch or commit into HEAD. A clean merge is committed with
+    // both parents; otherwise the worktree is left with conflict markers
+    // and the next commit records the merge.
+    bool merge(const std::string& name, MergeResult& result);
+    bool abortMerge();
+    bool fastImport(int in_fd, const std::string& marks_path = "");
+    
+    // Tar (gzipped if asked) of a commit's or tree's files, each path
+    // under prefix, streamed to out without touching the worktree
+    bool archive(const std::string& hash, const std::string& prefix, bool gzip, std::ostream& out);
+    
+    // Branches under refs/heads; HEAD is "ref: refs/heads/<name>" on a
+    // branch and a bare commit hash when detached
+    std::vector<BranchEntry> listBranches();
+    bool createBranch(const std::string& name, const std::string& start = "");
+    bool deleteBranch(const std::string& name);
+    bool switchBranch(const std::string& name, bool create = false);
+    bool packRefs();
+    
+    // Marks everything reachable and counts the unreachable loose objects;
+    // with prune, deletes those at least grace_seconds old
+    bool gc(bool prune, long grace_seconds, GcStats& stats);
+    
+    // Writes every reachable object into one pack with reachability
+    // bitmaps, then drops the old packs and the loose copies of what was
+    // packed. Unreachable packed objects are written out loose, dated like
+    // their pack, unless it is older than unpack_grace seconds (-1: never).
+    bool repack(RepackStats& stats, long unpack_grace = -1);
+    
+    // Records every reachable commit with its generation number and a
+    // Bloom filter of the paths it changed; repack also writes it
+    bool writeCommitGraph(size_t& commits);
+    
+    // Rewrites every tree reachable from a ref into Git's encoding (and so
+    // every commit above it), moves the refs and switches the repository to
+    // format 1; old objects are left for gc --prune
+    bool migrate(size_t& trees, size_t& commits);
+    
+    // Objects reachable from commit but not from exclude (if given)
+    bool countObjects(const std::string& commit, const std::string& exclude, size_t& count);
+    
+    // Rehashes and parses every loose and packed object, then checks that
+    // all links resolve; false only if the check could not run
+    bool fsck(FsckReport& report);
+    
+    // Structured queries; none of these print
+    bool isRepository();
+    
+    // Expands a unique hash prefix of at least 4 digits to the full hash
+    bool resolveHash(const std::string& prefix, std::string& hash);
+    std::string getCurrentCommit();
+    std::string currentBranch();        // "" when HEAD is detached
+    std::string resolveRef(const std::string& refname);
+    bool objectInfo(const std::string& hash, std::string& type, size_t& size);
+    bool readObjectContent(const std::string& hash, std::ostream& out);
+    std::vector<TreeEntry> readTree(const std::string& tree_hash);
+    bool readCommit(const std::string& commit_hash, CommitInfo& info);
+    // Every ancestor, children first and a merge followed by the commits
+    // it brought in; with a path, only the first-parent commits that changed
+    // what is at that path (a file or a whole directory)
+    std::vector<CommitInfo> log(const std::string& start = "", const std::string& path = "");
+    
+    // Best common ancestors of two commits, none for unrelated histories;
+    // generation numbers from the commit graph bound the walk
+    std::vector<std::string> mergeBases(const std::string& one, const std::string& two);
+    std::vector<StatusEntry> status();
+    std::vector<DiffEntry> diff();
+    
+    // Matching lines of the tracked files, in path order. Blobs are read
+    // and searched in parallel, each distinct one only once.
+    bool grep(const GrepOptions& options, std::vector<GrepMatch>& matches);
+    
+    // Cone-mode sparse checkout: only the files of the given directories,
+    // and those directly in the directories above them, are checked out.
+    // The worktree must match HEAD; it is rebuilt for the new cone.
+    bool setSparseCheckout(const std::vector<std::string>& directories);
+    bool disableSparseCheckout();
+    std::vector<std::string> sparseDirectories();   // empty when not sparse
+    
+    // Repository configuration (.mygit/config)
+    std::string getConfig(const std::string& key, const std::string& default_value = "");
+    bool setConfig(const std::string& key, const std::string& value);
     
 private:
-    // Helper methods for enhanced UI
-    std::vector<std::string> getUntrackedFiles();
-    std::vector<std::string> getStagedFiles();
-    std::vector<std::string> getModifiedFiles();
+    std::vector<std::string> getUntrackedFiles(const std::map<std::string, std::string>& index);
+    std::vector<std::string> getStagedFiles(const std::map<std::string, std::string>& index);
+    std::vector<std::string> getModifiedFiles(const std::map<std::string, std::string>& index);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,44 @@
+#include "object_format.h"
+
+bool ObjectFormat::parse(const std::string& name, ObjectFormat& format) {
+    if (name == "sha1") {
+        format = ObjectFormat(SHA1);
+    } else if (name == "sha256") {
+        format = ObjectFormat(SHA256);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ObjectFormat::isHash(std::string_view hex) const {
+    if (hex.size() != hexSize()) return false;
+    for (char c : hex) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+    }
+    return true;
+}
+
+void Hasher::update(const char* data, size_t len) {
+    if (format.algorithm() == ObjectFormat::SHA256) {
+        sha256.update(data, len);
+    } else {
+        sha1.update(data, len);
+    }
+}
+
+std::string Hasher::final() {
+    return format.algorithm() == ObjectFormat::SHA256 ? sha256.final() : sha1.final();
+}
+
+std::string Hasher::object(ObjectFormat format, std::string_view type, std::string_view content) {
+    std::string header(type);
+    header += ' ';
+    header += std::to_string(content.size());
+    header += '\0';
+
+    Hasher hasher(format);
+    hasher.update(header);
+    hasher.update(content);
+    return hasher.final();
+}
@@ -0,0 +1,54 @@
+#ifndef OBJECT_FORMAT_H
+#define OBJECT_FORMAT_H
+
+#include "sha1.h"
+#include "sha256.h"
+#include <string>
+#include <string_view>
+
+// The hash a repository names its objects with, chosen at init and kept in
+// the extensions.objectFormat config key (absent means sha1). Loose object
+// paths, trees, packs, bitmaps and refs all take the hash width from here.
+class ObjectFormat {
+public:
+    enum Algorithm { SHA1, SHA256 };
+
+    ObjectFormat(Algorithm id = SHA1) : id(id) {}
+    Algorithm algorithm() const { return id; }
+
+    // "sha1" or "sha256"
+    static bool parse(const std::string& name, ObjectFormat& format);
+    const char* name() const { return id == SHA256 ? "sha256" : "sha1"; }
+
+    size_t rawSize() const { return id == SHA256 ? 32 : 20; }
+    size_t hexSize() const { return 2 * rawSize(); }
+
+    // hexSize() lowercase hex digits
+    bool isHash(std::string_view hex) const;
+
+    bool operator==(const ObjectFormat& other) const { return id == other.id; }
+    bool operator!=(const ObjectFormat& other) const { return id != other.id; }
+
+private:
+    Algorithm id;
+};
+
+// Incremental hash in a repository's object format, giving hex digits
+class Hasher {
+public:
+    explicit Hasher(ObjectFormat format) : format(format) {}
+
+    void update(const char* data, size_t len);
+    void update(std::string_view data) { update(data.data(), data.size()); }
+    std::string final();
+
+    // Hash of a whole object, "<type> <size>\0" header included
+    static std::string object(ObjectFormat format, std::string_view type, std::string_view content);
+
+private:
+    ObjectFormat format;
+    SHA1 sha1;
+    SHA256 sha256;
+};
+
+#endif
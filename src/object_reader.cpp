@@ -0,0 +1,188 @@
+#include "object_reader.h"
+#include "trace.h"
+#include <cstring>
+#include <algorithm>
+#include <climits>
+
+ObjectReader::ObjectReader(const std::string& path)
+    : map(path), compressed(false), stream_end(false), header_read(false),
+      error(false), object_size(0), consumed(0), raw_pos(0), pending_pos(0) {
+    memset(&zs, 0, sizeof(zs));
+
+    if (!map.isOpen() || map.size() < 2) {
+        error = true;
+        return;
+    }
+
+    // Objects are zlib streams unless compression failed when they were
+    // stored, in which case the raw "type size\0" header comes first.
+    const unsigned char* magic = reinterpret_cast<const unsigned char*>(map.data());
+    compressed = (magic[0] & 0x0f) == Z_DEFLATED && ((magic[0] << 8) | magic[1]) % 31 == 0;
+    if (!compressed) return;
+
+    if (inflateInit(&zs) != Z_OK) {
+        compressed = false;
+        error = true;
+        return;
+    }
+
+    // The whole mapping is the input, so inflate never waits on a read;
+    // fill() hands it over in pieces zlib's 32-bit counts can hold
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(map.data()));
+    zs.avail_in = 0;
+}
+
+ObjectReader::~ObjectReader() {
+    if (compressed) {
+        inflateEnd(&zs);
+    }
+}
+
+size_t ObjectReader::fill(char* buf, size_t len) {
+    if (error || len == 0) return 0;
+
+    if (!compressed) {
+        size_t n = std::min(len, map.size() - raw_pos);
+        memcpy(buf, map.data() + raw_pos, n);
+        raw_pos += n;
+        return n;
+    }
+
+    if (stream_end) return 0;
+
+    len = std::min<size_t>(len, 1u << 30);
+    zs.next_out = reinterpret_cast<Bytef*>(buf);
+    zs.avail_out = len;
+
+    Trace::Scope scope(Trace::INFLATE);
+    int ret;
+    size_t unread;
+    do {
+        unread = map.size() - (reinterpret_cast<const char*>(zs.next_in) - map.data()) - zs.avail_in;
+        if (zs.avail_in == 0 && unread > 0) {
+            zs.avail_in = std::min<size_t>(unread, UINT_MAX);
+            unread -= zs.avail_in;
+        }
+        ret = inflate(&zs, Z_NO_FLUSH);
+    } while (ret == Z_OK && zs.avail_out > 0 && zs.avail_in == 0 && unread > 0);
+    Trace::count(Trace::BYTES_INFLATED, len - zs.avail_out);
+    if (ret == Z_STREAM_END) {
+        stream_end = true;
+    } else if (ret != Z_OK || (zs.avail_in == 0 && zs.avail_out > 0)) {
+        // Corrupt or truncated stream
+        error = true;
+    }
+
+    return len - zs.avail_out;
+}
+
+bool ObjectReader::readHeader() {
+    if (header_read) return true;
+    if (error) return false;
+
+    size_t null_pos = std::string::npos;
+    const char* header = nullptr;
+
+    if (!compressed) {
+        const void* hit = memchr(map.data(), '\0', std::min<size_t>(map.size(), 64));
+        if (hit) {
+            header = map.data();
+            null_pos = static_cast<const char*>(hit) - map.data();
+            raw_pos = null_pos + 1;
+        }
+    } else {
+        // The header is a few dozen bytes at most, so inflate it in small
+        // steps and keep whatever content spills past the null for read().
+        char buf[64];
+        while (null_pos == std::string::npos && pending.size() < 64) {
+            size_t n = fill(buf, sizeof(buf));
+            if (n == 0) break;
+            size_t old_size = pending.size();
+            pending.append(buf, n);
+            const void* hit = memchr(pending.data() + old_size, '\0', n);
+            if (hit) {
+                null_pos = static_cast<const char*>(hit) - pending.data();
+            }
+        }
+        header = pending.data();
+        pending_pos = null_pos + 1;
+    }
+
+    if (null_pos == std::string::npos) {
+        error = true;
+        return false;
+    }
+
+    const char* space = static_cast<const char*>(memchr(header, ' ', null_pos));
+    if (!space) {
+        error = true;
+        return false;
+    }
+
+    object_type.assign(header, space - header);
+    try {
+        object_size = std::stoull(std::string(space + 1, header + null_pos));
+    } catch (...) {
+        error = true;
+        return false;
+    }
+
+    header_read = true;
+    Trace::count(Trace::OBJECTS_READ);
+    return true;
+}
+
+size_t ObjectReader::read(char* buf, size_t len) {
+    if (!readHeader()) return 0;
+
+    len = std::min(len, object_size - consumed);
+    size_t total = 0;
+
+    if (pending_pos < pending.size()) {
+        size_t n = std::min(len, pending.size() - pending_pos);
+        memcpy(buf, pending.data() + pending_pos, n);
+        pending_pos += n;
+        total = n;
+    }
+
+    while (total < len) {
+        size_t n = fill(buf + total, len - total);
+        if (n == 0) break;
+        total += n;
+    }
+
+    consumed += total;
+    if (total < len) {
+        error = true;
+    }
+    return total;
+}
+
+std::string_view ObjectReader::view() {
+    if (compressed || !readHeader() || map.size() - raw_pos < object_size) {
+        return std::string_view();
+    }
+    return std::string_view(map.data() + raw_pos, object_size);
+}
+
+std::string ObjectReader::readContent() {
+    if (!readHeader()) return "";
+
+    std::string content;
+    content.resize(object_size);
+    size_t n = read(&content[0], object_size);
+    content.resize(n);
+    return content;
+}
+
+std::string ObjectReader::readAll() {
+    if (!readHeader()) return "";
+
+    std::string full = object_type + " " + std::to_string(object_size);
+    full += '\0';
+    size_t offset = full.size();
+    full.resize(offset + object_size);
+    size_t n = read(&full[offset], object_size);
+    full.resize(offset + n);
+    return full;
+}
@@ -0,0 +1,56 @@
+#ifndef OBJECT_READER_H
+#define OBJECT_READER_H
+
+#include <string>
+#include <string_view>
+#include <zlib.h>
+#include "mapped_file.h"
+
+// Streaming reader for a single loose object. The "type size\0" header is
+// inflated on its own so callers can stop there, or use the size to pre-size
+// their buffers before pulling the content in chunks. The object file is
+// memory-mapped and inflated directly from the mapping.
+class ObjectReader {
+public:
+    explicit ObjectReader(const std::string& path);
+    ~ObjectReader();
+
+    ObjectReader(const ObjectReader&) = delete;
+    ObjectReader& operator=(const ObjectReader&) = delete;
+
+    bool readHeader();
+    const std::string& type() const { return object_type; }
+    size_t size() const { return object_size; }
+
+    // Reads up to len bytes of content, returns 0 at the end of the object
+    size_t read(char* buf, size_t len);
+    std::string readContent();
+    std::string readAll();
+
+    // Objects stored without compression can be used in place; their
+    // content starts at offset() in the file, just past the header
+    bool isRaw() const { return !compressed; }
+    std::string_view view();
+    size_t offset() const { return raw_pos; }
+
+    bool failed() const { return error; }
+
+private:
+    MappedFile map;
+    z_stream zs;
+    bool compressed;
+    bool stream_end;
+    bool header_read;
+    bool error;
+    std::string object_type;
+    size_t object_size;
+    size_t consumed;
+
+    size_t raw_pos;
+    std::string pending;
+    size_t pending_pos;
+
+    size_t fill(char* buf, size_t len);
+};
+
+#endif
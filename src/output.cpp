@@ -0,0 +1,72 @@
+#include "output.h"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+OutputBuffer::OutputBuffer(int fd, size_t capacity)
+    : fd(fd), buffer(capacity), used(0), error(false) {}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+bool OutputBuffer::writeAll(const char* data, size_t len) {
+    while (len > 0 && !error) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            error = true;
+            break;
+        }
+        data += n;
+        len -= n;
+    }
+    return !error;
+}
+
+void OutputBuffer::write(const char* data, size_t len) {
+    if (used + len <= buffer.size()) {
+        memcpy(buffer.data() + used, data, len);
+        used += len;
+        return;
+    }
+
+    flush();
+    if (len >= buffer.size()) {
+        writeAll(data, len);
+    } else {
+        memcpy(buffer.data(), data, len);
+        used = len;
+    }
+}
+
+void OutputBuffer::put(char c) {
+    if (used == buffer.size()) {
+        flush();
+    }
+    buffer[used++] = c;
+}
+
+bool OutputBuffer::flush() {
+    if (used > 0) {
+        writeAll(buffer.data(), used);
+        used = 0;
+    }
+    return !error;
+}
+
+int OutputStreamBuf::overflow(int c) {
+    if (c != traits_type::eof()) {
+        out.put(static_cast<char>(c));
+    }
+    return out.failed() ? traits_type::eof() : traits_type::not_eof(c);
+}
+
+std::streamsize OutputStreamBuf::xsputn(const char* s, std::streamsize n) {
+    out.write(s, n);
+    return out.failed() ? 0 : n;
+}
+
+int OutputStreamBuf::sync() {
+    return out.flush() ? 0 : -1;
+}
@@ -0,0 +1,50 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <streambuf>
+
+// Block-buffered writer over a file descriptor. Small writes are gathered
+// into one buffer and written with a single syscall when it fills or is
+// flushed; writes larger than the buffer go straight through.
+class OutputBuffer {
+public:
+    explicit OutputBuffer(int fd, size_t capacity = 65536);
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void write(const char* data, size_t len);
+    void write(std::string_view text) { write(text.data(), text.size()); }
+    void put(char c);
+    bool flush();
+
+    bool failed() const { return error; }
+
+private:
+    int fd;
+    std::vector<char> buffer;
+    size_t used;
+    bool error;
+
+    bool writeAll(const char* data, size_t len);
+};
+
+// Lets iostream code write through an OutputBuffer
+class OutputStreamBuf : public std::streambuf {
+public:
+    explicit OutputStreamBuf(OutputBuffer& out) : out(out) {}
+
+protected:
+    int overflow(int c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    int sync() override;
+
+private:
+    OutputBuffer& out;
+};
+
+#endif
@@ -0,0 +1,446 @@
+#include "pack.h"
+#include "trace.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+    const char* const type_names[] = {"", "commit", "tree", "blob", "", "manifest"};
+
+    int typeCode(const std::string& type) {
+        for (int code = 1; code <= 5; code++) {
+            if (type == type_names[code] && *type_names[code]) return code;
+        }
+        return 0;
+    }
+
+    // zlib counts in 32 bits, so buffers over 4 GiB are handed to it a
+    // piece at a time: once it has used up avail, the next piece of left
+    void feed(uInt& avail, size_t& left) {
+        if (avail == 0) {
+            avail = std::min<size_t>(left, UINT_MAX);
+            left -= avail;
+        }
+    }
+
+    uint32_t readBE32(const char* p) {
+        const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+        return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | u[3];
+    }
+
+    void appendBE32(std::string& out, uint32_t value) {
+        char bytes[4] = {char(value >> 24), char(value >> 16), char(value >> 8), char(value)};
+        out.append(bytes, 4);
+    }
+
+    bool writeAll(int fd, const char* data, size_t len) {
+        while (len > 0) {
+            ssize_t n = ::write(fd, data, len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // Fixed-size parts at the start of an idx v2 file
+    const size_t IDX_HEADER = 8;
+    const size_t IDX_FANOUT = 256 * 4;
+}
+
+namespace PackFormat {
+    std::string hexToRaw(const std::string& hex) {
+        if (hex.size() != 40 && hex.size() != 64) return "";
+        std::string raw(hex.size() / 2, '\0');
+        for (size_t i = 0; i < raw.size(); i++) {
+            int value = 0;
+            for (int j = 0; j < 2; j++) {
+                char c = hex[2 * i + j];
+                int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+                if (digit < 0) return "";
+                value = value * 16 + digit;
+            }
+            raw[i] = static_cast<char>(value);
+        }
+        return raw;
+    }
+
+    std::string rawToHex(const std::string& raw) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex;
+        hex.reserve(raw.size() * 2);
+        for (unsigned char c : raw) {
+            hex += digits[c >> 4];
+            hex += digits[c & 15];
+        }
+        return hex;
+    }
+}
+
+Deflater::Deflater() {
+    memset(&zs, 0, sizeof(zs));
+    ready = deflateInit(&zs, Z_DEFAULT_COMPRESSION) == Z_OK;
+}
+
+Deflater::~Deflater() {
+    if (ready) {
+        deflateEnd(&zs);
+    }
+}
+
+std::string Deflater::deflate(const std::string& data) {
+    if (!ready || deflateReset(&zs) != Z_OK) return "";
+
+    Trace::Scope scope(Trace::DEFLATE);
+    Trace::count(Trace::BYTES_DEFLATED, data.size());
+
+    // deflateBound is enough for a single Z_FINISH call
+    std::string compressed(deflateBound(&zs, data.size()), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    size_t in_left = data.size();
+    size_t out_left = compressed.size();
+
+    int ret;
+    do {
+        feed(zs.avail_in, in_left);
+        feed(zs.avail_out, out_left);
+        ret = ::deflate(&zs, in_left == 0 ? Z_FINISH : Z_NO_FLUSH);
+    } while (ret == Z_OK);
+    if (ret != Z_STREAM_END) return "";
+    compressed.resize(zs.total_out);
+    return compressed;
+}
+
+Pack::Pack(const std::string& path, ObjectFormat format)
+    : pack_path(path), format(format), hash_size(format.rawSize()), count(0), opened(false) {
+    std::string idx_path = path.substr(0, path.size() - 5) + ".idx";
+    if (!index.open(idx_path) || !pack.open(path)) return;
+
+    // Header, fanout and the two checksums are the minimum for an empty pack
+    if (index.size() < IDX_HEADER + IDX_FANOUT + 2 * hash_size || pack.size() < 12 + hash_size ||
+        memcmp(index.data(), "\377tOc", 4) != 0 || readBE32(index.data() + 4) != 2 ||
+        memcmp(pack.data(), "PACK", 4) != 0 || readBE32(pack.data() + 4) != 2) {
+        return;
+    }
+
+    count = readBE32(index.data() + IDX_HEADER + 255 * 4);
+    // A name, a CRC and a 32-bit offset per object
+    if (index.size() < IDX_HEADER + IDX_FANOUT + size_t(count) * (hash_size + 8) + 2 * hash_size) return;
+
+    opened = true;
+}
+
+bool Pack::find(const std::string& hash, uint64_t& offset) const {
+    uint32_t pos;
+    return position(hash, pos) && offsetAt(pos, offset);
+}
+
+bool Pack::position(const std::string& hash, uint32_t& pos) const {
+    std::string raw = PackFormat::hexToRaw(hash);
+    if (!opened || raw.size() != hash_size) return false;
+
+    // The fanout gives the range of entries sharing the first byte
+    const char* fanout = index.data() + IDX_HEADER;
+    unsigned char first = raw[0];
+    uint32_t lo = first == 0 ? 0 : readBE32(fanout + (first - 1) * 4);
+    uint32_t hi = readBE32(fanout + first * 4);
+
+    const char* names = fanout + IDX_FANOUT;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(names + size_t(mid) * hash_size, raw.data(), hash_size);
+        if (cmp == 0) {
+            pos = mid;
+            return true;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+std::string Pack::checksum() const {
+    if (!opened) return "";
+    return std::string(pack.data() + pack.size() - hash_size, hash_size);
+}
+
+std::string Pack::hashAt(uint32_t i) const {
+    if (!opened || i >= count) return "";
+    const char* names = index.data() + IDX_HEADER + IDX_FANOUT;
+    return PackFormat::rawToHex(std::string(names + size_t(i) * hash_size, hash_size));
+}
+
+bool Pack::offsetAt(uint32_t i, uint64_t& offset) const {
+    if (!opened || i >= count) return false;
+
+    const char* offsets = index.data() + IDX_HEADER + IDX_FANOUT + size_t(count) * (hash_size + 4);
+    uint32_t small = readBE32(offsets + size_t(i) * 4);
+    if (small & 0x80000000u) {
+        // Offsets past 2 GiB live in a trailing table of 64-bit values
+        const char* large = offsets + size_t(count) * 4 + size_t(small & 0x7fffffffu) * 8;
+        if (large + 8 > index.data() + index.size() - 2 * hash_size) return false;
+        offset = (uint64_t(readBE32(large)) << 32) | readBE32(large + 4);
+    } else {
+        offset = small;
+    }
+    return offset + hash_size < pack.size();
+}
+
+bool Pack::verifyChecksum() const {
+    if (!opened) return false;
+
+    Hasher hasher(format);
+    hasher.update(pack.data(), pack.size() - hash_size);
+    return hasher.final() == PackFormat::rawToHex(checksum());
+}
+
+void Pack::findPrefix(const std::string& prefix, std::vector<std::string>& matches, size_t limit) const {
+    if (!opened || prefix.size() < 2 || prefix.size() > 2 * hash_size) return;
+
+    // Lowest possible name with this prefix: pad an odd digit with zero
+    std::string padded = prefix + std::string(2 * hash_size - prefix.size(), '0');
+    std::string low = PackFormat::hexToRaw(padded);
+    if (low.empty()) return;
+
+    const char* fanout = index.data() + IDX_HEADER;
+    unsigned char first = low[0];
+    uint32_t lo = first == 0 ? 0 : readBE32(fanout + (first - 1) * 4);
+    uint32_t hi = readBE32(fanout + first * 4);
+
+    const char* names = fanout + IDX_FANOUT;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (memcmp(names + size_t(mid) * hash_size, low.data(), hash_size) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // Matches are contiguous from the lower bound
+    uint32_t end = readBE32(fanout + first * 4);
+    for (uint32_t i = lo; i < end && matches.size() < limit; i++) {
+        std::string hex = PackFormat::rawToHex(std::string(names + size_t(i) * hash_size, hash_size));
+        if (hex.compare(0, prefix.size(), prefix) != 0) break;
+        matches.push_back(hex);
+    }
+}
+
+size_t Pack::parseHeader(uint64_t offset, int& type_code, size_t& size) const {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(pack.data());
+    size_t end = pack.size() - hash_size;
+    size_t pos = offset;
+    if (pos >= end) return 0;
+
+    unsigned char c = p[pos++];
+    type_code = (c >> 4) & 7;
+    size = c & 15;
+    int shift = 4;
+    while (c & 0x80) {
+        if (pos >= end || shift > 57) return 0;
+        c = p[pos++];
+        size |= size_t(c & 0x7f) << shift;
+        shift += 7;
+    }
+    return pos;
+}
+
+bool Pack::readHeader(uint64_t offset, std::string& type, size_t& size) const {
+    int type_code = 0;
+    if (!opened || parseHeader(offset, type_code, size) == 0) return false;
+
+    // Delta entries (6 and 7) are never written by PackWriter
+    if (type_code < 1 || type_code > 5 || !*type_names[type_code]) return false;
+    type = type_names[type_code];
+    return true;
+}
+
+bool Pack::read(uint64_t offset, std::string& type, std::string& content) const {
+    size_t size = 0;
+    if (!readHeader(offset, type, size)) return false;
+
+    int type_code = 0;
+    size_t data_pos = parseHeader(offset, type_code, size);
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK) return false;
+
+    Trace::Scope scope(Trace::INFLATE);
+    content.resize(size);
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(pack.data() + data_pos));
+    zs.next_out = reinterpret_cast<Bytef*>(&content[0]);
+    size_t in_left = pack.size() - hash_size - data_pos;
+    size_t out_left = size;
+
+    int ret;
+    do {
+        feed(zs.avail_in, in_left);
+        feed(zs.avail_out, out_left);
+        ret = inflate(&zs, Z_NO_FLUSH);
+    } while (ret == Z_OK);
+    size_t produced = zs.total_out;
+    inflateEnd(&zs);
+
+    Trace::count(Trace::BYTES_INFLATED, produced);
+    Trace::count(Trace::OBJECTS_READ);
+    return ret == Z_STREAM_END && produced == size;
+}
+
+bool Pack::readRaw(uint64_t offset, uint64_t end, std::string& type, size_t& size, std::string& deflated) const {
+    if (!readHeader(offset, type, size) || end > pack.size() - hash_size) return false;
+
+    int type_code = 0;
+    size_t data_pos = parseHeader(offset, type_code, size);
+    if (data_pos >= end) return false;
+    deflated.assign(pack.data() + data_pos, end - data_pos);
+    return true;
+}
+
+PackWriter::PackWriter(const std::string& pack_dir, ObjectFormat format)
+    : dir(pack_dir), format(format), fd(-1), offset(0) {}
+
+PackWriter::~PackWriter() {
+    out.reset();
+    if (fd >= 0) {
+        ::close(fd);
+        unlink(tmp_path.c_str());
+    }
+}
+
+bool PackWriter::open() {
+    // A unique name, so concurrent imports each write their own pack
+    tmp_path = dir + "/tmp_pack_XXXXXX";
+    fd = mkstemp(&tmp_path[0]);
+    if (fd < 0) return false;
+    fchmod(fd, 0444);
+
+    // The object count is patched in by finish()
+    out.reset(new OutputBuffer(fd, 1 << 20));
+    std::string header = "PACK";
+    appendBE32(header, 2);
+    appendBE32(header, 0);
+    out->write(header);
+    offset = header.size();
+    return true;
+}
+
+bool PackWriter::append(const std::string& hash, const std::string& type, size_t size, const std::string& deflated) {
+    int type_code = typeCode(type);
+    std::string raw = PackFormat::hexToRaw(hash);
+    if (!out || type_code == 0 || raw.size() != format.rawSize()) return false;
+
+    // Type and size as a little-endian base-128 varint, 4 size bits first
+    char header[16];
+    size_t len = 0;
+    unsigned char c = (type_code << 4) | (size & 15);
+    size >>= 4;
+    while (size) {
+        header[len++] = c | 0x80;
+        c = size & 0x7f;
+        size >>= 7;
+    }
+    header[len++] = c;
+
+    uint32_t crc = crc32(0, reinterpret_cast<const Bytef*>(header), len);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(deflated.data()), deflated.size());
+
+    out->write(header, len);
+    out->write(deflated);
+    entries.push_back({raw, offset, crc});
+    offset += len + deflated.size();
+    Trace::count(Trace::OBJECTS_WRITTEN);
+    return !out->failed();
+}
+
+std::string PackWriter::finish() {
+    if (!out || !out->flush()) return "";
+
+    std::string count;
+    appendBE32(count, entries.size());
+    if (pwrite(fd, count.data(), 4, 8) != 4) return "";
+
+    std::string checksum;
+    {
+        Trace::Scope scope(Trace::HASH);
+        MappedFile written(tmp_path);
+        if (!written.isOpen()) return "";
+        Hasher hasher(format);
+        hasher.update(written.data(), written.size());
+        checksum = PackFormat::hexToRaw(hasher.final());
+    }
+    if (lseek(fd, 0, SEEK_END) < 0 || !writeAll(fd, checksum.data(), checksum.size()) || fsync(fd) != 0) {
+        return "";
+    }
+
+    out.reset();
+    ::close(fd);
+    fd = -1;
+
+    std::string base = dir + "/pack-" + PackFormat::rawToHex(checksum);
+    if (!writeIndex(base + ".idx", checksum) || rename(tmp_path.c_str(), (base + ".pack").c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        unlink((base + ".idx").c_str());
+        return "";
+    }
+    return base + ".pack";
+}
+
+bool PackWriter::writeIndex(const std::string& path, const std::string& pack_checksum) {
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.raw_hash < b.raw_hash;
+    });
+
+    std::string idx = "\377tOc";
+    appendBE32(idx, 2);
+
+    uint32_t fanout[256] = {0};
+    for (const auto& entry : entries) {
+        fanout[static_cast<unsigned char>(entry.raw_hash[0])]++;
+    }
+    uint32_t running = 0;
+    for (int i = 0; i < 256; i++) {
+        running += fanout[i];
+        appendBE32(idx, running);
+    }
+
+    for (const auto& entry : entries) idx += entry.raw_hash;
+    for (const auto& entry : entries) appendBE32(idx, entry.crc);
+
+    std::string large;
+    for (const auto& entry : entries) {
+        if (entry.offset < 0x80000000u) {
+            appendBE32(idx, entry.offset);
+        } else {
+            appendBE32(idx, 0x80000000u | (large.size() / 8));
+            appendBE32(large, entry.offset >> 32);
+            appendBE32(large, entry.offset & 0xffffffffu);
+        }
+    }
+    idx += large;
+    idx += pack_checksum;
+    Hasher hasher(format);
+    hasher.update(idx);
+    idx += PackFormat::hexToRaw(hasher.final());
+
+    std::string tmp = path + ".tmp";
+    int idx_fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (idx_fd < 0) return false;
+    bool ok = writeAll(idx_fd, idx.data(), idx.size()) && fsync(idx_fd) == 0;
+    ::close(idx_fd);
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,130 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <zlib.h>
+#include "mapped_file.h"
+#include "output.h"
+#include "object_format.h"
+
+// Git-compatible version 2 packfiles with version 2 .idx indexes. Objects are
+// stored whole (no deltas); "manifest" objects use the reserved type code 5.
+// Object names and both checksums use the repository's object format, as
+// Git's SHA-256 repositories do.
+//
+// A pack and its index are both memory-mapped. Lookups go through the idx
+// fanout table to a range of sorted hashes and binary search within it.
+class Pack {
+public:
+    // path is the .pack file; the .idx beside it is opened as well
+    Pack(const std::string& path, ObjectFormat format);
+
+    bool isOpen() const { return opened; }
+    uint32_t objectCount() const { return count; }
+    const std::string& path() const { return pack_path; }
+    size_t size() const { return pack.size(); }
+    size_t hashSize() const { return hash_size; }     // raw bytes
+
+    bool find(const std::string& hash, uint64_t& offset) const;
+
+    // Index position of hash, which is also its bit in a PackBitmap
+    bool position(const std::string& hash, uint32_t& pos) const;
+
+    // Raw checksum trailer that names the pack
+    std::string checksum() const;
+
+    // Entries in index order, i.e. sorted by hash, for 0 <= i < objectCount()
+    std::string hashAt(uint32_t i) const;
+    bool offsetAt(uint32_t i, uint64_t& offset) const;
+
+    // Recomputes the checksum trailer over the whole pack
+    bool verifyChecksum() const;
+
+    // Appends up to limit hashes starting with the hex prefix (at least 2
+    // digits)
+    void findPrefix(const std::string& prefix, std::vector<std::string>& matches, size_t limit) const;
+    bool readHeader(uint64_t offset, std::string& type, size_t& size) const;
+    bool read(uint64_t offset, std::string& type, std::string& content) const;
+
+    // The still-deflated data of the entry at offset, which ends where the
+    // next entry (or the trailer) begins; used to copy objects between packs
+    bool readRaw(uint64_t offset, uint64_t end, std::string& type, size_t& size, std::string& deflated) const;
+
+private:
+    std::string pack_path;
+    ObjectFormat format;
+    size_t hash_size;
+    MappedFile index;
+    MappedFile pack;
+    uint32_t count;
+    bool opened;
+
+    size_t parseHeader(uint64_t offset, int& type_code, size_t& size) const;
+};
+
+// Appends already-deflated objects to a new pack, then writes the trailer
+// and index and moves both into place. Nothing is visible to readers until
+// finish() succeeds. Callers must not append the same hash twice.
+class PackWriter {
+public:
+    PackWriter(const std::string& pack_dir, ObjectFormat format);
+    ~PackWriter();
+
+    PackWriter(const PackWriter&) = delete;
+    PackWriter& operator=(const PackWriter&) = delete;
+
+    bool open();
+    bool append(const std::string& hash, const std::string& type, size_t size, const std::string& deflated);
+
+    // Returns the path of the finished pack, or "" on failure
+    std::string finish();
+
+    size_t objectCount() const { return entries.size(); }
+
+private:
+    struct Entry {
+        std::string raw_hash;
+        uint64_t offset;
+        uint32_t crc;
+    };
+
+    std::string dir;
+    ObjectFormat format;
+    std::string tmp_path;
+    int fd;
+    std::unique_ptr<OutputBuffer> out;
+    uint64_t offset;
+    std::vector<Entry> entries;
+
+    bool writeIndex(const std::string& path, const std::string& pack_checksum);
+};
+
+// Reusable zlib compressor; the stream state is reset between objects
+// instead of being reallocated for every one
+class Deflater {
+public:
+    Deflater();
+    ~Deflater();
+
+    Deflater(const Deflater&) = delete;
+    Deflater& operator=(const Deflater&) = delete;
+
+    // zlib stream of data, valid for empty input too; "" on failure
+    std::string deflate(const std::string& data);
+
+private:
+    z_stream zs;
+    bool ready;
+};
+
+namespace PackFormat {
+    // A SHA-1 or SHA-256 hash in hex to raw bytes and back; "" for
+    // malformed input
+    std::string hexToRaw(const std::string& hex);
+    std::string rawToHex(const std::string& raw);
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "refs.h"
+#include "lockfile.h"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+namespace {
+    // Length of the hash that starts a "<hash> <refname>" line: 40 digits
+    // for SHA-1 repositories, 64 for SHA-256; 0 if the line is malformed
+    size_t hashLength(const char* line, size_t size) {
+        for (size_t length : {40, 64}) {
+            if (size > length + 1 && line[length] == ' ') return length;
+        }
+        return 0;
+    }
+}
+
+PackedRefs::PackedRefs(const std::string& path) : map(path), start(0) {
+    // Skip the header comments
+    const char* data = map.data();
+    size_t size = map.size();
+    while (start < size && data[start] == '#') {
+        const void* newline = memchr(data + start, '\n', size - start);
+        start = newline ? static_cast<const char*>(newline) - data + 1 : size;
+    }
+}
+
+bool PackedRefs::lookup(const std::string& refname, std::string& hash) const {
+    const char* data = map.data();
+    size_t lo = start;
+    size_t hi = map.size();
+
+    // Bisect on byte offsets, backing each probe up to the start of its line
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        while (mid > lo && data[mid - 1] != '\n') mid--;
+
+        const char* line = data + mid;
+        const char* newline = static_cast<const char*>(memchr(line, '\n', map.size() - mid));
+        size_t line_end = newline ? newline - data : map.size();
+
+        size_t length = hashLength(line, line_end - mid);
+        if (length == 0) return false;
+        std::string_view name(line + length + 1, line_end - mid - length - 1);
+
+        int cmp = name.compare(refname);
+        if (cmp == 0) {
+            hash.assign(line, length);
+            return true;
+        }
+        if (cmp < 0) {
+            lo = line_end + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+std::vector<std::pair<std::string, std::string>> PackedRefs::list(const std::string& prefix) const {
+    std::vector<std::pair<std::string, std::string>> refs;
+    const char* data = map.data();
+    size_t pos = start;
+
+    while (pos < map.size()) {
+        const char* newline = static_cast<const char*>(memchr(data + pos, '\n', map.size() - pos));
+        size_t line_end = newline ? newline - data : map.size();
+        size_t length = hashLength(data + pos, line_end - pos);
+        if (length > 0) {
+            std::string name(data + pos + length + 1, line_end - pos - length - 1);
+            if (name.compare(0, prefix.size(), prefix) == 0) {
+                refs.push_back({name, std::string(data + pos, length)});
+            }
+        }
+        pos = line_end + 1;
+    }
+    return refs;
+}
+
+bool PackedRefs::write(LockFile& lock, std::vector<std::pair<std::string, std::string>> refs) {
+    std::sort(refs.begin(), refs.end());
+    std::string content = "# pack-refs with: sorted\n";
+    for (const auto& ref : refs) {
+        content += ref.second + " " + ref.first + "\n";
+    }
+    return lock.commit(content);
+}
+
+namespace Refs {
+    bool isValidBranchName(const std::string& name) {
+        if (name.empty() || name[0] == '-' || name[0] == '/' || name.back() == '/' || name.back() == '.') {
+            return false;
+        }
+        if (name.size() >= 5 && name.compare(name.size() - 5, 5, ".lock") == 0) {
+            return false;
+        }
+        if (name.find("..") != std::string::npos || name.find("//") != std::string::npos ||
+            name.find("/.") != std::string::npos || name[0] == '.') {
+            return false;
+        }
+        for (unsigned char c : name) {
+            if (c <= ' ' || c == 0x7f || strchr("~^:?*[\\", c)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
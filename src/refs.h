@@ -0,0 +1,38 @@
+#ifndef REFS_H
+#define REFS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "mapped_file.h"
+
+class LockFile;
+
+// The packed-refs file: one "<hash> <refname>" line per ref, sorted by name,
+// after optional "#" header lines. It is memory-mapped and searched in place,
+// so resolving a ref costs one binary search however many refs are packed.
+class PackedRefs {
+public:
+    explicit PackedRefs(const std::string& path);
+
+    bool lookup(const std::string& refname, std::string& hash) const;
+
+    // (refname, hash) pairs for every ref starting with prefix, in name order
+    std::vector<std::pair<std::string, std::string>> list(const std::string& prefix = "") const;
+
+    // Commits refs (sorted here) as the new packed-refs through a lock the
+    // caller took before reading the old contents
+    static bool write(LockFile& lock, std::vector<std::pair<std::string, std::string>> refs);
+
+private:
+    MappedFile map;
+    size_t start;
+};
+
+namespace Refs {
+    // Branch names: no "..", "//", control characters, spaces or any of
+    // "~^:?*[\", not starting with "-" or "/", not ending in "/" or ".lock"
+    bool isValidBranchName(const std::string& name);
+}
+
+#endif
@@ -0,0 +1,451 @@
+#include "mygit.h"
+#include "pack.h"
+#include "bitmap.h"
+#include "utils.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // Every tip gets a bitmap, and so does every Nth commit of the history
+    // in between, which bounds the walk needed to answer any query
+    const size_t BITMAP_INTERVAL = 100;
+
+    // Objects read and deflated together before being appended in order
+    const size_t REPACK_BATCH = 1024;
+
+    // Visited set keyed by raw hash, sharded so threads marking
+    // different objects rarely wait on the same lock
+    class ConcurrentHashSet {
+    public:
+        bool insert(const std::string& raw) {
+            Shard& shard = shards[static_cast<unsigned char>(raw[1]) % SHARDS];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            return shard.items.insert(raw).second;
+        }
+
+    private:
+        static const size_t SHARDS = 64;
+        struct Shard {
+            std::mutex mutex;
+            std::unordered_set<std::string> items;
+        };
+        Shard shards[SHARDS];
+    };
+}
+
+void MyGit::commitLinks(const std::string& content, std::string& tree, std::vector<std::string>& parents) {
+    size_t pos = 0;
+    while (pos < content.size() && content[pos] != '\n') {
+        size_t end = content.find('\n', pos);
+        if (end == std::string::npos) end = content.size();
+        if (content.compare(pos, 5, "tree ") == 0) {
+            tree = content.substr(pos + 5, end - pos - 5);
+        } else if (content.compare(pos, 7, "parent ") == 0) {
+            parents.push_back(content.substr(pos + 7, end - pos - 7));
+        }
+        pos = end + 1;
+    }
+}
+
+size_t MyGit::walkReachable(const std::vector<std::string>& commits, const std::vector<std::string>& objects,
+                            const std::function<bool(const std::string&)>& mark,
+                            const std::function<bool(const std::string&)>& covered) {
+    loadPacks();
+    size_t missing = 0;
+    
+    // The commit graph first, so that bitmaps merged along the way already
+    // cover as many trees as possible before any tree is read
+    std::vector<std::string> stack(commits.rbegin(), commits.rend());
+    std::vector<std::string> trees;
+    while (!stack.empty()) {
+        std::string hash = std::move(stack.back());
+        stack.pop_back();
+        if ((covered && covered(hash)) || !mark(hash)) continue;
+        
+        std::string type, content, tree;
+        std::vector<std::string> parents;
+        if (!peekObject(hash, type, &content) || type != "commit") {
+            missing++;
+            continue;
+        }
+        commitLinks(content, tree, parents);
+        trees.push_back(tree);
+        stack.insert(stack.end(), parents.rbegin(), parents.rend());
+    }
+    
+    // Trees are expanded as pool tasks. The sharded set settles which
+    // thread gets an object, so only objects new to the walk reach mark(),
+    // which is serialized and so need not be thread-safe
+    ConcurrentHashSet visited;
+    std::mutex mark_mutex;
+    std::atomic<size_t> unreadable(0);
+    auto visit = [&](const std::string& hash) {
+        std::string raw = PackFormat::hexToRaw(hash);
+        if (raw.size() > 1 && !visited.insert(raw)) return false;
+        std::lock_guard<std::mutex> lock(mark_mutex);
+        return mark(hash);
+    };
+    
+    ThreadPool pool;
+    // Blob entries only have their type read, since one may be the
+    // manifest of a chunked file
+    std::function<void(const std::string&, bool)> expand = [&](const std::string& hash, bool is_tree) {
+        std::string type, content;
+        if (!peekObject(hash, type, is_tree ? &content : nullptr)) {
+            unreadable++;
+            return;
+        }
+        if (type == "blob" || (!is_tree && !peekObject(hash, type, &content))) {
+            return;
+        }
+        
+        if (type == "tree") {
+            for (const auto& entry : parseTree(content)) {
+                if (!visit(entry.hash)) continue;
+                if (entry.type == "tree") {
+                    pool.submit([&expand, hash = entry.hash]() { expand(hash, true); });
+                } else {
+                    expand(entry.hash, false);
+                }
+            }
+        } else if (type == "manifest") {
+            for (const auto& chunk : parseManifest(content)) {
+                visit(chunk.first);
+            }
+        }
+    };
+    for (const auto& tree : trees) {
+        if (visit(tree)) pool.submit([&expand, tree]() { expand(tree, true); });
+    }
+    for (const auto& object : objects) {
+        if (visit(object)) pool.submit([&expand, object]() { expand(object, false); });
+    }
+    pool.wait();
+    missing += unreadable;
+    return missing;
+}
+
+std::vector<std::string> MyGit::commitOrder(const std::vector<std::string>& tips) {
+    std::vector<std::string> order;
+    std::unordered_set<std::string> seen;
+    std::vector<std::pair<std::string, bool>> stack;
+    for (const auto& tip : tips) {
+        stack.push_back({tip, false});
+    }
+    
+    // Depth-first; a commit is emitted when popped for the second time,
+    // after everything pushed above it, i.e. its parents. Parents are
+    // pushed last first, so the first parent's history comes out first.
+    while (!stack.empty()) {
+        auto top = stack.back();
+        stack.pop_back();
+        if (top.second) {
+            order.push_back(top.first);
+            continue;
+        }
+        if (!seen.insert(top.first).second) continue;
+        
+        std::string type, content, tree;
+        std::vector<std::string> parents;
+        if (!peekObject(top.first, type, &content) || type != "commit") continue;
+        commitLinks(content, tree, parents);
+        stack.push_back({top.first, true});
+        for (auto parent = parents.rbegin(); parent != parents.rend(); ++parent) {
+            stack.push_back({*parent, false});
+        }
+    }
+    return order;
+}
+
+size_t MyGit::collectReachable(const std::vector<std::string>& commits, const std::vector<std::string>& objects,
+                               ReachableSet& set) {
+    loadPacks();
+    set.pack = bitmap_pack;
+    set.bits = Bitmap(bitmap_pack ? bitmap_pack->objectCount() : 0);
+    set.others.clear();
+    
+    auto mark = [&](const std::string& hash) {
+        uint32_t pos;
+        if (set.pack && set.pack->position(hash, pos)) {
+            if (set.bits.get(pos)) return false;
+            set.bits.set(pos);
+            return true;
+        }
+        return set.others.insert(hash).second;
+    };
+    auto covered = [&](const std::string& hash) {
+        uint32_t pos;
+        if (!set.pack || !set.pack->position(hash, pos)) return false;
+        if (set.bits.get(pos)) return true;
+        
+        Bitmap stored;
+        if (!pack_bitmap->lookup(hash, stored)) return false;
+        set.bits.orWith(stored);
+        return true;
+    };
+    return walkReachable(commits, objects, mark, covered);
+}
+
+bool MyGit::repack(RepackStats& stats, long unpack_grace) {
+    if (!isRepository()) {
+        fail("Not a MyGit repository");
+        return false;
+    }
+    
+    stats = RepackStats();
+    std::vector<std::pair<std::string, std::string>> roots;
+    if (!reachabilityRoots(roots)) {
+        return false;
+    }
+    std::vector<std::string> tips, staged;
+    for (const auto& root : roots) {
+        (root.first.compare(0, 6, "index:") == 0 ? staged : tips).push_back(root.second);
+    }
+    
+    // Only what is reachable goes into the new pack
+    loadPacks();
+    ReachableSet reachable;
+    stats.missing = collectReachable(tips, staged, reachable);
+    
+    std::vector<std::string> hashes;
+    for (const auto& hash : reachable.others) {
+        if (hasObject(hash)) hashes.push_back(hash);
+    }
+    for (uint32_t i = 0; reachable.pack && i < reachable.pack->objectCount(); i++) {
+        if (reachable.bits.get(i)) hashes.push_back(reachable.pack->hashAt(i));
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    if (hashes.empty() && packs.empty()) {
+        return true;
+    }
+    
+    // Hex order is index order, so a hash's bit is its place in hashes
+    auto position = [&](const std::string& hash, size_t& pos) {
+        auto it = std::lower_bound(hashes.begin(), hashes.end(), hash);
+        pos = it - hashes.begin();
+        return it != hashes.end() && *it == hash;
+    };
+    
+    // Unreachable packed objects become loose objects dated like their
+    // pack, so gc ages them out under the same grace period as any other
+    // loose object; those whose pack is already past it are dropped
+    struct Unpacked {
+        const Pack* pack;
+        uint32_t index;
+        time_t mtime;
+    };
+    std::vector<Unpacked> unpack;
+    time_t now = time(nullptr);
+    for (const auto& pack : packs) {
+        struct stat st;
+        if (stat(pack->path().c_str(), &st) != 0) {
+            st.st_mtime = now;
+        }
+        for (uint32_t i = 0; i < pack->objectCount(); i++) {
+            size_t pos;
+            std::string hash = pack->hashAt(i);
+            if (position(hash, pos) || Utils::fileExists(getObjectPath(hash))) continue;
+            if (unpack_grace >= 0 && now - st.st_mtime >= unpack_grace) {
+                stats.dropped++;
+            } else {
+                unpack.push_back({pack.get(), i, st.st_mtime});
+            }
+        }
+    }
+    
+    std::vector<std::string> order = commitOrder(tips);
+    
+    // Each selected commit's bitmap starts from those of the selected
+    // commits below it, so only the history in between is walked, and
+    // within it only subtrees that are not already set
+    std::unordered_set<std::string> selected(tips.begin(), tips.end());
+    for (size_t i = 0; i < order.size(); i += BITMAP_INTERVAL) {
+        selected.insert(order[i]);
+    }
+    std::vector<std::pair<std::string, Bitmap>> bitmaps;
+    std::unordered_map<std::string, size_t> built;
+    for (const auto& commit : order) {
+        if (!selected.count(commit)) continue;
+        
+        Bitmap bits(hashes.size());
+        auto mark = [&](const std::string& hash) {
+            size_t pos;
+            if (!position(hash, pos) || bits.get(pos)) return false;
+            bits.set(pos);
+            return true;
+        };
+        auto covered = [&](const std::string& hash) {
+            size_t pos;
+            if (position(hash, pos) && bits.get(pos)) return true;
+            auto below = built.find(hash);
+            if (below == built.end()) return false;
+            bits.orWith(bitmaps[below->second].second);
+            return true;
+        };
+        walkReachable({commit}, {}, mark, covered);
+        
+        built[commit] = bitmaps.size();
+        bitmaps.push_back({commit, std::move(bits)});
+    }
+    
+    // Packed objects are copied still deflated; an entry ends where the
+    // next one in its pack starts
+    struct Source {
+        const Pack* pack;
+        uint64_t offset;
+        uint64_t end;
+    };
+    std::unordered_map<std::string, Source> sources;
+    for (const auto& pack : packs) {
+        std::vector<std::pair<uint64_t, uint32_t>> entries;
+        for (uint32_t i = 0; i < pack->objectCount(); i++) {
+            uint64_t offset;
+            if (pack->offsetAt(i, offset)) entries.push_back({offset, i});
+        }
+        std::sort(entries.begin(), entries.end());
+        for (size_t i = 0; i < entries.size(); i++) {
+            uint64_t end = i + 1 < entries.size() ? entries[i + 1].first : pack->size() - pack->hashSize();
+            sources.insert({pack->hashAt(entries[i].second), Source{pack.get(), entries[i].first, end}});
+        }
+    }
+    
+    // Everything else is read and deflated a batch at a time on the pool,
+    // one Deflater per slice, then appended in order
+    Utils::createDirectory(packs_path);
+    PackWriter writer(packs_path, objectFormat());
+    if (!writer.open()) {
+        fail("Cannot create pack in " + packs_path);
+        return false;
+    }
+    {
+        ThreadPool pool;
+        struct Packed {
+            std::string type;
+            size_t size = 0;
+            std::string deflated;
+            bool ok = false;
+        };
+        std::vector<Packed> batch;
+        
+        for (size_t start = 0; start < hashes.size(); start += REPACK_BATCH) {
+            size_t end = std::min(hashes.size(), start + REPACK_BATCH);
+            batch.assign(end - start, Packed());
+            size_t slice = (end - start + pool.size() - 1) / pool.size();
+            
+            for (size_t from = start; from < end; from += slice) {
+                size_t to = std::min(end, from + slice);
+                pool.submit([&, from, to, start]() {
+                    Deflater deflater;
+                    for (size_t i = from; i < to; i++) {
+                        Packed& object = batch[i - start];
+                        auto source = sources.find(hashes[i]);
+                        if (source != sources.end()) {
+                            const Source& from = source->second;
+                            object.ok = from.pack->readRaw(from.offset, from.end, object.type, object.size, object.deflated);
+                            continue;
+                        }
+                        
+                        std::string content;
+                        if (!peekObject(hashes[i], object.type, &content)) continue;
+                        object.size = content.size();
+                        object.deflated = deflater.deflate(content);
+                        object.ok = !object.deflated.empty();
+                    }
+                });
+            }
+            pool.wait();
+            
+            for (size_t i = start; i < end; i++) {
+                Packed& object = batch[i - start];
+                if (!object.ok || !writer.append(hashes[i], object.type, object.size, object.deflated)) {
+                    fail("Unable to pack object " + hashes[i]);
+                    return false;
+                }
+            }
+        }
+    }
+    
+    std::string pack_path = writer.finish();
+    if (pack_path.empty()) {
+        fail("Unable to write pack");
+        return false;
+    }
+    std::string base = pack_path.substr(0, pack_path.size() - 5);
+    Pack written(pack_path, objectFormat());
+    if (!written.isOpen() || !PackBitmap::write(base + ".bitmap", written.checksum(), bitmaps)) {
+        fail("Unable to write bitmap for " + pack_path);
+        return false;
+    }
+    stats.objects = hashes.size();
+    stats.bitmaps = bitmaps.size();
+    
+    for (const auto& object : unpack) {
+        std::string hash = object.pack->hashAt(object.index);
+        uint64_t offset;
+        std::string type, content;
+        if (!object.pack->offsetAt(object.index, offset) || !object.pack->read(offset, type, content)) {
+            fail("Unable to read unreachable object " + hash);
+            return false;
+        }
+        std::string path = getObjectPath(hash);
+        std::string compressed = Utils::compress(type + " " + std::to_string(content.size()) + '\0' + content);
+        Utils::createDirectory(path.substr(0, path.find_last_of('/')));
+        struct timespec times[2] = {{object.mtime, 0}, {object.mtime, 0}};
+        if (compressed.empty() || !Utils::writeFileAtomic(path, compressed) ||
+            utimensat(AT_FDCWD, path.c_str(), times, 0) != 0) {
+            fail("Unable to unpack unreachable object " + hash);
+            return false;
+        }
+        stats.unpacked++;
+    }
+    
+    // The new pack and its index are in place and the rest is loose, so
+    // the old packs and the loose copies of packed objects can go
+    for (const auto& pack : packs) {
+        if (pack->path() == pack_path) continue;
+        std::string old_base = pack->path().substr(0, pack->path().size() - 5);
+        unlink((old_base + ".bitmap").c_str());
+        unlink((old_base + ".idx").c_str());
+        if (unlink(pack->path().c_str()) == 0) {
+            stats.packs_removed++;
+        }
+    }
+    for (const auto& hash : reachable.others) {
+        if (unlink(getObjectPath(hash).c_str()) == 0) {
+            stats.loose_removed++;
+        }
+    }
+    reloadPacks();
+    return writeCommitGraph(stats.graph_commits);
+}
+
+bool MyGit::countObjects(const std::string& commit, const std::string& exclude, size_t& count) {
+    for (const auto& hash : {commit, exclude}) {
+        if (!hash.empty() && !hasObject(hash)) {
+            fail("Object not found: " + hash);
+            return false;
+        }
+    }
+    
+    ReachableSet included;
+    collectReachable({commit}, {}, included);
+    if (!exclude.empty()) {
+        ReachableSet excluded;
+        collectReachable({exclude}, {}, excluded);
+        included.bits.andNot(excluded.bits);
+        for (const auto& hash : excluded.others) {
+            included.others.erase(hash);
+        }
+    }
+    count = included.count();
+    return true;
+}
@@ -2,6 +2,7 @@
 #include <fstream>
 #include <cstring>
 #include <cstdint>
+#include <algorithm>
 
 SHA1::SHA1() {
     reset();
@@ -38,7 +39,7 @@ SHA1::uint32 SHA1::f3(uint32 b, uint32 c, uint32 d) {
     return (b & c) | (d & (b | c));
 }
 
-void SHA1::buffer_to_block(const std::string &buffer, uint32 block[BLOCK_BYTES]) {
+void SHA1::buffer_to_block(const char* buffer, uint32 block[BLOCK_BYTES]) {
     for (size_t i = 0; i < BLOCK_INTS; i++) {
         block[i] = (buffer[4*i+3] & 0xff)
                  | (buffer[4*i+2] & 0xff)<<8
@@ -102,14 +103,29 @@ void SHA1::update(const std::string &s) {
 }
 
 void SHA1::update(const char* data, size_t len) {
-    buffer.append(data, len);
+    uint32 block[BLOCK_BYTES];
+    
+    // Top up a partial block left by the previous call
+    if (!buffer.empty()) {
+        size_t take = std::min(len, BLOCK_BYTES - buffer.size());
+        buffer.append(data, take);
+        data += take;
+        len -= take;
+        if (buffer.size() < BLOCK_BYTES) return;
+        buffer_to_block(buffer.data(), block);
+        transform(block);
+        buffer.clear();
+    }
     
-    while (buffer.size() >= BLOCK_BYTES) {
-        uint32 block[BLOCK_BYTES];
-        buffer_to_block(buffer, block);
+    // Whole blocks are transformed straight from the input
+    while (len >= BLOCK_BYTES) {
+        buffer_to_block(data, block);
         transform(block);
-        buffer.erase(0, BLOCK_BYTES);
+        data += BLOCK_BYTES;
+        len -= BLOCK_BYTES;
     }
+    
+    buffer.assign(data, len);
 }
 
 std::string SHA1::final() {
@@ -122,7 +138,7 @@ std::string SHA1::final() {
     }
 
     uint32 block[BLOCK_BYTES];
-    buffer_to_block(buffer, block);
+    buffer_to_block(buffer.data(), block);
 
     if (orig_size > BLOCK_BYTES - 8) {
         transform(block);
@@ -135,14 +151,16 @@ std::string SHA1::final() {
     block[BLOCK_INTS - 2] = (uint32)(total_bits >> 32);
     transform(block);
 
-    std::ostringstream result;
+    static const char hex_digits[] = "0123456789abcdef";
+    std::string result(DIGEST_INTS * 8, '0');
     for (size_t i = 0; i < DIGEST_INTS; i++) {
-        result << std::hex << std::setfill('0') << std::setw(8);
-        result << digest[i];
+        for (size_t j = 0; j < 8; j++) {
+            result[i * 8 + j] = hex_digits[(digest[i] >> (28 - 4 * j)) & 15];
+        }
     }
 
     reset();
-    return result.str();
+    return result;
 }
 
 std::string SHA1::from_file(const std::string &filename) {
@@ -29,7 +29,7 @@ private:
     
     void reset();
     void transform(uint32 block[BLOCK_BYTES]);
-    static void buffer_to_block(const std::string &buffer, uint32 block[BLOCK_BYTES]);
+    static void buffer_to_block(const char* buffer, uint32 block[BLOCK_BYTES]);
     static uint32 rol(uint32 value, size_t amount);
     static uint32 blk(const uint32 block[BLOCK_BYTES], const size_t i);
     static uint32 f1(uint32 b, uint32 c, uint32 d);
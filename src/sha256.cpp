@@ -0,0 +1,214 @@
+#include "sha256.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_X86 1
+#endif
+
+namespace {
+    const uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    inline uint32_t ror(uint32_t value, int amount) {
+        return (value >> amount) | (value << (32 - amount));
+    }
+
+    void compressScalar(uint32_t state[8], const unsigned char* data, size_t blocks) {
+        for (; blocks > 0; blocks--, data += 64) {
+            uint32_t w[64];
+            for (int i = 0; i < 16; i++) {
+                w[i] = (uint32_t(data[4 * i]) << 24) | (uint32_t(data[4 * i + 1]) << 16) |
+                       (uint32_t(data[4 * i + 2]) << 8) | data[4 * i + 3];
+            }
+            for (int i = 16; i < 64; i++) {
+                uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int i = 0; i < 64; i++) {
+                uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+                uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+        }
+    }
+
+#ifdef SHA256_X86
+    // The state is kept as the ABEF and CDGH halves that sha256rnds2 works
+    // on; each loop iteration runs four rounds and, for the first twelve,
+    // extends the message schedule by the four words needed four groups on
+    __attribute__((target("sha,ssse3,sse4.1")))
+    void compressShaNi(uint32_t state[8], const unsigned char* data, size_t blocks) {
+        const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xb1);
+        __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1b);
+        __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+        __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+        for (; blocks > 0; blocks--, data += 64) {
+            __m128i saved_abef = abef;
+            __m128i saved_cdgh = cdgh;
+
+            __m128i msg[4];
+            for (int i = 0; i < 4; i++) {
+                msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), byte_swap);
+            }
+
+            for (int r = 0; r < 16; r++) {
+                __m128i wk = _mm_add_epi32(msg[r & 3], _mm_loadu_si128(reinterpret_cast<const __m128i*>(K + 4 * r)));
+                cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+                abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0e));
+
+                if (r < 12) {
+                    __m128i next = _mm_sha256msg1_epu32(msg[r & 3], msg[(r + 1) & 3]);
+                    next = _mm_add_epi32(next, _mm_alignr_epi8(msg[(r + 3) & 3], msg[(r + 2) & 3], 4));
+                    msg[r & 3] = _mm_sha256msg2_epu32(next, msg[(r + 3) & 3]);
+                }
+            }
+
+            abef = _mm_add_epi32(abef, saved_abef);
+            cdgh = _mm_add_epi32(cdgh, saved_cdgh);
+        }
+
+        __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+        __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xf0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+    }
+
+    bool hasShaNi() {
+        unsigned a, b, c, d;
+        if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSSE3) || !(c & bit_SSE4_1)) return false;
+        return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_SHA);
+    }
+#endif
+
+    typedef void (*Compress)(uint32_t state[8], const unsigned char* data, size_t blocks);
+
+    struct Kernel {
+        Compress compress;
+        const char* name;
+    };
+
+    Kernel pickKernel() {
+#ifdef SHA256_X86
+        if (hasShaNi()) return {compressShaNi, "sha-ni"};
+#endif
+        return {compressScalar, "scalar"};
+    }
+
+    // Chosen on first use rather than during static initialization, so
+    // hashing from another static initializer is safe too
+    const Kernel& active() {
+        static const Kernel kernel = pickKernel();
+        return kernel;
+    }
+}
+
+SHA256::SHA256() {
+    reset();
+}
+
+void SHA256::reset() {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(state, initial, sizeof(state));
+    buffered = 0;
+    length = 0;
+}
+
+const char* SHA256::kernel() {
+    return active().name;
+}
+
+void SHA256::update(const std::string& s) {
+    update(s.data(), s.size());
+}
+
+void SHA256::update(const char* data, size_t len) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    length += len;
+
+    // Top up a partial block left by the previous call
+    if (buffered > 0) {
+        size_t take = std::min(len, BLOCK_BYTES - buffered);
+        memcpy(buffer + buffered, p, take);
+        buffered += take;
+        p += take;
+        len -= take;
+        if (buffered < BLOCK_BYTES) return;
+        active().compress(state, buffer, 1);
+        buffered = 0;
+    }
+
+    // Whole blocks go to the kernel straight from the input
+    if (len >= BLOCK_BYTES) {
+        active().compress(state, p, len / BLOCK_BYTES);
+        p += len - len % BLOCK_BYTES;
+        len %= BLOCK_BYTES;
+    }
+
+    memcpy(buffer, p, len);
+    buffered = len;
+}
+
+std::string SHA256::final() {
+    uint64_t total_bits = length * 8;
+
+    unsigned char tail[2 * BLOCK_BYTES] = {0};
+    memcpy(tail, buffer, buffered);
+    tail[buffered] = 0x80;
+    size_t tail_size = buffered + 9 > BLOCK_BYTES ? 2 * BLOCK_BYTES : BLOCK_BYTES;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_size - 1 - i] = static_cast<unsigned char>(total_bits >> (8 * i));
+    }
+    active().compress(state, tail, tail_size / BLOCK_BYTES);
+
+    static const char hex_digits[] = "0123456789abcdef";
+    std::string result(64, '0');
+    for (size_t i = 0; i < 8; i++) {
+        for (size_t j = 0; j < 8; j++) {
+            result[i * 8 + j] = hex_digits[(state[i] >> (28 - 4 * j)) & 15];
+        }
+    }
+
+    reset();
+    return result;
+}
+
+std::string sha256(const std::string& string) {
+    SHA256 checksum;
+    checksum.update(string);
+    return checksum.final();
+}
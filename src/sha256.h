@@ -0,0 +1,33 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// SHA-256 with the block function picked once at startup: the SHA
+// extensions (SHA-NI) where the CPU has them, portable C++ otherwise.
+class SHA256 {
+public:
+    SHA256();
+    void update(const std::string& s);
+    void update(const char* data, size_t len);
+    std::string final();
+
+    // "sha-ni" or "scalar"
+    static const char* kernel();
+
+private:
+    static const size_t BLOCK_BYTES = 64;
+
+    uint32_t state[8];
+    unsigned char buffer[BLOCK_BYTES];
+    size_t buffered;
+    uint64_t length;
+
+    void reset();
+};
+
+std::string sha256(const std::string& string);
+
+#endif
@@ -0,0 +1,225 @@
+#include "sparse.h"
+#include "mygit.h"
+#include "tree_format.h"
+#include "utils.h"
+#include <map>
+#include <sstream>
+
+namespace {
+    std::string_view normalize(std::string_view path) {
+        while (path.compare(0, 2, "./") == 0) path.remove_prefix(2);
+        while (!path.empty() && path.back() == '/') path.remove_suffix(1);
+        return path == "." ? std::string_view() : path;
+    }
+}
+
+bool SparseCone::set(const std::vector<std::string>& directories) {
+    std::set<std::string, std::less<>> dirs;
+    for (const auto& directory : directories) {
+        std::string_view dir = normalize(directory);
+        std::string wrapped = "/" + std::string(dir) + "/";
+        if (dir.empty() || dir[0] == '/' || wrapped.find("/../") != std::string::npos ||
+            wrapped.find("/./") != std::string::npos || wrapped.find("//") != std::string::npos) {
+            return false;
+        }
+        dirs.insert(std::string(dir));
+    }
+
+    // A directory inside another adds nothing
+    recursive.clear();
+    parents = {""};
+    for (const auto& dir : dirs) {
+        bool covered = false;
+        for (size_t slash = dir.find('/'); slash != std::string::npos && !covered; slash = dir.find('/', slash + 1)) {
+            covered = dirs.count(dir.substr(0, slash)) > 0;
+        }
+        if (covered) continue;
+
+        recursive.insert(dir);
+        for (size_t slash = dir.find('/'); slash != std::string::npos; slash = dir.find('/', slash + 1)) {
+            parents.insert(dir.substr(0, slash));
+        }
+    }
+    active = true;
+    return true;
+}
+
+bool SparseCone::parse(const std::string& text) {
+    // "/dir/" takes in a directory; "!/dir/*/" right after it takes its
+    // subdirectories back out, leaving it a parent
+    std::set<std::string> included, trimmed;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        line.erase(line.find_last_not_of(" \r\t") + 1);
+        if (line.empty() || line[0] == '#' || line == "/*" || line == "!/*/") {
+            continue;
+        }
+        if (line.size() > 5 && line.compare(0, 2, "!/") == 0 && line.compare(line.size() - 3, 3, "/*/") == 0) {
+            trimmed.insert(line.substr(2, line.size() - 5));
+        } else if (line.size() > 2 && line[0] == '/' && line.back() == '/') {
+            included.insert(line.substr(1, line.size() - 2));
+        } else {
+            return false;
+        }
+    }
+
+    std::vector<std::string> dirs;
+    for (const auto& dir : included) {
+        if (!trimmed.count(dir)) dirs.push_back(dir);
+    }
+    return set(dirs);
+}
+
+std::string SparseCone::patterns() const {
+    std::set<std::string> all(parents.begin(), parents.end());
+    all.insert(recursive.begin(), recursive.end());
+    all.erase("");
+
+    std::string text = "/*\n!/*/\n";
+    for (const auto& dir : all) {
+        text += "/" + dir + "/\n";
+        if (!recursive.count(dir)) {
+            text += "!/" + dir + "/*/\n";
+        }
+    }
+    return text;
+}
+
+SparseCone::Match SparseCone::directory(std::string_view path) const {
+    if (!active) {
+        return RECURSIVE;
+    }
+
+    path = normalize(path);
+    for (size_t slash = path.find('/'); slash != std::string_view::npos; slash = path.find('/', slash + 1)) {
+        if (recursive.count(path.substr(0, slash))) return RECURSIVE;
+    }
+    if (!path.empty() && recursive.count(path)) {
+        return RECURSIVE;
+    }
+    return parents.count(path) ? PARENT : OUTSIDE;
+}
+
+bool SparseCone::includesFile(std::string_view path) const {
+    path = normalize(path);
+    size_t slash = path.rfind('/');
+    return directory(slash == std::string_view::npos ? std::string_view() : path.substr(0, slash)) != OUTSIDE;
+}
+
+const SparseCone& MyGit::sparseCone() {
+    if (!sparse_cone) {
+        sparse_cone.reset(new SparseCone());
+        if (getConfig("core.sparseCheckout") == "true" && !sparse_cone->parse(Utils::readFile(sparse_path))) {
+            reporter->warning("Ignoring " + sparse_path + ": the patterns are not in cone form");
+            *sparse_cone = SparseCone();
+        }
+    }
+    return *sparse_cone;
+}
+
+std::string MyGit::sparseTree(const std::string& worktree, const std::string& base, const std::string& prefix) {
+    if (worktree == base || base.empty()) {
+        return worktree;
+    }
+
+    // (worktree, base) entries by name
+    std::map<std::string, std::pair<const TreeEntry*, const TreeEntry*>> names;
+    std::vector<TreeEntry> present = worktree.empty() ? std::vector<TreeEntry>() : readTree(worktree);
+    std::vector<TreeEntry> kept = readTree(base);
+    for (const auto& entry : present) {
+        names[entry.name].first = &entry;
+    }
+    for (const auto& entry : kept) {
+        names[entry.name].second = &entry;
+    }
+
+    std::vector<TreeEntry> entries;
+    for (const auto& name : names) {
+        const TreeEntry* on_disk = name.second.first;
+        const TreeEntry* in_base = name.second.second;
+        if (!in_base || in_base->type != "tree") {
+            if (on_disk) entries.push_back(*on_disk);
+            continue;
+        }
+
+        // Directories above the cone hold both checked-out files and
+        // subdirectories that are not
+        std::string path = prefix + name.first;
+        SparseCone::Match match = sparseCone().directory(path);
+        if (match == SparseCone::OUTSIDE) {
+            entries.push_back(*in_base);
+        } else if (match == SparseCone::PARENT && (!on_disk || on_disk->type == "tree")) {
+            std::string hash = sparseTree(on_disk ? on_disk->hash : "", in_base->hash, path + "/");
+            if (hash.empty()) return "";
+            if (on_disk || !readTree(hash).empty()) {
+                entries.push_back({in_base->mode, "tree", hash, name.first});
+            }
+        } else if (on_disk) {
+            entries.push_back(*on_disk);
+        }
+    }
+
+    std::string hash = storeObject(TreeFormat::encode(entries, treeFormat()), "tree");
+    if (hash.empty()) {
+        fail("Unable to write tree for " + (prefix.empty() ? std::string(".") : prefix));
+    }
+    return hash;
+}
+
+bool MyGit::applySparse(const SparseCone& cone, bool enable) {
+    if (!isRepository()) {
+        fail("Not a MyGit repository");
+        return false;
+    }
+    if (!readMergeHead().empty()) {
+        fail("A merge is in progress; commit it or run 'mygit merge --abort' first");
+        return false;
+    }
+
+    // Files leaving the cone are deleted, so nothing may be uncommitted
+    std::string head = getCurrentCommit();
+    CommitInfo info;
+    bool born = !head.empty() && readCommit(head, info);
+    if (born) {
+        std::string worktree = writeTree();
+        if (worktree.empty()) {
+            return false;
+        }
+        if (worktree != info.tree_hash) {
+            fail("The worktree has uncommitted changes; commit them before changing the sparse checkout");
+            return false;
+        }
+    }
+
+    if (enable) {
+        Utils::createDirectory(repo_path + "/info");
+        if (!Utils::writeFileAtomic(sparse_path, cone.patterns())) {
+            fail("Unable to write " + sparse_path);
+            return false;
+        }
+    }
+    if (!setConfig("core.sparseCheckout", enable ? "true" : "false")) {
+        return false;
+    }
+    sparse_cone.reset(new SparseCone(cone));
+    return !born || restoreWorktree(head);
+}
+
+bool MyGit::setSparseCheckout(const std::vector<std::string>& directories) {
+    SparseCone cone;
+    if (!cone.set(directories)) {
+        fail("Sparse-checkout directories must be paths inside the worktree");
+        return false;
+    }
+    return applySparse(cone, true);
+}
+
+bool MyGit::disableSparseCheckout() {
+    return applySparse(SparseCone(), false);
+}
+
+std::vector<std::string> MyGit::sparseDirectories() {
+    const auto& directories = sparseCone().directories();
+    return std::vector<std::string>(directories.begin(), directories.end());
+}
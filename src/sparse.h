@@ -0,0 +1,47 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+
+// Cone-mode sparse checkout, in the pattern file Git writes to
+// info/sparse-checkout. The cone is a list of directories: everything
+// below each is checked out, as are the files (but not the subdirectories)
+// of every directory above one, the top level included. Whether a whole
+// directory is in the cone follows from its path alone, so checkout can
+// pass over a subtree without reading it.
+class SparseCone {
+public:
+    enum Match {
+        OUTSIDE,        // nothing below it is checked out
+        PARENT,         // its files are, its subdirectories are matched again
+        RECURSIVE       // all of it is
+    };
+
+    // A cone that covers everything
+    SparseCone() : active(false) {}
+
+    // A leading "./" and trailing "/" are dropped; false if a directory is
+    // the top level itself or leaves the worktree. Patterns that are not in
+    // cone form are refused.
+    bool set(const std::vector<std::string>& directories);
+    bool parse(const std::string& patterns);
+    std::string patterns() const;
+
+    bool isActive() const { return active; }
+    const std::set<std::string, std::less<>>& directories() const { return recursive; }
+
+    // Paths relative to the worktree top, with or without "./"; "" and
+    // "." are the top itself
+    Match directory(std::string_view path) const;
+    bool includesFile(std::string_view path) const;
+
+private:
+    bool active;
+    std::set<std::string, std::less<>> recursive;
+    std::set<std::string, std::less<>> parents;
+};
+
+#endif
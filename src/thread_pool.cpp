@@ -0,0 +1,102 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace {
+    // The pool and worker index of the current thread, if it is a worker
+    thread_local const ThreadPool* current_pool = nullptr;
+    thread_local unsigned current_index = 0;
+}
+
+ThreadPool::ThreadPool(unsigned threads) : queued(0), pending(0), stopping(false) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i <= threads; i++) {
+        queues.emplace_back(new Queue());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back([this, i]() { run(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    Queue& queue = current_pool == this ? *queues[current_index] : *queues.back();
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    queued++;
+    
+    // Taking the lock orders this against a worker checking for work
+    // just before it sleeps
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    work.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return pending == 0; });
+}
+
+unsigned ThreadPool::workerIndex() const {
+    return current_pool == this ? current_index : size();
+}
+
+bool ThreadPool::take(unsigned index, std::function<void()>& task) {
+    // Own deque from the back, then the shared queue and the other
+    // workers' deques from the front
+    size_t count = queues.size();
+    for (size_t n = 0; n < count; n++) {
+        size_t i = n == 0 ? index : n == 1 ? count - 1 : (index + n - 1) % (count - 1);
+        
+        Queue& queue = *queues[i];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (n == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(unsigned index) {
+    current_pool = this;
+    current_index = index;
+    
+    while (true) {
+        std::function<void()> task;
+        if (!take(index, task)) {
+            std::unique_lock<std::mutex> lock(mutex);
+            work.wait(lock, [this]() { return stopping || queued > 0; });
+            if (stopping && queued == 0) return;
+            continue;
+        }
+        
+        task();
+        
+        if (--pending == 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+// Work-stealing pool. Each worker has its own deque: tasks a worker submits
+// go to the back of its deque and it takes them back LIFO, so a recursive
+// traversal stays depth-first and cache-warm on one thread, while idle
+// workers steal from the front of the others' deques, taking the oldest,
+// and usually largest, pieces of work. Tasks submitted from outside the
+// pool go to a shared queue.
+//
+// wait() returns once every submitted task, including those submitted by
+// other tasks, has finished.
+class ThreadPool {
+public:
+    // 0 threads means one per hardware thread
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    void wait();
+
+    unsigned size() const { return workers.size(); }
+
+    // Index of the calling worker, or size() from a thread outside the
+    // pool, for keeping per-thread state such as arenas
+    unsigned workerIndex() const;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;     // one per worker, then the shared one
+    std::atomic<size_t> queued;
+    std::atomic<size_t> pending;
+    std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable idle;
+    bool stopping;
+
+    bool take(unsigned index, std::function<void()>& task);
+    void run(unsigned index);
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Trace {
+    bool enabled = false;
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+
+    namespace {
+        struct Event {
+            Phase phase;
+            int thread;
+            uint64_t start_ns;
+            uint64_t duration_ns;
+        };
+
+        const char* phase_names[PHASE_COUNT] = {
+            "command", "walk", "hash", "deflate", "inflate", "index-read", "index-write"
+        };
+
+        const char* counter_names[COUNTER_COUNT] = {
+            "objects read", "objects written", "objects already stored",
+            "bytes inflated", "bytes deflated", "files stat'd", "cache hits",
+            "commits filtered out", "trees merged", "bytes copied in kernel"
+        };
+
+        std::mutex events_mutex;
+        std::vector<Event> events;
+        uint64_t phase_calls[PHASE_COUNT];
+        uint64_t phase_ns[PHASE_COUNT];
+
+        std::string command_name;
+        std::string json_path;
+        bool json = false;
+        uint64_t origin = 0;
+
+        std::atomic<int> next_thread{0};
+        thread_local int thread_id = -1;
+        thread_local int depth[PHASE_COUNT];
+
+        uint64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void printSummary() {
+            fprintf(stderr, "trace: %s\n", command_name.c_str());
+            fprintf(stderr, "  %-24s %10s %12s\n", "phase", "calls", "total ms");
+            for (int p = 0; p < PHASE_COUNT; p++) {
+                if (phase_calls[p] == 0) continue;
+                fprintf(stderr, "  %-24s %10llu %12.3f\n", phase_names[p],
+                        (unsigned long long)phase_calls[p], phase_ns[p] / 1e6);
+            }
+            fprintf(stderr, "  %-24s %10s\n", "counter", "value");
+            for (int c = 0; c < COUNTER_COUNT; c++) {
+                fprintf(stderr, "  %-24s %10llu\n", counter_names[c],
+                        (unsigned long long)counters[c].load());
+            }
+        }
+
+        // A JSON string body; the command line can hold anything
+        std::string escape(const char* text) {
+            std::string escaped;
+            for (const char* c = text; *c; c++) {
+                if (*c == '"' || *c == '\\') {
+                    escaped += '\\';
+                    escaped += *c;
+                } else if (static_cast<unsigned char>(*c) < 0x20) {
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", *c);
+                    escaped += code;
+                } else {
+                    escaped += *c;
+                }
+            }
+            return escaped;
+        }
+
+        void printJson() {
+            FILE* out = json_path.empty() ? stderr : fopen(json_path.c_str(), "w");
+            if (!out) {
+                fprintf(stderr, "trace: cannot write %s\n", json_path.c_str());
+                return;
+            }
+
+            fprintf(out, "{\"traceEvents\":[\n");
+            for (size_t i = 0; i < events.size(); i++) {
+                const Event& e = events[i];
+                const char* name = e.phase == COMMAND ? command_name.c_str() : phase_names[e.phase];
+                fprintf(out, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                             "\"ts\":%.3f,\"dur\":%.3f},\n",
+                        escape(name).c_str(), escape(phase_names[e.phase]).c_str(), e.thread,
+                        (e.start_ns - origin) / 1e3, e.duration_ns / 1e3);
+            }
+
+            // Counters as one sample at the end of the run
+            fprintf(out, "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{",
+                    (now() - origin) / 1e3);
+            for (int c = 0; c < COUNTER_COUNT; c++) {
+                fprintf(out, "%s\"%s\":%llu", c ? "," : "", escape(counter_names[c]).c_str(),
+                        (unsigned long long)counters[c].load());
+            }
+            fprintf(out, "}}\n]}\n");
+
+            if (out != stderr) fclose(out);
+        }
+
+        void report() {
+            std::lock_guard<std::mutex> lock(events_mutex);
+            if (json) {
+                printJson();
+            } else {
+                printSummary();
+            }
+        }
+    }
+
+    void init(const std::string& spec, const std::string& command) {
+        std::string mode = spec;
+        if (mode.empty()) {
+            const char* env = std::getenv("MYGIT_TRACE");
+            mode = env ? env : "";
+        }
+        if (mode.empty() || mode == "0" || mode == "false") return;
+
+        if (mode == "json") {
+            json = true;
+        } else if (mode != "1" && mode != "true" && mode != "summary") {
+            json = true;
+            json_path = mode;
+        }
+
+        command_name = command;
+        origin = now();
+        enabled = true;
+        std::atexit(report);
+    }
+
+    void Scope::begin() {
+        if (depth[phase]++ == 0) {
+            start = now();
+        }
+    }
+
+    void Scope::end() {
+        uint64_t finish = now();
+        if (--depth[phase] != 0) return;
+
+        if (thread_id < 0) {
+            thread_id = next_thread++;
+        }
+
+        std::lock_guard<std::mutex> lock(events_mutex);
+        phase_calls[phase]++;
+        phase_ns[phase] += finish - start;
+        if (json) {
+            events.push_back({phase, thread_id, start, finish - start});
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+// Per-phase timers and counters, switched on with MYGIT_TRACE or --trace.
+// When tracing is off every hook is a single branch on Trace::enabled.
+//
+//   MYGIT_TRACE=1             summary on stderr at exit
+//   MYGIT_TRACE=json          Chrome trace-event JSON on stderr
+//   MYGIT_TRACE=<file>        Chrome trace-event JSON written to <file>
+namespace Trace {
+    enum Phase {
+        COMMAND,
+        WALK,
+        HASH,
+        DEFLATE,
+        INFLATE,
+        INDEX_READ,
+        INDEX_WRITE,
+        PHASE_COUNT
+    };
+
+    enum Counter {
+        OBJECTS_READ,
+        OBJECTS_WRITTEN,
+        OBJECTS_EXISTING,
+        BYTES_INFLATED,
+        BYTES_DEFLATED,
+        FILES_STATED,
+        CACHE_HITS,
+        FILTER_SKIPS,
+        TREES_MERGED,
+        BYTES_COPIED,
+        COUNTER_COUNT
+    };
+
+    extern bool enabled;
+    extern std::atomic<uint64_t> counters[COUNTER_COUNT];
+
+    // Enables tracing from a spec in the MYGIT_TRACE format; an empty spec
+    // falls back to the environment variable
+    void init(const std::string& spec, const std::string& command);
+
+    inline void count(Counter counter, uint64_t amount = 1) {
+        if (enabled) {
+            counters[counter].fetch_add(amount, std::memory_order_relaxed);
+        }
+    }
+
+    // Times the enclosing block. Nested scopes of the same phase on one
+    // thread (e.g. recursive tree walks) are only timed at the outermost.
+    class Scope {
+    public:
+        explicit Scope(Phase phase) : phase(phase), active(enabled), start(0) {
+            if (active) begin();
+        }
+        ~Scope() {
+            if (active) end();
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Phase phase;
+        bool active;
+        uint64_t start;
+
+        void begin();
+        void end();
+    };
+}
+
+#endif
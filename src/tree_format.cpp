@@ -0,0 +1,163 @@
+#include "tree_format.h"
+#include "arena.h"
+#include "pack.h"
+#include <algorithm>
+
+namespace {
+    bool isDirectory(std::string_view mode) {
+        return mode == "040000" || mode == "40000";
+    }
+
+    bool isHex(std::string_view s) {
+        for (char c : s) {
+            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+        }
+        return true;
+    }
+
+    // Raw bytes of a hex hash; nothing if it is not valid hex
+    void appendRaw(std::string& out, std::string_view hex) {
+        if (hex.size() % 2 != 0 || !isHex(hex)) return;
+        auto value = [](char c) { return c <= '9' ? c - '0' : c - 'a' + 10; };
+        for (size_t i = 0; i < hex.size(); i += 2) {
+            out += static_cast<char>(value(hex[i]) << 4 | value(hex[i + 1]));
+        }
+    }
+
+    // Calls visit(mode, name, hash) for each entry, hash still in the
+    // tree's own encoding; false if the data is not a well-formed tree
+    template <typename Visit>
+    bool parse(std::string_view data, bool raw, size_t raw_size, Visit visit) {
+        size_t hash_size = raw ? raw_size : 2 * raw_size;
+        size_t pos = 0;
+        while (pos < data.size()) {
+            size_t space = data.find(' ', pos);
+            if (space == std::string_view::npos) return false;
+            size_t null_pos = data.find('\0', space);
+            if (null_pos == std::string_view::npos || null_pos + 1 + hash_size > data.size()) return false;
+
+            std::string_view mode = data.substr(pos, space - pos);
+            std::string_view hash = data.substr(null_pos + 1, hash_size);
+            if (mode.empty() || mode.find_first_not_of("01234567") != std::string_view::npos ||
+                null_pos == space + 1 || (!raw && !isHex(hash))) {
+                return false;
+            }
+
+            visit(isDirectory(mode) ? std::string_view("040000") : mode,
+                  data.substr(space + 1, null_pos - space - 1), hash);
+            pos = null_pos + 1 + hash_size;
+        }
+        return true;
+    }
+
+    // A sort key made of two parts and an optional separator, compared like
+    // the concatenated string without building it
+    struct Key {
+        std::string_view first;
+        std::string_view second;
+        char separator;
+        bool separated;
+
+        size_t size() const { return first.size() + separated + second.size(); }
+        unsigned char operator[](size_t i) const {
+            if (i < first.size()) return first[i];
+            if (separated && i == first.size()) return separator;
+            return second[i - first.size() - separated];
+        }
+    };
+
+    bool operator<(const Key& a, const Key& b) {
+        size_t n = std::min(a.size(), b.size());
+        for (size_t i = 0; i < n; i++) {
+            if (a[i] != b[i]) return a[i] < b[i];
+        }
+        return a.size() < b.size();
+    }
+
+    // Format 1 sorts by name with '/' after directory names, format 0 by
+    // "<mode> <name>"
+    Key sortKey(const TreeFormat::EntryRef& entry, int format) {
+        bool directory = isDirectory(entry.mode);
+        if (format == TreeFormat::RAW) {
+            return {entry.name, std::string_view(), '/', directory};
+        }
+        return {directory ? std::string_view("040000") : entry.mode, entry.name, ' ', true};
+    }
+}
+
+namespace TreeFormat {
+    bool isRaw(std::string_view data, size_t raw_size) {
+        return data.size() > raw_size && data[data.size() - raw_size - 1] == '\0';
+    }
+
+    bool decode(std::string_view data, std::vector<TreeEntry>& entries, size_t raw_size) {
+        bool raw = isRaw(data, raw_size);
+        entries.clear();
+        return parse(data, raw, raw_size, [&](std::string_view mode, std::string_view name, std::string_view hash) {
+            TreeEntry entry;
+            entry.mode = std::string(mode);
+            entry.type = isDirectory(mode) ? "tree" : "blob";
+            entry.hash = raw ? PackFormat::rawToHex(std::string(hash)) : std::string(hash);
+            entry.name = std::string(name);
+            entries.push_back(std::move(entry));
+        });
+    }
+
+    bool decode(std::string_view data, std::pmr::vector<EntryRef>& entries, Arena& arena, size_t raw_size) {
+        static const char digits[] = "0123456789abcdef";
+        bool raw = isRaw(data, raw_size);
+        entries.clear();
+        return parse(data, raw, raw_size, [&](std::string_view mode, std::string_view name, std::string_view hash) {
+            if (raw) {
+                char* hex = static_cast<char*>(arena.allocate(hash.size() * 2, 1));
+                for (size_t i = 0; i < hash.size(); i++) {
+                    hex[2 * i] = digits[static_cast<unsigned char>(hash[i]) >> 4];
+                    hex[2 * i + 1] = digits[static_cast<unsigned char>(hash[i]) & 15];
+                }
+                hash = std::string_view(hex, hash.size() * 2);
+            }
+            entries.push_back({mode, name, hash});
+        });
+    }
+
+    std::string encode(const std::vector<TreeEntry>& entries, int format) {
+        std::vector<EntryRef> refs;
+        refs.reserve(entries.size());
+        for (const auto& entry : entries) {
+            refs.push_back({entry.mode, entry.name, entry.hash});
+        }
+        return encode(refs.data(), refs.size(), format);
+    }
+
+    std::string encode(EntryRef* entries, size_t count, int format) {
+        EntryRef* last = std::remove_if(entries, entries + count,
+                                        [](const EntryRef& entry) { return entry.hash.empty(); });
+        std::sort(entries, last, [format](const EntryRef& a, const EntryRef& b) {
+            return sortKey(a, format) < sortKey(b, format);
+        });
+
+        size_t size = 0;
+        for (EntryRef* entry = entries; entry != last; entry++) {
+            size += 6 + 1 + entry->name.size() + 1 + entry->hash.size();
+        }
+        std::string content;
+        content.reserve(size);
+        for (EntryRef* entry = entries; entry != last; entry++) {
+            bool directory = isDirectory(entry->mode);
+            if (format == RAW) {
+                content += directory ? std::string_view("40000") : entry->mode;
+            } else {
+                content += directory ? std::string_view("040000") : entry->mode;
+            }
+            content += ' ';
+            content += entry->name;
+            content += '\0';
+            if (format == RAW) {
+                appendRaw(content, entry->hash);
+            } else {
+                content += entry->hash;
+            }
+        }
+        return content;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef TREE_FORMAT_H
+#define TREE_FORMAT_H
+
+#include "mygit.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+
+class Arena;
+
+// Encodings of tree objects. Repository format 0 writes each entry as
+// "<mode> <name>\0<hex hash>", sorted by "<mode> <name>". Format 1 is Git's
+// encoding: the hash is raw bytes, directories have mode 40000 and entries
+// are sorted by name, a directory's name compared as if followed by '/'.
+//
+// Decoding takes the raw hash size of the repository's object format (20
+// for SHA-1, 32 for SHA-256). A well-formed tree can only parse one way:
+// the last entry's hash is preceded by a NUL exactly raw_size + 1 bytes
+// from the end in format 1, and by hex digits there in format 0.
+namespace TreeFormat {
+    const int HEX = 0;
+    const int RAW = 1;
+
+    // A tree entry that borrows its fields, from the tree object it was
+    // decoded from or from an Arena, instead of owning four strings
+    struct EntryRef {
+        std::string_view mode;
+        std::string_view name;
+        std::string_view hash;      // hex
+
+        bool isTree() const { return mode == "040000" || mode == "40000"; }
+    };
+
+    // Directory entries are reported with mode 040000 and type "tree"
+    // whichever encoding they came from
+    bool decode(std::string_view data, std::vector<TreeEntry>& entries, size_t raw_size);
+    bool isRaw(std::string_view data, size_t raw_size);
+
+    // Views into data, which must outlive the entries; hashes of format 1
+    // trees are converted to hex in the arena
+    bool decode(std::string_view data, std::pmr::vector<EntryRef>& entries, Arena& arena, size_t raw_size);
+
+    // Entries with an empty hash are left out
+    std::string encode(const std::vector<TreeEntry>& entries, int format);
+
+    // Sorts the entries in place
+    std::string encode(EntryRef* entries, size_t count, int format);
+}
+
+#endif
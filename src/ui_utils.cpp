@@ -1,69 +1,115 @@
 #include "ui_utils.h"
+#include "output.h"
 #include <iomanip>
 #include <sstream>
+#include <cstdlib>
+#include <unistd.h>
 
 namespace UI {
+    namespace {
+        bool colors = true;
+        OutputBuffer* stdout_buffer = nullptr;
+        OutputStreamBuf* stdout_streambuf = nullptr;
+        std::streambuf* original_streambuf = nullptr;
+        
+        void restoreOutput() {
+            flushOutput();
+            std::cout.rdbuf(original_streambuf);
+        }
+    }
+    
+    void initOutput() {
+        colors = isatty(STDOUT_FILENO) && !std::getenv("NO_COLOR");
+        
+        if (stdout_buffer) return;
+        
+        // Intentionally never freed: std::cout may still be flushed during
+        // static destruction, after restoreOutput has handed it back
+        stdout_buffer = new OutputBuffer(STDOUT_FILENO, 1 << 18);
+        stdout_streambuf = new OutputStreamBuf(*stdout_buffer);
+        original_streambuf = std::cout.rdbuf(stdout_streambuf);
+        std::atexit(restoreOutput);
+    }
+    
+    void flushOutput() {
+        std::cout.flush();
+    }
+    
+    void setColors(bool enabled) {
+        colors = enabled;
+    }
+    
+    bool colorsEnabled() {
+        return colors;
+    }
+    
+    const char* color(const char* code) {
+        return colors ? code : "";
+    }
+    
     void printHeader() {
-        std::cout << std::endl;
-        std::cout << BRIGHT_CYAN << "  __  __        ____ _ _   " << RESET << std::endl;
-        std::cout << BRIGHT_CYAN << " |  \\/  |_   _ / ___(_) |_ " << RESET << std::endl;
-        std::cout << BRIGHT_CYAN << " | |\\/| | | | | |  _| | __|" << RESET << std::endl;
-        std::cout << BRIGHT_CYAN << " | |  | | |_| | |_| | | |_ " << RESET << std::endl;
-        std::cout << BRIGHT_CYAN << " |_|  |_|\\__, |\\____|_|\\__|" << RESET << std::endl;
-        std::cout << BRIGHT_CYAN << "         |___/              " << RESET << std::endl;
-        std::cout << DIM << "         Mini Git - Version Control System" << RESET << std::endl;
-        std::cout << std::endl;
+        std::cout << "\n";
+        std::cout << BRIGHT_CYAN << "  __  __        ____ _ _   " << RESET << "\n";
+        std::cout << BRIGHT_CYAN << " |  \\/  |_   _ / ___(_) |_ " << RESET << "\n";
+        std::cout << BRIGHT_CYAN << " | |\\/| | | | | |  _| | __|" << RESET << "\n";
+        std::cout << BRIGHT_CYAN << " | |  | | |_| | |_| | | |_ " << RESET << "\n";
+        std::cout << BRIGHT_CYAN << " |_|  |_|\\__, |\\____|_|\\__|" << RESET << "\n";
+        std::cout << BRIGHT_CYAN << "         |___/              " << RESET << "\n";
+        std::cout << DIM << "         Mini Git - Version Control System" << RESET << "\n";
+        std::cout << "\n";
     }
     
     void printSuccess(const std::string& message) {
-        std::cout << GREEN << CHECKMARK << " " << message << RESET << std::endl;
+        std::cout << GREEN << CHECKMARK << " " << message << RESET << "\n";
     }
     
     void printError(const std::string& message) {
-        std::cerr << RED << CROSS << " Error: " << message << RESET << std::endl;
+        // Keep errors ordered after any output still sitting in the buffer
+        flushOutput();
+        std::cerr << RED << CROSS << " Error: " << message << RESET << "\n";
     }
     
     void printWarning(const std::string& message) {
-        std::cout << YELLOW << "⚠ Warning: " << message << RESET << std::endl;
+        std::cout << YELLOW << "⚠ Warning: " << message << RESET << "\n";
     }
     
     void printInfo(const std::string& message) {
-        std::cout << BLUE << "ℹ " << message << RESET << std::endl;
+        std::cout << BLUE << "ℹ " << message << RESET << "\n";
     }
     
     void printProgress(const std::string& message) {
-        std::cout << MAGENTA << "◆ " << message << RESET << std::endl;
+        std::cout << MAGENTA << "◆ " << message << RESET << "\n";
     }
     
     void printSeparator() {
-        std::cout << DIM << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << RESET << std::endl;
+        std::cout << DIM << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << RESET << "\n";
     }
     
     void printCommitGraph(const std::string& hash, const std::string& message, bool hasParent) {
         if (hasParent) {
-            std::cout << YELLOW << "│" << RESET << std::endl;
+            std::cout << YELLOW << "│" << RESET << "\n";
         }
         std::cout << YELLOW << DOT << " " << BRIGHT_YELLOW << "commit " << hash.substr(0, 7) << RESET;
-        std::cout << " " << DIM << "(" << hash << ")" << RESET << std::endl;
-        std::cout << YELLOW << "│" << RESET << " " << message << std::endl;
+        std::cout << " " << DIM << "(" << hash << ")" << RESET << "\n";
+        std::cout << YELLOW << "│" << RESET << " " << message << "\n";
     }
     
     void printFileStatus(char status, const std::string& filename) {
         switch(status) {
             case 'A':
-                std::cout << GREEN << "  A " << RESET << filename << std::endl;
+                std::cout << GREEN << "  A " << RESET << filename << "\n";
                 break;
             case 'M':
-                std::cout << YELLOW << "  M " << RESET << filename << std::endl;
+                std::cout << YELLOW << "  M " << RESET << filename << "\n";
                 break;
             case 'D':
-                std::cout << RED << "  D " << RESET << filename << std::endl;
+                std::cout << RED << "  D " << RESET << filename << "\n";
                 break;
             case '?':
-                std::cout << BRIGHT_BLACK << "  ? " << RESET << filename << std::endl;
+                std::cout << BRIGHT_BLACK << "  ? " << RESET << filename << "\n";
                 break;
             default:
-                std::cout << "    " << filename << std::endl;
+                std::cout << "    " << filename << "\n";
         }
     }
     
@@ -74,6 +120,6 @@ namespace UI {
             std::cout << "📄 ";
         }
         std::cout << std::left << std::setw(20) << name;
-        std::cout << DIM << " [" << mode << "] " << hash.substr(0, 8) << "..." << RESET << std::endl;
+        std::cout << DIM << " [" << mode << "] " << hash.substr(0, 8) << "..." << RESET << "\n";
     }
 }
\ No newline at end of file
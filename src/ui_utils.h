@@ -4,37 +4,37 @@
 #include <string>
 #include <iostream>
 
-// ANSI Color Codes
-#define RESET   "\033[0m"
-#define BOLD    "\033[1m"
-#define DIM     "\033[2m"
-#define UNDERLINE "\033[4m"
+// ANSI Color Codes (empty strings when colors are disabled)
+#define RESET   UI::color("\033[0m")
+#define BOLD    UI::color("\033[1m")
+#define DIM     UI::color("\033[2m")
+#define UNDERLINE UI::color("\033[4m")
 
 // Regular Colors
-#define BLACK   "\033[30m"
-#define RED     "\033[31m"
-#define GREEN   "\033[32m"
-#define YELLOW  "\033[33m"
-#define BLUE    "\033[34m"
-#define MAGENTA "\033[35m"
-#define CYAN    "\033[36m"
-#define WHITE   "\033[37m"
+#define BLACK   UI::color("\033[30m")
+#define RED     UI::color("\033[31m")
+#define GREEN   UI::color("\033[32m")
+#define YELLOW  UI::color("\033[33m")
+#define BLUE    UI::color("\033[34m")
+#define MAGENTA UI::color("\033[35m")
+#define CYAN    UI::color("\033[36m")
+#define WHITE   UI::color("\033[37m")
 
 // Bright Colors
-#define BRIGHT_BLACK   "\033[90m"
-#define BRIGHT_RED     "\033[91m"
-#define BRIGHT_GREEN   "\033[92m"
-#define BRIGHT_YELLOW  "\033[93m"
-#define BRIGHT_BLUE    "\033[94m"
-#define BRIGHT_MAGENTA "\033[95m"
-#define BRIGHT_CYAN    "\033[96m"
-#define BRIGHT_WHITE   "\033[97m"
+#define BRIGHT_BLACK   UI::color("\033[90m")
+#define BRIGHT_RED     UI::color("\033[91m")
+#define BRIGHT_GREEN   UI::color("\033[92m")
+#define BRIGHT_YELLOW  UI::color("\033[93m")
+#define BRIGHT_BLUE    UI::color("\033[94m")
+#define BRIGHT_MAGENTA UI::color("\033[95m")
+#define BRIGHT_CYAN    UI::color("\033[96m")
+#define BRIGHT_WHITE   UI::color("\033[97m")
 
 // Background Colors
-#define BG_RED     "\033[41m"
-#define BG_GREEN   "\033[42m"
-#define BG_YELLOW  "\033[43m"
-#define BG_BLUE    "\033[44m"
+#define BG_RED     UI::color("\033[41m")
+#define BG_GREEN   UI::color("\033[42m")
+#define BG_YELLOW  UI::color("\033[43m")
+#define BG_BLUE    UI::color("\033[44m")
 
 // Unicode symbols
 #define CHECKMARK "✓"
@@ -45,6 +45,14 @@
 #define STAR "★"
 
 namespace UI {
+    // Routes std::cout through one large block-buffered sink and turns
+    // colors off when stdout is not a terminal or NO_COLOR is set
+    void initOutput();
+    void flushOutput();
+    void setColors(bool enabled);
+    bool colorsEnabled();
+    const char* color(const char* code);
+    
     void printHeader();
     void printSuccess(const std::string& message);
     void printError(const std::string& message);
@@ -1,20 +1,32 @@
 #include "utils.h"
+#include "trace.h"
 #include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <zlib.h>
 #include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
 
 namespace fs = std::filesystem;
 
 namespace Utils {
+    // One stat() each, rather than the two that exists() + is_*() cost
     bool fileExists(const std::string& path) {
-        return fs::exists(path) && fs::is_regular_file(path);
+        Trace::count(Trace::FILES_STATED);
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
     }
     
     bool directoryExists(const std::string& path) {
-        return fs::exists(path) && fs::is_directory(path);
+        Trace::count(Trace::FILES_STATED);
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
     }
     
     bool createDirectory(const std::string& path) {
@@ -26,21 +38,95 @@ namespace Utils {
     }
     
     std::string readFile(const std::string& path) {
-        std::ifstream file(path, std::ios::binary);
-        if (!file) return "";
+        // Size the buffer from fstat and read in bulk rather than iterating
+        // the stream one character at a time
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return "";
         
-        return std::string((std::istreambuf_iterator<char>(file)),
-                          std::istreambuf_iterator<char>());
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return "";
+        }
+        
+        std::string content;
+        content.resize(st.st_size);
+        size_t total = 0;
+        while (total < content.size()) {
+            ssize_t n = read(fd, &content[total], content.size() - total);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            total += n;
+        }
+        close(fd);
+        
+        content.resize(total);
+        return content;
     }
     
-    bool writeFile(const std::string& path, const std::string& content) {
+    bool writeFile(const std::string& path, std::string_view content) {
         std::ofstream file(path, std::ios::binary);
         if (!file) return false;
         
-        file << content;
+        file.write(content.data(), content.size());
         return true;
     }
     
+    bool writeFileAtomic(const std::string& path, std::string_view content) {
+        // A private temporary in the same directory renamed into place, so
+        // readers never see a partial file and concurrent writers of the
+        // same path cannot interleave
+        std::string tmp = path.substr(0, path.find_last_of('/') + 1) + "tmp_XXXXXX";
+        int fd = mkstemp(&tmp[0]);
+        if (fd < 0) return false;
+        
+        const char* data = content.data();
+        size_t len = content.size();
+        bool ok = fchmod(fd, 0444) == 0;
+        while (ok && len > 0) {
+            ssize_t n = write(fd, data, len);
+            if (n < 0 && errno == EINTR) continue;
+            ok = n > 0;
+            if (ok) {
+                data += n;
+                len -= n;
+            }
+        }
+        
+        ok = close(fd) == 0 && ok && rename(tmp.c_str(), path.c_str()) == 0;
+        if (!ok) {
+            unlink(tmp.c_str());
+        }
+        return ok;
+    }
+    
+    bool copyFileRange(const std::string& source, uint64_t offset, uint64_t size, const std::string& path) {
+        int in = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0) return false;
+        int out = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (out < 0) {
+            close(in);
+            return false;
+        }
+        
+        // Short copies are normal; a source that ends early is not
+        loff_t from = offset;
+        uint64_t left = size;
+        bool ok = true;
+        while (ok && left > 0) {
+            ssize_t n = copy_file_range(in, &from, out, nullptr, left, 0);
+            if (n < 0 && errno == EINTR) continue;
+            ok = n > 0;
+            if (ok) left -= n;
+        }
+        ok = close(out) == 0 && ok;
+        close(in);
+        if (ok) {
+            Trace::count(Trace::BYTES_COPIED, size);
+        }
+        return ok;
+    }
+    
     std::vector<std::string> listDirectory(const std::string& path) {
         std::vector<std::string> files;
         try {
@@ -51,6 +137,32 @@ namespace Utils {
         return files;
     }
     
+    bool scanDirectory(const char* path, const std::function<void(const DirectoryEntry&)>& visit) {
+        DIR* dir = opendir(path);
+        if (!dir) return false;
+        
+        while (struct dirent* entry = readdir(dir)) {
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+            Trace::count(Trace::FILES_STATED);
+            
+            DirectoryEntry found = {name, entry->d_type == DT_DIR, entry->d_type == DT_REG, entry->d_type == DT_LNK};
+            if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+                struct stat st;
+                if (entry->d_type == DT_UNKNOWN && fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+                    found.symlink = S_ISLNK(st.st_mode);
+                }
+                if (fstatat(dirfd(dir), name, &st, 0) == 0) {
+                    found.directory = S_ISDIR(st.st_mode);
+                    found.regular = S_ISREG(st.st_mode);
+                }
+            }
+            visit(found);
+        }
+        closedir(dir);
+        return true;
+    }
+    
     std::string getCurrentTimestamp() {
         auto now = std::time(nullptr);
         auto tm = *std::localtime(&now);
@@ -62,6 +174,9 @@ namespace Utils {
     std::string compress(const std::string& data) {
         if (data.empty()) return "";
         
+        Trace::Scope scope(Trace::DEFLATE);
+        Trace::count(Trace::BYTES_DEFLATED, data.size());
+        
         z_stream zs;
         memset(&zs, 0, sizeof(zs));
         
@@ -96,9 +211,11 @@ namespace Utils {
         return compressed;
     }
     
-    std::string decompress(const std::string& data) {
+    std::string decompress(const std::string& data, size_t size_hint) {
         if (data.empty()) return "";
         
+        Trace::Scope scope(Trace::INFLATE);
+        
         z_stream zs;
         memset(&zs, 0, sizeof(zs));
         
@@ -109,23 +226,26 @@ namespace Utils {
         zs.next_in = (Bytef*)data.data();
         zs.avail_in = data.size();
         
-        int ret;
-        char outbuffer[32768];
+        // Inflate straight into the result, sized from the hint when the
+        // caller knows the final length and grown geometrically otherwise.
         std::string decompressed;
+        decompressed.resize(size_hint > 0 ? size_hint : std::max<size_t>(data.size() * 2, 32768));
+        
+        int ret;
         
         do {
-            zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-            zs.avail_out = sizeof(outbuffer);
-            
-            ret = inflate(&zs, Z_NO_FLUSH);
-            
-            if (decompressed.size() < zs.total_out) {
-                decompressed.append(outbuffer, zs.total_out - decompressed.size());
+            if (zs.total_out == decompressed.size()) {
+                decompressed.resize(decompressed.size() * 2);
             }
             
-            if (ret == Z_STREAM_END) break;
+            zs.next_out = reinterpret_cast<Bytef*>(&decompressed[zs.total_out]);
+            zs.avail_out = decompressed.size() - zs.total_out;
+            
+            ret = inflate(&zs, Z_NO_FLUSH);
         } while (ret == Z_OK);
         
+        decompressed.resize(zs.total_out);
+        Trace::count(Trace::BYTES_INFLATED, zs.total_out);
         inflateEnd(&zs);
         
         if (ret != Z_STREAM_END) {
@@ -2,19 +2,42 @@
 #define UTILS_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <ctime>
+#include <functional>
+#include <cstdint>
 
 namespace Utils {
+    struct DirectoryEntry {
+        const char* name;
+        bool directory;     // directory and regular follow symlinks
+        bool regular;
+        bool symlink;
+    };
+    
     bool fileExists(const std::string& path);
     bool directoryExists(const std::string& path);
     bool createDirectory(const std::string& path);
     std::string readFile(const std::string& path);
-    bool writeFile(const std::string& path, const std::string& content);
+    bool writeFile(const std::string& path, std::string_view content);
+    bool writeFileAtomic(const std::string& path, std::string_view content);
+    
+    // Writes size bytes of source, from offset on, to path with
+    // copy_file_range, so the data never enters this process and the
+    // filesystem may share extents instead of copying. False, with path
+    // left to the caller, if the kernel or filesystem cannot do it.
+    bool copyFileRange(const std::string& source, uint64_t offset, uint64_t size, const std::string& path);
     std::vector<std::string> listDirectory(const std::string& path);
+    
+    // Every entry but "." and "..", without building a path for each; only
+    // symlinks and entries of unknown type cost a stat(). False if the
+    // directory cannot be opened (errno says why).
+    bool scanDirectory(const char* path, const std::function<void(const DirectoryEntry&)>& visit);
+    
     std::string getCurrentTimestamp();
     std::string compress(const std::string& data);
-    std::string decompress(const std::string& data);
+    std::string decompress(const std::string& data, size_t size_hint = 0);
     std::string joinPath(const std::string& path1, const std::string& path2);
 }
 
@@ -51,7 +51,7 @@ create_test_files() {
 
 cleanup() {
     echo -e "\n${YELLOW}🧹 Cleaning up test files...${NC}"
-    rm -rf .mygit test*.txt testdir deep output.txt commit_hash.txt tree_hash.txt binary_test.txt empty_test.txt special_chars.txt large_test.txt newdir perf_test_*.txt
+    rm -rf .mygit test*.txt testdir deep output.txt commit_hash.txt tree_hash.txt binary_test.txt empty_test.txt special_chars.txt large_test.txt porcelain_test.txt import_test fsck_test migrate_test nested_test sha256_test history_test grep_test archive_test merge_test sparse_test raw_test trace_test.json newdir perf_test_*.txt
     echo "Cleanup completed."
 }
 
@@ -86,6 +86,12 @@ echo -e "\n${YELLOW}📋 Step 4: Object Inspection Tests${NC}"
 run_test "Cat-file print content" "./mygit cat-file -p $HASH1"
 run_test "Cat-file show size" "./mygit cat-file -s $HASH1"
 run_test "Cat-file show type" "./mygit cat-file -t $HASH1"
+run_test "Cat-file with abbreviated hash" "[ \"\$(./mygit cat-file -t ${HASH1:0:7})\" = blob ]"
+run_test "Cat-file rejects too-short hash" "./mygit cat-file -t ${HASH1:0:3}" 1
+run_test "Cat-file batch check" "[ \"\$(printf '%s\\n%s\\n' $HASH1 $HASH2 | ./mygit cat-file --batch-check | wc -l)\" = 2 ]"
+run_test "Cat-file batch reports missing" "printf 'invalidhash123\\n' | ./mygit cat-file --batch | grep -q 'invalidhash123 missing'"
+run_test "Cat-file batch prints content" "[ \"\$(printf '%s\\n' $HASH1 | ./mygit cat-file --batch | sed -n 2p)\" = \"\$(./mygit cat-file -p $HASH1)\" ]"
+run_test "Cat-file batch answers before input ends" "timeout 2 sh -c \"{ printf '%s\\n' $HASH1; sleep 5; } | ./mygit cat-file --batch-check\" | grep -q ' blob '"
 
 echo -e "\n${YELLOW}📋 Step 5: Tree Operations${NC}"
 run_test "Write tree" "./mygit write-tree"
@@ -95,6 +101,24 @@ echo "Tree hash: $TREE_HASH"
 
 run_test "List tree contents" "./mygit ls-tree $TREE_HASH"
 run_test "List tree names only" "./mygit ls-tree --name-only $TREE_HASH"
+run_test "List tree porcelain" "./mygit ls-tree --porcelain $TREE_HASH | grep -qP '^100644 blob [a-f0-9]{40}\ttest1.txt$'"
+run_test "Cat-file lists tree entries" "./mygit cat-file -p $TREE_HASH | grep -qP '^100644 blob [a-f0-9]{40}\ttest1.txt$'"
+run_test "List tree NUL-terminated" "./mygit ls-tree --name-only -z $TREE_HASH | od -c | grep -q '\\\\0'"
+
+mkdir -p nested_test/a/deep nested_test/b
+for i in 1 2 3; do echo "nested $i" > nested_test/a/deep/n$i.txt; echo "sibling $i" > nested_test/b/s$i.txt; done
+NESTED_TREE=$(./mygit write-tree 2>/dev/null | sed 's/\x1b\[[0-9;]*m//g' | grep -E '^[a-f0-9]{40}$')
+run_test "Write tree is deterministic" "[ \"\$(./mygit write-tree | tail -1)\" = $NESTED_TREE ]"
+run_test "Write tree nests subdirectories" "./mygit ls-tree --porcelain $NESTED_TREE | grep -qP '^040000 tree [a-f0-9]{40}\tnested_test$'"
+ln -s nowhere nested_test/b/dangling
+run_test "Write tree fails on a file it cannot read" "./mygit write-tree" 1
+rm -f nested_test/b/dangling
+if [ "$(id -u)" != 0 ]; then
+    chmod 000 nested_test/b
+    run_test "Write tree fails on a directory it cannot read" "./mygit write-tree" 1
+    chmod 755 nested_test/b
+fi
+rm -rf nested_test
 
 echo -e "\n${YELLOW}📋 Step 6: Staging Tests${NC}"
 run_test "Add single file" "./mygit add test1.txt"
@@ -102,18 +126,25 @@ run_test "Add multiple files" "./mygit add test2.txt test3.txt"
 run_test "Add directory" "./mygit add testdir/subfile.txt"
 run_test "Add all files" "./mygit add ."
 
+for i in 1 2 3 4 5 6 7 8; do echo "parallel $i" > testdir/parallel_$i.txt; done
+for i in 1 2 3 4 5 6 7 8; do ./mygit add testdir/parallel_$i.txt > /dev/null 2>&1 & done
+wait
+run_test "Concurrent adds keep every entry" "[ \"\$(grep -c parallel_ .mygit/index)\" = 8 ]"
+run_test "No lock files left behind" "! ls .mygit/*.lock 2>/dev/null"
+rm -f testdir/parallel_*.txt
+
 echo -e "\n${YELLOW}📋 Step 7: Commit Tests${NC}"
 run_test "Commit with message" "./mygit commit -m 'Initial commit'"
 COMMIT1=$(./mygit log 2>/dev/null | grep -E '^[a-f0-9]{40}$' | head -1)
 if [ -z "$COMMIT1" ]; then
-    COMMIT1=$(./mygit log 2>/dev/null | sed 's/\x1b\[[0-9;]*m//g' | grep "^commit " | head -1 | awk '{print $2}')
+    COMMIT1=$(./mygit log 2>/dev/null | sed 's/\x1b\[[0-9;]*m//g' | grep -oE 'commit [a-f0-9]{40}' | head -1 | awk '{print $2}')
 fi
 echo "First commit: $COMMIT1"
 
 echo "Modified content" > test1.txt
 run_test "Add modified file" "./mygit add test1.txt"
 run_test "Second commit" "./mygit commit -m 'Second commit'"
-COMMIT2=$(./mygit log 2>/dev/null | sed 's/\x1b\[[0-9;]*m//g' | grep "^commit " | head -1 | awk '{print $2}')
+COMMIT2=$(./mygit log 2>/dev/null | sed 's/\x1b\[[0-9;]*m//g' | grep -oE 'commit [a-f0-9]{40}' | head -1 | awk '{print $2}')
 echo "Second commit: $COMMIT2"
 
 echo "More changes" > test3.txt
@@ -121,16 +152,20 @@ mkdir -p newdir
 echo "New file in new directory" > newdir/newfile.txt
 run_test "Add new changes" "./mygit add ."
 run_test "Third commit" "./mygit commit -m 'Third commit with new directory'"
-COMMIT3=$(./mygit log 2>/dev/null | sed 's/\x1b\[[0-9;]*m//g' | grep "^commit " | head -1 | awk '{print $2}')
+COMMIT3=$(./mygit log 2>/dev/null | sed 's/\x1b\[[0-9;]*m//g' | grep -oE 'commit [a-f0-9]{40}' | head -1 | awk '{print $2}')
 
 echo -e "\n${YELLOW}📋 Step 8: Log Tests${NC}"
 run_test "Show commit log" "./mygit log"
+run_test "Porcelain log" "[ \"\$(./mygit log --porcelain | grep -c '^commit ')\" = 3 ]"
+echo "Untracked" > porcelain_test.txt
+run_test "Porcelain status" "./mygit status --porcelain | grep -qx '?? porcelain_test.txt'"
+rm -f porcelain_test.txt
 
 echo -e "\n${YELLOW}📋 Step 9: Checkout Tests${NC}"
 cp test.sh /tmp/test_backup.sh 2>/dev/null || true
 
 if [ ! -z "$COMMIT1" ]; then
-    run_test "Checkout first commit" "./mygit checkout $COMMIT1"
+    run_test "Checkout first commit" "./mygit checkout ${COMMIT1:0:7}"
     
     echo -e "\n${BLUE}Verifying checkout restored original content:${NC}"
     if [ -f test1.txt ]; then
@@ -161,6 +196,17 @@ if [ ! -f test.sh ] && [ -f /tmp/test_backup.sh ]; then
     chmod +x test.sh
 fi
 
+echo -e "\n${YELLOW}📋 Step 9b: Branch Tests${NC}"
+run_test "Create branch at first commit" "./mygit branch feature ${COMMIT1:0:7}"
+run_test "List branches" "./mygit branch | grep -q feature"
+run_test "Switch back to master" "./mygit switch master"
+run_test "HEAD is symbolic" "grep -qx 'ref: refs/heads/master' .mygit/HEAD"
+run_test "Status names the branch" "./mygit status | grep -q 'On branch master'"
+run_test "Pack refs" "./mygit pack-refs && grep -q refs/heads/feature .mygit/packed-refs && [ ! -f .mygit/refs/heads/feature ]"
+run_test "Log decorates packed branches" "./mygit log | grep -q '(feature)'"
+run_test "Cannot delete current branch" "./mygit branch -d master" 1
+run_test "Delete packed branch" "./mygit branch -d feature && ! ./mygit branch | grep -q feature"
+
 echo -e "\n${YELLOW}📋 Step 10: Error Handling Tests${NC}"
 run_test "Hash non-existent file" "./mygit hash-object nonexistent.txt" 1
 run_test "Cat-file with invalid hash" "./mygit cat-file -p invalidhash123" 1
@@ -181,6 +227,162 @@ run_test "Hash empty file" "./mygit hash-object -w empty_test.txt"
 echo -e "Line 1\nLine 2\tTab\nLine 3 with spaces" > special_chars.txt
 run_test "Hash file with special chars" "./mygit hash-object -w special_chars.txt"
 
+head -c 300000 /dev/urandom > chunked_test.bin
+run_test "Enable large-file chunking" "./mygit config chunking.threshold 65536"
+CHUNKED_HASH=$(./mygit hash-object -w chunked_test.bin 2>/dev/null | sed 's/\x1b\[[0-9;]*m//g' | grep -E '^[a-f0-9]{40}$')
+run_test "Chunked file reads back as a blob" "[ \"\$(./mygit cat-file -t $CHUNKED_HASH)\" = blob ]"
+run_test "Chunked file reassembles" "./mygit cat-file -p $CHUNKED_HASH | cmp -s - chunked_test.bin"
+run_test "Disable large-file chunking" "./mygit config chunking.threshold 0"
+rm -f chunked_test.bin
+
+mkdir -p import_test
+printf 'blob\nmark :1\ndata 6\nhello\n\ntree\nmark :2\n100644 :1 hello.txt\nend\ncommit refs/heads/master\nmark :3\ntree :2\ndata 8\nimported' > import_test/stream.txt
+run_test "Fast-import into a pack" "(cd import_test && ../mygit init && ../mygit fast-import --export-marks=marks.txt < stream.txt)"
+run_test "Fast-import wrote a pack and index" "ls import_test/.mygit/objects/pack/*.pack import_test/.mygit/objects/pack/*.idx"
+run_test "Packed blob reads back" "(cd import_test && [ \"\$(../mygit cat-file -p \$(grep '^:1 ' marks.txt | cut -d' ' -f2))\" = hello ])"
+run_test "Packed commit is HEAD" "(cd import_test && ../mygit log --porcelain | grep -q '^    imported')"
+run_test "Fsck verifies packed objects" "(cd import_test && ../mygit fsck)"
+run_test "Gc marks packed history reachable" "(cd import_test && ../mygit gc --prune=now | grep -q 'Reachable objects: *3')"
+run_test "Fast-import moves only the named branch" "(cd import_test && H=\$(../mygit log --porcelain | sed -n 's/^commit //p') && T=\$(../mygit log --porcelain | sed -n 's/^tree //p') && printf 'commit refs/heads/side\\ntree %s\\nparent %s\\ndata 4\\nside' \$T \$H | ../mygit fast-import && ../mygit log --porcelain | grep -q \"^commit \$H\" && ! ../mygit log --porcelain | grep -q side && ../mygit branch | grep -q side)"
+run_test "Fast-import rejects an unknown parent" "(cd import_test && T=\$(../mygit log --porcelain | sed -n 's/^tree //p') && printf 'commit refs/heads/bad\\ntree %s\\nparent %040d\\ndata 3\\nbad' \$T 0 | ../mygit fast-import 2>&1 | grep -q 'not a known commit' && [ ! -e .mygit/refs/heads/bad ])"
+run_test "Fast-import rejects an impossible data length" "(cd import_test && printf 'blob\\ndata 99999999999999\\nx' | ../mygit fast-import 2>&1 | grep -q 'malformed blob')"
+SIDE_COMMIT=$(cat import_test/.mygit/refs/heads/side 2>/dev/null)
+run_test "Repack unpacks unreachable objects" "(cd import_test && ../mygit branch -d side && ../mygit repack | grep -q 'Unpacked 1 unreachable' && [ -f .mygit/objects/${SIDE_COMMIT:0:2}/${SIDE_COMMIT:2} ] && [ \$(ls .mygit/objects/pack/*.pack | wc -l) = 1 ])"
+run_test "Gc prunes unpacked objects" "(cd import_test && ../mygit gc --prune=now && [ ! -f .mygit/objects/${SIDE_COMMIT:0:2}/${SIDE_COMMIT:2} ] && ../mygit fsck)"
+run_test "Fast-import fails when marks cannot be written" "(cd import_test && printf 'blob\\nmark :1\\ndata 2\\nhi' | ../mygit fast-import --export-marks=missing/marks.txt)" 1
+
+HEAD_COMMIT=$(./mygit log --porcelain | sed -n 's/^commit //p' | head -1)
+WALK_COUNT=$(./mygit count-objects $HEAD_COMMIT)
+run_test "Count objects between commits" "[ \$(./mygit count-objects $HEAD_COMMIT ^$COMMIT1) -lt $WALK_COUNT ]"
+run_test "Repack writes a pack with bitmaps" "./mygit repack && ls .mygit/objects/pack/*.bitmap"
+run_test "Bitmap count matches the walk" "[ \$(./mygit count-objects $HEAD_COMMIT) = $WALK_COUNT ]"
+run_test "Repacked history is readable" "./mygit log --porcelain | grep -q \"^commit $HEAD_COMMIT\" && ./mygit fsck"
+
+echo "unreachable $(date +%s%N)" > gc_orphan.txt
+ORPHAN_HASH=$(./mygit hash-object -w gc_orphan.txt 2>/dev/null | sed 's/\x1b\[[0-9;]*m//g' | grep -E '^[a-f0-9]{40}$')
+rm -f gc_orphan.txt
+run_test "Gc keeps young unreachable objects" "./mygit gc --prune && [ -f .mygit/objects/${ORPHAN_HASH:0:2}/${ORPHAN_HASH:2} ]"
+run_test "Gc prunes unreachable objects" "./mygit gc --prune=now && [ ! -f .mygit/objects/${ORPHAN_HASH:0:2}/${ORPHAN_HASH:2} ]"
+run_test "History survives gc" "./mygit log --porcelain | grep -q '^commit ' && ./mygit status"
+run_test "Fsck passes on a clean repository" "./mygit fsck"
+run_test "Fsck reports dangling objects" "./mygit hash-object -w special_chars.txt && ./mygit fsck | grep -q '^dangling blob'"
+
+run_test "New repositories use Git's tree encoding" "grep -q 'core.repositoryFormatVersion = 1' .mygit/config"
+
+mkdir -p migrate_test/src
+echo "legacy" > migrate_test/src/legacy.txt
+run_test "Commit in a format 0 repository" "(cd migrate_test && ../mygit init && ../mygit config core.repositoryFormatVersion 0 && ../mygit add src/legacy.txt && ../mygit commit -m legacy)"
+run_test "Migrate rewrites trees and commits" "(cd migrate_test && ../mygit migrate | grep -q 'rewrote 2 tree(s) and 1 commit(s)')"
+run_test "Migrated history is intact" "(cd migrate_test && ../mygit fsck && ../mygit show \$(../mygit log --porcelain | sed -n 's/^commit //p') | grep -q src)"
+rm -rf migrate_test
+
+mkdir -p history_test
+(cd history_test && ../mygit init && for i in 1 2 3 4 5 6; do
+    case $((i % 3)) in
+        0) mkdir -p src/lib && echo $i >> src/lib/core.cpp ;;
+        1) echo $i >> notes.txt ;;
+        2) mkdir -p src && echo $i >> src/main.cpp ;;
+    esac
+    ../mygit add . && ../mygit commit -m "change $i"
+done) > /dev/null 2>&1
+run_test "Log limited to a file" "(cd history_test && [ \"\$(../mygit log --porcelain -- src/lib/core.cpp | grep '^    ' | tr -d ' \n')\" = change6change3 ])"
+run_test "Log limited to a directory" "(cd history_test && [ \$(../mygit log --porcelain -- ./src/ | grep -c '^commit') = 4 ])"
+run_test "Write the commit graph" "(cd history_test && ../mygit commit-graph write | grep -q '6 commit(s)' && [ -f .mygit/objects/info/commit-graph ])"
+run_test "Bloom filters skip unrelated commits" "(cd history_test && MYGIT_TRACE=1 ../mygit log --porcelain -- src/lib/core.cpp 2>&1 | grep -qE 'commits filtered out +[1-9]')"
+run_test "Path log agrees with the graph" "(cd history_test && [ \"\$(../mygit log --porcelain -- src/main.cpp | grep '^    ' | tr -d ' \n')\" = change5change2 ] && [ -z \"\$(../mygit log --porcelain -- missing.txt)\" ])"
+rm -rf history_test
+
+mkdir -p grep_test/src
+printf 'int main() {\n    return old_value;\n}\n' > grep_test/src/main.cpp
+cp grep_test/src/main.cpp grep_test/src/copy.cpp
+(cd grep_test && ../mygit init && ../mygit add . && ../mygit commit -m first) > /dev/null 2>&1
+GREP_COMMIT=$(cd grep_test && ../mygit log --porcelain | sed -n 's/^commit //p')
+sed -i 's/old_value/new_value/' grep_test/src/main.cpp
+run_test "Grep the worktree" "(cd grep_test && [ \"\$(../mygit grep -n new_value)\" = 'src/main.cpp:2:    return new_value;' ])"
+run_test "Grep the index" "(cd grep_test && [ \$(../mygit grep --cached old_value | wc -l) = 2 ])"
+run_test "Grep an old commit without checkout" "(cd grep_test && ../mygit grep -l 'ret.rn +old' ${GREP_COMMIT:0:8} | grep -qx '${GREP_COMMIT:0:8}:src/copy.cpp' && grep -q new_value src/main.cpp)"
+run_test "Grep ignores case" "(cd grep_test && ../mygit grep -i -l 'INT MAIN' | grep -q src/main.cpp)"
+run_test "Grep without matches fails" "(cd grep_test && ../mygit grep no_such_text)" 1
+rm -rf grep_test
+
+mkdir -p archive_test/src
+echo "release notes" > archive_test/README.txt
+echo "int main() {}" > archive_test/src/main.cpp
+(cd archive_test && ../mygit init && ../mygit add . && ../mygit commit -m release) > /dev/null 2>&1
+ARCHIVE_COMMIT=$(cd archive_test && ../mygit log --porcelain | sed -n 's/^commit //p')
+rm -rf archive_test/src
+run_test "Archive a commit as tar" "(cd archive_test && ../mygit archive $ARCHIVE_COMMIT > release.tar && tar tf release.tar | grep -qx src/main.cpp && [ ! -d src ])"
+run_test "Archived files match the commit" "(cd archive_test && [ \"\$(tar xOf release.tar src/main.cpp)\" = 'int main() {}' ])"
+run_test "Archive as tar.gz with a prefix" "(cd archive_test && ../mygit archive --format=tar.gz --prefix=release/ ${ARCHIVE_COMMIT:0:8} | tar tzf - | grep -qx release/README.txt)"
+rm -rf archive_test
+
+mkdir -p merge_test/docs merge_test/src
+printf 'one\ntwo\nthree\nfour\nfive\n' > merge_test/src/main.cpp
+echo "guide" > merge_test/docs/guide.txt
+(cd merge_test && ../mygit init && ../mygit add . && ../mygit commit -m base && ../mygit switch -c topic &&
+    sed -i 's/two/TWO/' src/main.cpp && ../mygit commit -m topic &&
+    ../mygit switch master && sed -i 's/five/FIVE/' src/main.cpp && echo "extra" > notes.txt && ../mygit add . && ../mygit commit -m mainline) > /dev/null 2>&1
+run_test "Switch refuses to drop uncommitted changes" "(cd merge_test && echo dirty >> notes.txt && ! ../mygit switch topic && grep -q dirty notes.txt && grep -q FIVE src/main.cpp && sed -i '/dirty/d' notes.txt)"
+run_test "Switch rewrites only the paths that differ" "(cd merge_test && ../mygit switch topic && [ ! -e notes.txt ] && grep -q TWO src/main.cpp && ! grep -q FIVE src/main.cpp && ../mygit switch master && grep -q extra notes.txt)"
+MERGE_BASE=$(cd merge_test && ../mygit log --porcelain | sed -n 's/^commit //p' | tail -1)
+run_test "Merge base of two branches" "(cd merge_test && [ \"\$(../mygit merge-base \$(cat .mygit/refs/heads/master) \$(cat .mygit/refs/heads/topic))\" = $MERGE_BASE ])"
+run_test "Merge without conflicts" "(cd merge_test && MYGIT_TRACE=1 ../mygit merge topic 2>&1 | grep -qE 'trees merged +2\b' && grep -q TWO src/main.cpp && grep -q FIVE src/main.cpp)"
+run_test "Merge commit has two parents" "(cd merge_test && [ \$(../mygit log --porcelain | sed -n '1,/^$/p' | grep -c '^parent') = 2 ] && [ \$(../mygit log --porcelain | grep -c '^commit') = 4 ])"
+run_test "Path log follows every parent of a merge" "(cd merge_test && [ \"\$(../mygit log --porcelain -- src/main.cpp | grep -c '^commit')\" = 4 ] && ../mygit log --porcelain -- src/main.cpp | grep -qx '    topic')"
+run_test "Path log skips merges that kept a parent's version" "(cd merge_test && [ \"\$(../mygit log --porcelain -- notes.txt | grep '^    ' | tr -d ' \n')\" = mainline ])"
+run_test "Merging an ancestor is a no-op" "(cd merge_test && ../mygit merge topic | grep -q 'up to date')"
+run_test "Fast-forward merge" "(cd merge_test && ../mygit switch topic && ../mygit merge master | grep -q Fast-forward && grep -q extra notes.txt)"
+(cd merge_test && echo "ours" > docs/guide.txt && ../mygit commit -m ours && ../mygit branch other $MERGE_BASE &&
+    ../mygit switch other && echo "theirs" > docs/guide.txt && ../mygit commit -m theirs && ../mygit switch topic) > /dev/null 2>&1
+run_test "Conflicting merge leaves markers" "(cd merge_test && ../mygit merge other | grep -q 'CONFLICT (content): docs/guide.txt' ; grep -q '^<<<<<<< HEAD' docs/guide.txt && grep -q '^>>>>>>> other' docs/guide.txt && [ -f .mygit/MERGE_HEAD ])"
+run_test "Commit concludes the merge" "(cd merge_test && echo resolved > docs/guide.txt && ../mygit commit -m resolved && [ ! -f .mygit/MERGE_HEAD ] && ../mygit log --porcelain | sed -n '1,/^$/p' | grep -c '^parent' | grep -qx 2)"
+rm -rf merge_test
+mkdir -p merge_test
+printf 'blob\nmark :1\ndata 6\na\nb\nc\ntree\nmark :2\n100644 :1 run.sh\nend\ncommit refs/heads/master\nmark :3\ntree :2\ndata 4\nbase\nblob\nmark :4\ndata 6\nA\nb\nc\ntree\nmark :5\n100644 :4 run.sh\nend\ncommit refs/heads/master\ntree :5\nparent :3\ndata 4\nours\nblob\nmark :6\ndata 6\na\nb\nC\ntree\nmark :7\n100755 :6 run.sh\nend\ncommit refs/heads/topic\ntree :7\nparent :3\ndata 6\ntheirs\n' > merge_test/stream.txt
+(cd merge_test && ../mygit init && ../mygit fast-import < stream.txt && rm stream.txt && ../mygit checkout $(cat .mygit/refs/heads/master 2>/dev/null || echo none) && ../mygit switch master) > /dev/null 2>&1
+run_test "Merge takes the mode only one side changed" "(cd merge_test && ../mygit merge topic && ../mygit ls-tree --porcelain \$(../mygit log --porcelain | sed -n '2s/^tree //p') | grep -qP '^100755 blob [a-f0-9]{40}\trun.sh$' && [ \"\$(cat run.sh)\" = \"\$(printf 'A\nb\nC')\" ])"
+rm -rf merge_test
+
+mkdir -p sparse_test/apps/web sparse_test/apps/api/v1 sparse_test/docs
+for f in apps/web/index apps/api/server apps/api/v1/routes apps/readme docs/guide top; do echo $f > sparse_test/$f.txt; done
+(cd sparse_test && ../mygit init && ../mygit add . && ../mygit commit -m base) > /dev/null 2>&1
+run_test "Sparse checkout of one directory" "(cd sparse_test && ../mygit sparse-checkout set apps/api && [ -f apps/api/v1/routes.txt ] && [ -f apps/readme.txt ] && [ -f top.txt ] && [ ! -e apps/web ] && [ ! -e docs ])"
+run_test "Sparse patterns are in cone form" "(cd sparse_test && grep -qx '!/apps/\*/' .mygit/info/sparse-checkout && [ \"\$(../mygit sparse-checkout list)\" = apps/api ])"
+run_test "Status ignores paths outside the cone" "(cd sparse_test && ../mygit add . && [ -z \"\$(../mygit status --porcelain | grep -E 'docs|web')\" ])"
+run_test "Commits keep directories outside the cone" "(cd sparse_test && echo changed >> apps/api/server.txt && ../mygit commit -m sparse && ../mygit ls-tree --name-only \$(../mygit log --porcelain | sed -n '2s/^tree //p') | grep -qx docs)"
+run_test "Disabling sparse checkout restores everything" "(cd sparse_test && ../mygit sparse-checkout disable && [ -f docs/guide.txt ] && [ -f apps/web/index.txt ] && grep -q changed apps/api/server.txt)"
+rm -rf sparse_test
+
+mkdir -p raw_test
+head -c 300000 /dev/urandom > raw_test/asset.bin
+(cd raw_test && ../mygit init && ../mygit add . && ../mygit commit -m asset && cp asset.bin ../raw_asset.ref && rm asset.bin) > /dev/null 2>&1
+RAW_COMMIT=$(cd raw_test && ../mygit log --porcelain | sed -n 's/^commit //p')
+run_test "Incompressible blobs are stored raw" "(cd raw_test && H=\$(../mygit hash-object ../raw_asset.ref | tail -1) && head -c 5 .mygit/objects/\${H:0:2}/\${H:2} | grep -q '^blob ')"
+run_test "Raw blobs are checked out by the kernel" "(cd raw_test && MYGIT_TRACE=1 ../mygit checkout $RAW_COMMIT 2>&1 | grep -qE 'bytes copied in kernel +300000' && cmp -s asset.bin ../raw_asset.ref)"
+run_test "Checkout fails on a truncated raw object" "(cd raw_test && H=\$(../mygit hash-object ../raw_asset.ref | tail -1) && truncate -s 100000 .mygit/objects/\${H:0:2}/\${H:2} && ! ../mygit checkout $RAW_COMMIT && [ ! -e asset.bin ])"
+rm -rf raw_test raw_asset.ref
+
+run_test "Trace JSON escapes the command name" "(./mygit --trace=trace_test.json 'say\"hi\\' >/dev/null 2>&1; grep -qF '\"name\":\"say\\\"hi\\\\\"' trace_test.json)"
+rm -f trace_test.json
+run_test "Unknown --trace options are rejected" "./mygit --tracefoo status" 1
+
+mkdir -p sha256_test/src
+echo "hello" > sha256_test/src/hello.txt
+run_test "Init with the SHA-256 object format" "(cd sha256_test && ../mygit init --object-format=sha256 && grep -q 'extensions.objectFormat = sha256' .mygit/config)"
+run_test "SHA-256 blob hash matches Git" "(cd sha256_test && [ \"\$(../mygit hash-object src/hello.txt | tail -1)\" = 2cf8d83d9ee29543b34a87727421fdecb7e3f3a183d337639025de576db9ebb4 ])"
+run_test "Commit in a SHA-256 repository" "(cd sha256_test && ../mygit add src/hello.txt && ../mygit commit -m sha256 && ../mygit log --porcelain | grep -qE '^commit [0-9a-f]{64}\$')"
+run_test "SHA-256 packs, bitmaps and fsck" "(cd sha256_test && ../mygit repack && ls .mygit/objects/pack | grep -qE '^pack-[0-9a-f]{64}\.bitmap\$' && ../mygit fsck)"
+run_test "Checkout from a SHA-256 pack" "(cd sha256_test && rm src/hello.txt && ../mygit checkout \$(../mygit log --porcelain | sed -n 's/^commit //p') && grep -q hello src/hello.txt)"
+run_test "Unknown object format is rejected" "(mkdir -p sha256_test/bad && cd sha256_test/bad && ../../mygit init --object-format=md5)" 1
+rm -rf sha256_test
+
+mkdir -p fsck_test
+echo "fsck content" > fsck_test/file.txt
+run_test "Fsck detects missing objects" "(cd fsck_test && ../mygit init && ../mygit add file.txt && ../mygit commit -m fsck && rm -rf .mygit/objects/?? && ../mygit fsck | grep -q '^missing')"
+run_test "Fsck fails on a damaged repository" "(cd fsck_test && ../mygit fsck)" 1
+rm -rf fsck_test
+rm -rf import_test
+
 echo -e "\n${YELLOW}📋 Step 12: Repository State Verification${NC}"
 
 echo -e "\n${BLUE}Repository structure:${NC}"